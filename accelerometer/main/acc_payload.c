@@ -0,0 +1,159 @@
+#include "acc_payload.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t s_device_id;
+static int64_t s_clock_offset_us;
+
+void acc_payload_set_device_id(uint32_t device_id)
+{
+  s_device_id = device_id;
+}
+
+uint32_t acc_payload_device_id(void)
+{
+  return s_device_id;
+}
+
+void acc_payload_set_clock_offset(int64_t offset_us)
+{
+  s_clock_offset_us = offset_us;
+}
+
+size_t acc_payload_json_size(const sample_batch_t *batch)
+{
+  return ACC_PAYLOAD_JSON_MAX(batch->count);
+}
+
+// snprintf into what is left of the buffer; false once it would truncate
+static bool append(char *out, size_t cap, size_t *offset, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(out + *offset, cap - *offset, fmt, args);
+  va_end(args);
+  if (n < 0 || (size_t)n >= cap - *offset)
+  {
+    return false;
+  }
+  *offset += n;
+  return true;
+}
+
+size_t acc_payload_encode_json(const sample_batch_t *batch, char *out, size_t cap)
+{
+  size_t offset = 0;
+  if (!append(out, cap, &offset,
+              "{\"device\": \"%08lx\", \"fs\": %.3f, \"t0_us\": %lld, \"clock_offset_us\": %lld, \"frames\": [",
+              (unsigned long)s_device_id, batch->sample_rate_hz, (long long)batch->first_us,
+              (long long)s_clock_offset_us))
+  {
+    return 0;
+  }
+  for (int i = 0; i < batch->count; i++)
+  {
+    const mma8451_sample_t *s = &batch->samples[i];
+    if (!append(out, cap, &offset, "%s[%.2f,%.2f,%.2f]", i == 0 ? "" : ",",
+                mma8451_to_ms2(s->x), mma8451_to_ms2(s->y), mma8451_to_ms2(s->z)))
+    {
+      return 0;
+    }
+  }
+  if (!append(out, cap, &offset, "]}"))
+  {
+    return 0;
+  }
+  return offset;
+}
+
+size_t acc_payload_binary_size(const sample_batch_t *batch)
+{
+  return ACC_PAYLOAD_BINARY_MAX(batch->count);
+}
+
+static void write_header(const sample_batch_t *batch, uint8_t version, uint16_t counts_per_g, uint8_t *out)
+{
+  acc_payload_header_t header = {
+      .magic = ACC_PAYLOAD_MAGIC,
+      .version = version,
+      .header_len = sizeof(acc_payload_header_t),
+      .fs_millihz = (uint32_t)(batch->sample_rate_hz * 1000.0f + 0.5f),
+      .start_index = batch->start_index,
+      .count = (uint16_t)batch->count,
+      .counts_per_g = counts_per_g,
+      .device_id = s_device_id,
+      .t0_us = batch->first_us,
+      .clock_offset_us = s_clock_offset_us,
+  };
+  memcpy(out, &header, sizeof(header));
+}
+
+size_t acc_payload_encode_binary(const sample_batch_t *batch, uint8_t *out, size_t cap)
+{
+  size_t size = acc_payload_binary_size(batch);
+  if (size > cap)
+  {
+    return 0;
+  }
+
+  write_header(batch, ACC_PAYLOAD_VERSION, (uint16_t)MMA8451_COUNTS_PER_G, out);
+
+  // mma8451_sample_t is three packed int16s and the ESP32 is little-endian,
+  // so the samples are already in wire format
+  _Static_assert(sizeof(mma8451_sample_t) == MMA8451_BYTES_PER_SAMPLE, "samples must be packed");
+  memcpy(out + sizeof(acc_payload_header_t), batch->samples, (size_t)batch->count * sizeof(mma8451_sample_t));
+  return size;
+}
+
+size_t acc_payload_delta_size(const sample_batch_t *batch)
+{
+  return ACC_PAYLOAD_DELTA_MAX(batch->count);
+}
+
+// Zigzag maps small negative and positive deltas to small unsigned values
+// (0, -1, 1, -2 -> 0, 1, 2, 3), then 7 bits per byte with a continuation bit
+static uint8_t *put_delta(uint8_t *p, int32_t delta)
+{
+  uint32_t v = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+  while (v >= 0x80)
+  {
+    *p++ = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+size_t acc_payload_encode_delta(const sample_batch_t *batch, uint8_t *out, size_t cap)
+{
+  if (acc_payload_delta_size(batch) > cap)
+  {
+    return 0;
+  }
+
+  uint8_t *p = out + sizeof(acc_payload_header_t);
+  int32_t prev_x = 0, prev_y = 0, prev_z = 0;
+  for (int i = 0; i < batch->count; i++)
+  {
+    const mma8451_sample_t *s = &batch->samples[i];
+    int32_t x = s->x >> 2, y = s->y >> 2, z = s->z >> 2;
+    p = put_delta(p, x - prev_x);
+    p = put_delta(p, y - prev_y);
+    p = put_delta(p, z - prev_z);
+    prev_x = x;
+    prev_y = y;
+    prev_z = z;
+  }
+
+  size_t size = p - out;
+  if (size >= acc_payload_binary_size(batch))
+  {
+    return acc_payload_encode_binary(batch, out, cap); // deltas didn't pay off
+  }
+
+  write_header(batch, ACC_PAYLOAD_VERSION_DELTA, (uint16_t)(MMA8451_COUNTS_PER_G / 4), out);
+  return size;
+}
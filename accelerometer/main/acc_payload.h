@@ -0,0 +1,98 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "accel_sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Serializers for the /acc_data upload.
+//
+// JSON (application/json):
+//   {"device": "3c84a1f0", "fs": 50.000, "t0_us": 123456, "clock_offset_us": 1718000000000000,
+//    "frames": [[x0, y0, z0], [x1, ...], ...]}
+//   m/s^2, 2 decimals, one array per sample
+//
+// Binary (application/octet-stream), all fields little-endian:
+//   acc_payload_header_t, then count * {int16 x, y, z} raw counts
+// The raw counts go out as read from the sensor, so the device does no
+// float formatting and the server decodes with one np.frombuffer.
+//
+// Delta (application/octet-stream, version ACC_PAYLOAD_VERSION_DELTA):
+//   the same header, then count * {x, y, z} as zigzag LEB128 varints of the
+//   difference from the previous sample (the first from 0). Values are the
+//   14-bit counts (the two always-zero padding bits dropped), so at walking
+//   pace most deltas take one byte instead of two. Lossless.
+//
+// Every format names the sending device (acc_payload_device_id()), so the
+// backend keeps a separate cadence per wearer, and carries the esp_timer
+// time of the first sample with the measured rate. clock_offset_us turns
+// that into backend time (t0_us + clock_offset_us); it is 0 until the first
+// response has synchronized the clocks.
+
+#define ACC_PAYLOAD_MAGIC 0x4341 // "AC"
+#define ACC_PAYLOAD_VERSION 1
+#define ACC_PAYLOAD_VERSION_DELTA 2
+#define ACC_PAYLOAD_DELTA_MAX_BYTES 3 // varint of a zigzagged 15-bit delta
+
+typedef struct __attribute__((packed))
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t header_len;      // sizeof(acc_payload_header_t), so later versions can grow it
+  uint32_t fs_millihz;     // sample rate in mHz
+  uint32_t start_index;    // index of the first sample since boot; detects dropped batches
+  uint16_t count;          // samples that follow
+  uint16_t counts_per_g;   // scale of the raw values
+  uint32_t device_id;      // added after the first 16 bytes; older backends skip it through header_len
+  int64_t t0_us;           // esp_timer time of the first sample; added after device_id
+  int64_t clock_offset_us; // backend time minus esp_timer time, 0 if not yet known
+} acc_payload_header_t;
+
+static_assert(sizeof(acc_payload_header_t) == 36, "header layout is part of the wire format");
+
+// {"device": "<8 hex>", "fs": 800.000, "t0_us": <int64>, "clock_offset_us": <int64>, "frames": [  plus ]}
+// and the terminator
+#define ACC_PAYLOAD_JSON_HEADER_MAX 128
+#define ACC_PAYLOAD_JSON_FRAME_MAX 23  // "[-19.61,-19.61,-19.61]," is the longest frame at +/-2g
+
+// Upper bounds for count samples, for buffers sized at compile time; the
+// *_size() functions below give the same for one batch
+#define ACC_PAYLOAD_JSON_MAX(count) (ACC_PAYLOAD_JSON_HEADER_MAX + (size_t)(count) * ACC_PAYLOAD_JSON_FRAME_MAX)
+#define ACC_PAYLOAD_BINARY_MAX(count) (sizeof(acc_payload_header_t) + (size_t)(count) * MMA8451_BYTES_PER_SAMPLE)
+#define ACC_PAYLOAD_DELTA_MAX(count) \
+  (sizeof(acc_payload_header_t) + (size_t)(count) * 3 * ACC_PAYLOAD_DELTA_MAX_BYTES)
+
+// Set once at boot, before the first batch is encoded (see main.c)
+void acc_payload_set_device_id(uint32_t device_id);
+uint32_t acc_payload_device_id(void);
+
+// Latest clock_sync estimate, stamped on every batch encoded after it
+void acc_payload_set_clock_offset(int64_t offset_us);
+
+// Upper bound of the JSON encoding, including the terminator
+size_t acc_payload_json_size(const sample_batch_t *batch);
+
+// Returns the string length, without the terminator
+size_t acc_payload_encode_json(const sample_batch_t *batch, char *out, size_t cap);
+
+size_t acc_payload_binary_size(const sample_batch_t *batch);
+
+// Returns the number of bytes written, 0 if cap is too small
+size_t acc_payload_encode_binary(const sample_batch_t *batch, uint8_t *out, size_t cap);
+
+// Worst case of acc_payload_encode_delta(), which is also enough for the
+// raw fallback
+size_t acc_payload_delta_size(const sample_batch_t *batch);
+
+// Delta-encodes the batch, or writes the raw binary format when that turns
+// out smaller (violent motion). Returns the number of bytes written, 0 if
+// cap is too small.
+size_t acc_payload_encode_delta(const sample_batch_t *batch, uint8_t *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
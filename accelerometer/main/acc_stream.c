@@ -0,0 +1,63 @@
+#include "acc_stream.h"
+
+#include <errno.h>
+#include <string.h>
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "acc_payload.h"
+
+static const char *TAG = "ACC_STREAM";
+
+static int s_sock = -1;
+static struct sockaddr_in s_dest;
+static acc_stream_stats_t s_stats;
+static uint8_t s_datagram[ACC_STREAM_MAX_DATAGRAM];
+
+esp_err_t acc_stream_init(const char *host, uint16_t port)
+{
+  memset(&s_dest, 0, sizeof(s_dest));
+  s_dest.sin_family = AF_INET;
+  s_dest.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &s_dest.sin_addr) != 1)
+  {
+    ESP_LOGE(TAG, "Bad stream address %s", host);
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+  if (s_sock < 0)
+  {
+    ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+    return ESP_FAIL;
+  }
+
+  ESP_LOGI(TAG, "Streaming to %s:%u over UDP", host, port);
+  return ESP_OK;
+}
+
+esp_err_t acc_stream_send(const sample_batch_t *batch)
+{
+  size_t len = acc_payload_encode_binary(batch, s_datagram, sizeof(s_datagram));
+  if (len == 0)
+  {
+    ESP_LOGE(TAG, "Batch of %d samples doesn't fit in a datagram", batch->count);
+    return ESP_ERR_INVALID_SIZE;
+  }
+
+  int sent = sendto(s_sock, s_datagram, len, 0, (struct sockaddr *)&s_dest, sizeof(s_dest));
+  if (sent < 0)
+  {
+    // Typically ENOMEM while the Wi-Fi TX queue is full; the next burst carries on
+    s_stats.errors++;
+    return ESP_FAIL;
+  }
+
+  s_stats.datagrams++;
+  s_stats.bytes += sent;
+  return ESP_OK;
+}
+
+const acc_stream_stats_t *acc_stream_stats(void)
+{
+  return &s_stats;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample_batch.h"
+
+// Streams batches to the backend as UDP datagrams, one binary batch
+// (acc_payload.h) per datagram. The header's start_index works as the
+// sequence number: the server sees lost or reordered datagrams as jumps in
+// the sample index. Nothing is retransmitted; a lost burst costs the
+// cadence engine a few samples rather than delaying everything after it.
+
+#define ACC_STREAM_MAX_DATAGRAM 1400 // stay under the Wi-Fi MTU
+
+typedef struct
+{
+  uint32_t datagrams;
+  uint32_t bytes;
+  uint32_t errors;
+} acc_stream_stats_t;
+
+esp_err_t acc_stream_init(const char *host, uint16_t port);
+esp_err_t acc_stream_send(const sample_batch_t *batch);
+const acc_stream_stats_t *acc_stream_stats(void);
@@ -0,0 +1,107 @@
+#include "accel_bench.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "accel_sample.h"
+#include "acc_payload.h"
+#include "cadence_engine.h"
+
+static const char *TAG = "ACCEL_BENCH";
+
+#define BENCH_ROUNDS 20
+#define BENCH_RATE_HZ 50
+#define BENCH_STEP_HZ 1.8f // ~108 steps per minute
+#define BENCH_CADENCE_HZ 25 // as CADENCE_RATE_HZ in main.c
+
+static sample_batch_t s_batch;
+
+// Gravity on z plus a step-shaped bounce, with a little per-axis jitter so
+// the delta encoder sees realistic spreads
+static void fill_walking_batch(sample_batch_t *batch)
+{
+  const float counts_per_ms2 = MMA8451_COUNTS_PER_G / GRAVITY_CONSTANT;
+  batch->count = 0;
+  batch->sample_rate_hz = BENCH_RATE_HZ;
+  batch->start_index = 0;
+  for (int i = 0; i < SAMPLE_BATCH_MAX_SAMPLES; i++)
+  {
+    float t = (float)i / BENCH_RATE_HZ;
+    float bounce = 3.0f * sinf(2.0f * (float)M_PI * BENCH_STEP_HZ * t);
+    mma8451_sample_t sample = {
+        .x = (int16_t)((0.4f * bounce + (i % 7) * 0.05f) * counts_per_ms2) & ~3,
+        .y = (int16_t)((0.2f * bounce - (i % 5) * 0.05f) * counts_per_ms2) & ~3,
+        .z = (int16_t)((GRAVITY_CONSTANT + bounce) * counts_per_ms2) & ~3,
+    };
+    sample_batch_push(batch, &sample, (int64_t)i * (1000000 / BENCH_RATE_HZ));
+  }
+}
+
+static unsigned long per_sample(uint32_t cycles)
+{
+  return (unsigned long)(cycles / ((uint32_t)BENCH_ROUNDS * SAMPLE_BATCH_MAX_SAMPLES));
+}
+
+void accel_run_benchmark(void)
+{
+  fill_walking_batch(&s_batch);
+  size_t json_cap = acc_payload_json_size(&s_batch);
+  size_t delta_cap = acc_payload_delta_size(&s_batch);
+  char *json = (char *)malloc(json_cap);
+  uint8_t *delta = (uint8_t *)malloc(delta_cap);
+  if (json == NULL || delta == NULL)
+  {
+    ESP_LOGE(TAG, "Benchmark buffers do not fit");
+    free(json);
+    free(delta);
+    return;
+  }
+
+  volatile float sink = 0; // keeps the conversions from being optimised away
+  uint32_t start = esp_cpu_get_cycle_count();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    float sum = 0;
+    for (int i = 0; i < s_batch.count; i++)
+    {
+      const mma8451_sample_t *s = &s_batch.samples[i];
+      sum += mma8451_to_ms2(s->x) + mma8451_to_ms2(s->y) + mma8451_to_ms2(s->z);
+    }
+    sink = sum;
+  }
+  uint32_t convert_cycles = esp_cpu_get_cycle_count() - start;
+  (void)sink;
+
+  size_t json_len = 0;
+  start = esp_cpu_get_cycle_count();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    json_len = acc_payload_encode_json(&s_batch, json, json_cap);
+  }
+  uint32_t json_cycles = esp_cpu_get_cycle_count() - start;
+
+  size_t delta_len = 0;
+  start = esp_cpu_get_cycle_count();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    delta_len = acc_payload_encode_delta(&s_batch, delta, delta_cap);
+  }
+  uint32_t delta_cycles = esp_cpu_get_cycle_count() - start;
+
+  cadence_engine_t cadence;
+  cadence_engine_init(&cadence, BENCH_RATE_HZ, BENCH_CADENCE_HZ, CADENCE_BASELINE_TAU_S, NULL);
+  start = esp_cpu_get_cycle_count();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    cadence_engine_push(&cadence, &s_batch.samples[0].x, s_batch.count);
+  }
+  uint32_t cadence_cycles = esp_cpu_get_cycle_count() - start;
+
+  ESP_LOGI(TAG, "%d samples: to_ms2 %lu, json %lu (%u B), delta %lu (%u B), cadence %lu cycles/sample (%.0f BPM)",
+           s_batch.count, per_sample(convert_cycles), per_sample(json_cycles), (unsigned)json_len,
+           per_sample(delta_cycles), (unsigned)delta_len, per_sample(cadence_cycles), cadence_engine_bpm(&cadence));
+
+  free(json);
+  free(delta);
+}
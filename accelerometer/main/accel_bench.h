@@ -0,0 +1,7 @@
+#pragma once
+
+// On-target timing of the per-sample kernels: unit conversion, the JSON and
+// delta payload encoders, and the cadence engine. Runs over a synthetic
+// walking batch of SAMPLE_BATCH_MAX_SAMPLES and logs CPU cycles per sample,
+// so a regression shows up at boot instead of as a late upload.
+void accel_run_benchmark(void);
@@ -0,0 +1,27 @@
+#include "accel_sample.h"
+
+bool sample_batch_push(sample_batch_t *batch, const mma8451_sample_t *sample, int64_t t_us)
+{
+  if (batch->count >= SAMPLE_BATCH_MAX_SAMPLES)
+  {
+    return false;
+  }
+  if (batch->count == 0)
+  {
+    batch->first_us = t_us;
+  }
+  batch->samples[batch->count++] = *sample;
+  return true;
+}
+
+sample_frame_t sample_batch_frame(const sample_batch_t *batch, int i)
+{
+  const mma8451_sample_t *s = &batch->samples[i];
+  sample_frame_t frame = {
+      .x = s->x,
+      .y = s->y,
+      .z = s->z,
+      .t_us = batch->first_us + (int64_t)(i * 1000000.0f / batch->sample_rate_hz),
+  };
+  return frame;
+}
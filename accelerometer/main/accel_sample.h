@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Sample and batch types, as plain data.
+//
+// Nothing here touches the bus, FreeRTOS or esp_timer, so the per-sample
+// kernels built on it (unit conversion, acc_payload)
+// are ordinary C. mma8451.h and sample_batch.h add the driver and the
+// task hand-off on top.
+
+#define MMA8451_BYTES_PER_SAMPLE 6
+#define MMA8451_COUNTS_PER_G 16384.0f // 4096 counts/g, left-justified by 2 bits
+
+#define GRAVITY_CONSTANT 9.80665f
+
+#define SAMPLE_BATCH_MAX_SAMPLES 400 // 2 s at 200 Hz
+
+// Raw output counts, 14-bit left-justified
+typedef struct
+{
+  int16_t x;
+  int16_t y;
+  int16_t z;
+} mma8451_sample_t;
+
+typedef struct
+{
+  mma8451_sample_t samples[SAMPLE_BATCH_MAX_SAMPLES];
+  int count;
+  float sample_rate_hz;
+  int64_t first_us;     // esp_timer time of samples[0]
+  uint32_t start_index; // samples taken since boot before samples[0]
+  uint32_t seq;     // increments per batch; gaps mean dropped batches
+  float bpm;        // on-device cadence estimate after the last sample
+  float confidence;
+} sample_batch_t;
+
+// One sample with its time
+typedef struct
+{
+  int16_t x;
+  int16_t y;
+  int16_t z;
+  int64_t t_us; // esp_timer time
+} sample_frame_t;
+
+static inline float mma8451_to_ms2(int16_t raw)
+{
+  return raw * (GRAVITY_CONSTANT / MMA8451_COUNTS_PER_G); // one folded constant, one multiply
+}
+
+// Append a sample taken at t_us; false (and nothing written) once the batch
+// holds SAMPLE_BATCH_MAX_SAMPLES
+bool sample_batch_push(sample_batch_t *batch, const mma8451_sample_t *sample, int64_t t_us);
+
+// Sample i with its timestamp. Samples are evenly spaced, so the time comes
+// from first_us and the rate instead of being stored per sample.
+sample_frame_t sample_batch_frame(const sample_batch_t *batch, int i);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,14 +1,31 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
-#include "driver/i2c.h"
+#include "esp_timer.h"
+#include "driver/i2c_master.h"
+#include "esp_pm.h"
+#include "esp_mac.h"
 
-#include "esp_wifi.h"
-#include "esp_event.h"
-#include "nvs_flash.h"
 #include "esp_http_client.h"
 #include "esp_crt_bundle.h"
+#include "mma8451.h"
+#include "sample_batch.h"
+#include "acc_payload.h"
+#include "acc_stream.h"
+#include "cadence_engine.h"
+#include "clock_sync.h"
+#include "wifi_connect.h"
+#include "backend_discovery.h"
+#include "perf_counters.h"
+#include "node_config.h"
+#include "ota_update.h"
+#include "espnow_link.h"
+#include "task_placement.h"
+#include "accel_bench.h"
 
 static const char *TAG = "MMA8451_SENSOR";
 
@@ -16,26 +33,112 @@ static const char *TAG = "MMA8451_SENSOR";
 #define I2C_MASTER_SDA_IO 5 // D4 on your board
 #define I2C_MASTER_SCL_IO 6 // D5 on your board
 #define I2C_MASTER_NUM I2C_NUM_0
-#define I2C_MASTER_FREQ_HZ 400000
-
-// MMA8451 Specifics
-#define MMA8451_ADDR 0x1D
-#define REG_OUT_X_MSB 0x01
-#define REG_WHO_AM_I 0x0D
-#define REG_XYZ_DATA_CFG 0x0E
-#define REG_CTRL_REG1 0x2A
-
-#define REG_PL_STATUS 0x10 // Portrait/Landscape Status
-#define REG_PL_CFG 0x11    // Portrait/Landscape Configuration
-#define GRAVITY_CONSTANT 9.80665f
+#define MMA8451_INT1_GPIO 4 // D3 on your board, wired to the MMA8451 INT1 pin
+
+// Sampling: 1 = MMA8451 FIFO drained on its watermark interrupt,
+// 0 = poll the output registers every 200 ms (~5 Hz)
+#define SAMPLING_USE_FIFO 1
+#define SAMPLE_ODR MMA8451_ODR_50HZ
+
+// Power: 1 = the CPU light-sleeps between FIFO watermarks (INT1 wakes it), the
+// radio sits in modem sleep waking every WIFI_LISTEN_INTERVAL beacons, and
+// uploads are coalesced to one every UPLOAD_INTERVAL_S. Needs SAMPLING_USE_FIFO
+// and, for the CPU part, CONFIG_PM_ENABLE + CONFIG_FREERTOS_USE_TICKLESS_IDLE
+// (sdkconfig.defaults).
+//
+//  mode           CPU wake-ups/s  uploads/min  bytes/upload (delta)  current
+//  default (0)    3.1 (wm 16)     30           ~410 for 100 samples  not yet measured
+//  low power (1)  2.0 (wm 25)     7.5          ~1.6k for 400 samples not yet measured
+// Sample rate, timing and cadence are identical in both modes: the sensor
+// keeps sampling into its FIFO while the chip sleeps.
+#define LOW_POWER_MODE 0
+#define UPLOAD_INTERVAL_S 8 // 400 samples at 50 Hz fills a sample_batch_t
+#define WIFI_LISTEN_INTERVAL 3
+
+#if LOW_POWER_MODE
+#define BATCH_SECONDS UPLOAD_INTERVAL_S
+#else
+#define BATCH_SECONDS 2
+#endif
+#define POLLED_PERIOD_MS 200
+
+// Motion gating: 1 = after MOTION_IDLE_S without a transient from the sensor's
+// motion detector, it drops to MOTION_IDLE_ODR in low-power mode with only
+// transient and orientation events on INT1, and nothing is sampled, run
+// through the cadence engine or uploaded until one fires. The rest shows up
+// downstream as a gap in start_index, so step intervals stay in real time.
+// Needs SAMPLING_USE_FIFO.
+#define MOTION_GATING 1
+#define MOTION_THRESHOLD_MG 190 // high-pass filtered; a step is several hundred mg, breathing and typing are not
+#define MOTION_IDLE_S 10
+#define MOTION_IDLE_ODR MMA8451_ODR_12_5HZ
+#define MOTION_CHECK_MS 1000 // the detector latches, so a slow poll misses nothing
+#define POLLED_RATE_HZ (1000.0f / POLLED_PERIOD_MS)
+
+// The backend is found over mDNS (_cadence._tcp); see components/backend_discovery
+#define URL_MAX 64
+
+// Transport: 1 = stream every FIFO burst as a UDP datagram (needs SAMPLING_USE_FIFO),
+// 0 = POST a batch every BATCH_SECONDS to /acc_data
+#define UPLOAD_UDP_STREAM 0
+#define STREAM_PORT 8001 // on the discovered backend host
+#define STREAM_BURST_SAMPLES 4 // 80 ms at 50 Hz per datagram
+
+// HTTP upload format: 1 = raw int16 samples (application/octet-stream), 0 = JSON floats
+#define UPLOAD_BINARY 1
+// With UPLOAD_BINARY: 1 = delta/varint compressed (about half the bytes), 0 = raw int16
+#define UPLOAD_DELTA 1
+
+// On-device cadence: the BPM is estimated per sample here and posted to
+// /cadence; the raw samples can still be uploaded for the backend's own estimate
+#define CADENCE_ON_DEVICE 1
+#define SEND_RAW_SAMPLES 1
+#define CADENCE_REPORT_MS 1000
+#define CADENCE_RATE_HZ 25 // the motion filter decimates to at least this rate
+
+// ESP-NOW: 1 = also broadcast the cadence after every FIFO burst straight to
+// the LED and LCD nodes (components/espnow_link); the HTTP uploads and
+// /cadence reports carry on for the backend. Needs CADENCE_ON_DEVICE and
+// SAMPLING_USE_FIFO.
+#define ESPNOW_BROADCAST 1
+
+#define RUN_KERNEL_BENCHMARK 0 // log per-sample kernel cycles at boot
+
+#if UPLOAD_UDP_STREAM
+#define FIFO_WATERMARK STREAM_BURST_SAMPLES
+#elif LOW_POWER_MODE
+#define FIFO_WATERMARK 25 // one wake-up per 500 ms at 50 Hz
+#else
+#define FIFO_WATERMARK 16 // interrupt every 16 samples (320 ms at 50 Hz)
+#endif
+
+// Tunables the backend can change (PUT /node_config/accelerometer), applied at
+// the next boot; the #defines above are their defaults. The sample rate and
+// batch sizes stay compile-time, they size the buffers.
+static cadence_config_t cadence_config = CADENCE_CONFIG_DEFAULT();
+static float cadence_tau_s = CADENCE_BASELINE_TAU_S;
+static int cadence_report_ms = CADENCE_REPORT_MS;
+static int motion_threshold_mg = MOTION_THRESHOLD_MG;
+static int motion_idle_s = MOTION_IDLE_S;
+
+static const node_config_param_t tunables[] = {
+  NODE_CONFIG_FLOAT("dead_zone_ms2", cadence_config.dead_zone_ms2, 0.1f, 10.0f),
+  NODE_CONFIG_FLOAT("min_interval_s", cadence_config.min_interval_s, 0.1f, 2.0f),
+  NODE_CONFIG_FLOAT("still_s", cadence_config.still_s, 0.5f, 10.0f),
+  NODE_CONFIG_INT("max_intervals", cadence_config.max_intervals, 1, CADENCE_MAX_INTERVALS),
+  NODE_CONFIG_FLOAT("baseline_tau_s", cadence_tau_s, 0.1f, 20.0f),
+  NODE_CONFIG_INT("cadence_report_ms", cadence_report_ms, 100, 60000),
+  NODE_CONFIG_INT("motion_threshold_mg", motion_threshold_mg, MMA8451_TRANSIENT_MG_PER_COUNT, 8000),
+  NODE_CONFIG_INT("motion_idle_s", motion_idle_s, 2, 3600),
+};
 
 static void process_data(int16_t x_raw, int16_t y_raw, int16_t z_raw, uint8_t pl_status)
 {
   // 1. Convert Raw to m/s^2
-  // Sensitivity at +/-2g is 4096 LSB/g
-  float ax = (x_raw / 4096.0f) * GRAVITY_CONSTANT;
-  float ay = (y_raw / 4096.0f) * GRAVITY_CONSTANT;
-  float az = (z_raw / 4096.0f) * GRAVITY_CONSTANT;
+  // Sensitivity at +/-2g is 4096 LSB/g, left-justified by 2 bits
+  float ax = mma8451_to_ms2(x_raw);
+  float ay = mma8451_to_ms2(y_raw);
+  float az = mma8451_to_ms2(z_raw);
 
   // 2. Decode Orientation Status (Bits 2:1 for PL, Bit 0 for B/F)
   const char *pl_state;
@@ -65,28 +168,108 @@ static void process_data(int16_t x_raw, int16_t y_raw, int16_t z_raw, uint8_t pl
          ax, ay, az, pl_state, side);
 }
 
-static esp_err_t i2c_master_init(void)
+static i2c_master_bus_handle_t i2c_bus;
+
+#if LOW_POWER_MODE
+// Modem sleep is set up with the Wi-Fi config; this adds CPU light sleep
+// between watermark interrupts
+static void power_init(void)
+{
+#if CONFIG_PM_ENABLE
+  esp_pm_config_t pm_config = {
+      .max_freq_mhz = 160,
+      .min_freq_mhz = 40,
+      .light_sleep_enable = true,
+  };
+  ESP_ERROR_CHECK(esp_pm_configure(&pm_config));
+#else
+  ESP_LOGW(TAG, "CONFIG_PM_ENABLE is off: modem sleep only, the CPU stays awake");
+#endif
+  ESP_ERROR_CHECK(mma8451_enable_wakeup());
+}
+#endif
+
+static esp_err_t i2c_bus_init(void)
 {
-  i2c_config_t conf = {
-      .mode = I2C_MODE_MASTER,
+  i2c_master_bus_config_t bus_cfg = {
+      .i2c_port = I2C_MASTER_NUM,
       .sda_io_num = I2C_MASTER_SDA_IO,
       .scl_io_num = I2C_MASTER_SCL_IO,
-      .sda_pullup_en = GPIO_PULLUP_ENABLE,
-      .scl_pullup_en = GPIO_PULLUP_ENABLE,
-      .master.clk_speed = I2C_MASTER_FREQ_HZ,
+      .clk_source = I2C_CLK_SRC_DEFAULT,
+      .glitch_ignore_cnt = 7,
+      .flags.enable_internal_pullup = true,
   };
-  i2c_param_config(I2C_MASTER_NUM, &conf);
-  return i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
+  return i2c_new_master_bus(&bus_cfg, &i2c_bus);
 }
 
-static esp_err_t write_reg(uint8_t reg, uint8_t data)
+// Orientation and bus health once per batch
+static void log_sensor_state(const mma8451_sample_t *last)
 {
-  uint8_t write_buf[2] = {reg, data};
-  return i2c_master_write_to_device(I2C_MASTER_NUM, MMA8451_ADDR, write_buf, 2, pdMS_TO_TICKS(100));
+  uint8_t pl_status = 0;
+  if (mma8451_read_orientation(&pl_status) == ESP_OK)
+  {
+    process_data(last->x, last->y, last->z, pl_status);
+  }
+
+  const mma8451_bus_stats_t *bus = mma8451_bus_stats();
+  if (bus->errors > 0)
+  {
+    ESP_LOGW(TAG, "I2C: %lu transfers, %lu errors (%lu timeouts), last %s",
+             (unsigned long)bus->transfers, (unsigned long)bus->errors,
+             (unsigned long)bus->timeouts, esp_err_to_name(bus->last_error));
+  }
+
+#if SAMPLING_USE_FIFO
+  const mma8451_fifo_stats_t *stats = mma8451_fifo_stats();
+  ESP_LOGI(TAG, "FIFO: %lu samples in %lu bursts, %lu overflows, %lu timeouts, %.2f Hz",
+           (unsigned long)stats->samples, (unsigned long)stats->bursts,
+           (unsigned long)stats->overflows, (unsigned long)stats->timeouts, stats->measured_hz);
+#endif
+#if ESPNOW_BROADCAST
+  const espnow_link_stats_t *link = espnow_link_stats();
+  ESP_LOGI(TAG, "ESP-NOW: %lu beats sent, %lu send errors", (unsigned long)link->sent,
+           (unsigned long)link->send_errors);
+#endif
+#if UPLOAD_UDP_STREAM
+  const acc_stream_stats_t *stream = acc_stream_stats();
+  ESP_LOGI(TAG, "Stream: %lu datagrams, %lu bytes, %lu send errors",
+           (unsigned long)stream->datagrams, (unsigned long)stream->bytes, (unsigned long)stream->errors);
+#endif
+}
+
+// Backend clock, from the X-Server-Us header the backend stamps on every
+// response. Owned by the uploader task, which does all the requests that
+// feed it; every batch it encodes carries the latest offset.
+static clock_sync_t backend_clock;
+static int64_t response_server_us; // of the request in flight, 0 if it had none
+
+static void clock_header(const esp_http_client_event_t *evt)
+{
+  if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "X-Server-Us") == 0)
+  {
+    response_server_us = strtoll(evt->header_value, NULL, 10);
+  }
+}
+
+// Call around each esp_http_client_perform() whose client uses clock_header()
+static void clock_request_start(int64_t *send_us)
+{
+  response_server_us = 0;
+  *send_us = esp_timer_get_time();
+}
+
+static void clock_request_done(int64_t send_us)
+{
+  if (response_server_us != 0)
+  {
+    clock_sync_add_sample(&backend_clock, send_us, esp_timer_get_time(), response_server_us);
+    acc_payload_set_clock_offset(backend_clock.offset_us);
+  }
 }
 
 esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
+  clock_header(evt);
   if (evt->event_id == HTTP_EVENT_ON_DATA)
   {
     printf("%.*s", evt->data_len, (char *)evt->data);
@@ -94,10 +277,20 @@ esp_err_t _http_event_handler(esp_http_client_event_t *evt)
   return ESP_OK;
 }
 
+#if CADENCE_ON_DEVICE
+static esp_err_t cadence_event_handler(esp_http_client_event_t *evt)
+{
+  clock_header(evt);
+  return ESP_OK;
+}
+#endif
+
 void make_google_request()
 {
+  char url[URL_MAX];
+  backend_discovery_url("/", url, sizeof(url));
   esp_http_client_config_t config = {
-      .url = "http://10.29.199.121:8000/", // Use your laptop's actual 10.29 IP
+      .url = url,
       .method = HTTP_METHOD_GET,
       // No certificate bundle needed for local HTTP!
   };
@@ -115,194 +308,512 @@ void make_google_request()
   {
     // If you see a -0x7280 error here, check if your ngrok tunnel is still active
     printf("HTTP GET request failed: %s\n", esp_err_to_name(err));
+    backend_discovery_invalidate();
   }
 
   esp_http_client_cleanup(client);
 }
 
-void post_acceleration_list(float *accel_data, int length)
+// Time from the newest sample in the batch to now; sent with the batch so the
+// backend can place the sample on its own clock for the latency trace
+static int64_t batch_age_us(const sample_batch_t *batch)
 {
-  // 1. Prepare the buffer
-  char *post_data = malloc(2048);
-  if (post_data == NULL)
-    return;
-
-  // 2. Build the JSON string manually: {"data": [1.2, 3.4, ...]}
-  int offset = sprintf(post_data, "{\"data\": [");
-  for (int i = 0; i < length; i++)
+  if (batch->count == 0)
   {
-    offset += sprintf(post_data + offset, "%.2f%s",
-                      accel_data[i],
-                      (i == length - 1) ? "" : ",");
+    return 0;
   }
-  sprintf(post_data + offset, "]}");
+  return esp_timer_get_time() - sample_batch_frame(batch, batch->count - 1).t_us;
+}
 
-  // 3. Configure the HTTP Client
-  esp_http_client_config_t config = {
-      .url = "http://10.29.199.121:8000/acc_data",
-      .method = HTTP_METHOD_POST,
-      .event_handler = _http_event_handler,
-  };
-  esp_http_client_handle_t client = esp_http_client_init(&config);
+PERF_TIMER(acc_post_timer, "acc_post");
+PERF_COUNTER(dropped_batches, "dropped_batches");
+
+#if UPLOAD_BINARY && UPLOAD_DELTA
+#define POST_BUFFER_SIZE ACC_PAYLOAD_DELTA_MAX(SAMPLE_BATCH_MAX_SAMPLES)
+#define POST_CONTENT_TYPE "application/octet-stream"
+#elif UPLOAD_BINARY
+#define POST_BUFFER_SIZE ACC_PAYLOAD_BINARY_MAX(SAMPLE_BATCH_MAX_SAMPLES)
+#define POST_CONTENT_TYPE "application/octet-stream"
+#else
+#define POST_BUFFER_SIZE ACC_PAYLOAD_JSON_MAX(SAMPLE_BATCH_MAX_SAMPLES)
+#define POST_CONTENT_TYPE "application/json"
+#endif
+
+// One buffer and one kept-alive client for every batch, the client re-pointed
+// if the backend moves, so an upload takes nothing from the heap
+static uint8_t post_buffer[POST_BUFFER_SIZE];
+static esp_http_client_handle_t acc_client;
+static uint32_t acc_generation;
+
+void post_acceleration_list(const sample_batch_t *batch)
+{
+  // 1. Serialize the batch
+#if UPLOAD_BINARY && UPLOAD_DELTA
+  size_t post_len = acc_payload_encode_delta(batch, post_buffer, sizeof(post_buffer));
+#elif UPLOAD_BINARY
+  size_t post_len = acc_payload_encode_binary(batch, post_buffer, sizeof(post_buffer));
+#else
+  size_t post_len = acc_payload_encode_json(batch, (char *)post_buffer, sizeof(post_buffer));
+#endif
+  if (post_len == 0)
+  {
+    // The encoder ran out of room; the caller releases the batch
+    ESP_LOGE(TAG, "Batch %lu of %d samples doesn't fit in %u bytes, not sent", (unsigned long)batch->seq,
+             batch->count, (unsigned)sizeof(post_buffer));
+    perf_count(&dropped_batches, 1);
+    return;
+  }
 
-  esp_http_client_set_header(client, "Content-Type", "application/json");
-  esp_http_client_set_post_field(client, post_data, strlen(post_data));
+  // 2. Point the client at the backend
+  char url[URL_MAX];
+  backend_discovery_url("/acc_data", url, sizeof(url));
+  if (acc_client == NULL)
+  {
+    acc_generation = backend_discovery_generation();
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_POST,
+        .event_handler = _http_event_handler,
+        .keep_alive_enable = true,
+    };
+    acc_client = esp_http_client_init(&config);
+    esp_http_client_set_header(acc_client, "Content-Type", POST_CONTENT_TYPE);
+  }
+  else if (backend_discovery_generation() != acc_generation)
+  {
+    acc_generation = backend_discovery_generation();
+    esp_http_client_set_url(acc_client, url);
+  }
 
-  // 4. Perform the request
-  esp_err_t err = esp_http_client_perform(client);
+  char seq[12], age[24];
+  snprintf(seq, sizeof(seq), "%lu", (unsigned long)batch->seq);
+  snprintf(age, sizeof(age), "%lld", batch_age_us(batch));
+  esp_http_client_set_header(acc_client, "X-Trace-Seq", seq);
+  esp_http_client_set_header(acc_client, "X-Sample-Age-Us", age);
+  esp_http_client_set_post_field(acc_client, (const char *)post_buffer, post_len);
+
+  // 3. Perform the request
+  esp_err_t err;
+  int64_t send_us;
+  clock_request_start(&send_us);
+  PERF_SCOPE(acc_post_timer)
+  {
+    err = esp_http_client_perform(acc_client);
+  }
+  clock_request_done(send_us);
   if (err == ESP_OK)
   {
-    printf("Sent 150 floats. Status = %d\n", esp_http_client_get_status_code(client));
+    printf("Sent batch %lu: %d samples in %u bytes at %.2f Hz. Status = %d\n", (unsigned long)batch->seq,
+           batch->count, (unsigned)post_len, batch->sample_rate_hz, esp_http_client_get_status_code(acc_client));
+  }
+  else
+  {
+    esp_http_client_close(acc_client); // reconnect on the next batch
+    backend_discovery_invalidate();    // the backend may have moved
   }
+}
 
-  // 5. Cleanup
-  esp_http_client_cleanup(client);
-  free(post_data);
+#if UPLOAD_UDP_STREAM
+#define BATCH_SAMPLES STREAM_BURST_SAMPLES
+#elif SAMPLING_USE_FIFO
+#define BATCH_SAMPLES ((800 >> SAMPLE_ODR) * BATCH_SECONDS)
+#else
+#define BATCH_SAMPLES 50 // 10 s at 5 Hz, as before
+#endif
+_Static_assert(BATCH_SAMPLES <= SAMPLE_BATCH_MAX_SAMPLES, "batch does not fit in sample_batch_t");
+_Static_assert(!UPLOAD_UDP_STREAM || SAMPLING_USE_FIFO, "UDP streaming sends FIFO bursts");
+_Static_assert(!ESPNOW_BROADCAST || (CADENCE_ON_DEVICE && SAMPLING_USE_FIFO),
+               "the ESP-NOW beat is the on-device cadence, sent per FIFO burst");
+_Static_assert(!MOTION_GATING || SAMPLING_USE_FIFO, "motion gating switches the sensor out of FIFO mode");
+_Static_assert(!LOW_POWER_MODE || (SAMPLING_USE_FIFO && !UPLOAD_UDP_STREAM),
+               "low-power mode sleeps between FIFO watermarks and coalesces uploads");
+
+// Log sensor state about every 2 s however small the batches are
+#define LOG_EVERY_BATCHES ((((800 >> SAMPLE_ODR) * 2) + BATCH_SAMPLES - 1) / BATCH_SAMPLES)
+
+#if CADENCE_ON_DEVICE
+static cadence_engine_t cadence;
+static int64_t last_step_us; // the sample that completed the latest step, 0 before the first
+_Static_assert(sizeof(mma8451_sample_t) == 3 * sizeof(int16_t), "cadence_engine_push() reads samples as x, y, z triplets");
+
+// Integer from the raw counts to the step detector, one sample at a time as
+// it enters the batch, so a step is stamped with the sample that completed it
+static void cadence_sample(const mma8451_sample_t *sample, int64_t t_us)
+{
+  if (cadence_engine_push(&cadence, &sample->x, 1) > 0)
+  {
+    last_step_us = t_us;
+  }
 }
 
-#define MAX_SAMPLES 150
-float accel_buffer[MAX_SAMPLES];
+// Floats only for the result
+static void run_cadence(sample_batch_t *batch)
+{
+  batch->bpm = cadence_engine_bpm(&cadence);
+  batch->confidence = cadence_engine_confidence(&cadence);
+}
+#endif
 
-esp_err_t mma8451_read_accel(float *x, float *y, float *z)
+#if ESPNOW_BROADCAST
+// Once per FIFO burst, so the lights hear of a step one burst after it
+// landed instead of one batch and two HTTP hops later
+static void broadcast_beat(void)
 {
-  uint8_t raw_data[6];
-  // Read 6 bytes starting from OUT_X_MSB (0x01)
-  esp_err_t ret = i2c_master_write_read_device(I2C_NUM_0, MMA8451_ADDR,
-                                               (uint8_t[]){0x01}, 1,
-                                               raw_data, 6, 1000 / portTICK_PERIOD_MS);
+  float bpm = cadence_engine_bpm(&cadence);
+  espnow_beat_t beat = {
+    .device = acc_payload_device_id(),
+    .bpm_milli = (uint32_t)(bpm * 1000.0f + 0.5f),
+    .confidence = cadence_engine_confidence(&cadence),
+    .mood = espnow_link_mood_for_bpm(bpm),
+    .last_step_us = last_step_us,
+  };
+  espnow_link_send(&beat);
+}
+#endif
+
+#if SAMPLING_USE_FIFO
+// Drained FIFO bursts; samples that don't fit in this batch start the next one
+static mma8451_sample_t fifo_burst[MMA8451_FIFO_SIZE];
+static int fifo_burst_len;
+static int fifo_burst_pos;
+static int64_t fifo_burst_first_us;
 
-  if (ret == ESP_OK)
+static void fill_batch(sample_batch_t *batch)
+{
+  while (batch->count < BATCH_SAMPLES)
   {
-    // 1. Combine into a full 16-bit signed integer first
-    // This keeps the sign bit at the very top (bit 15)
-    int16_t ix = (int16_t)((raw_data[0] << 8) | raw_data[1]);
-    int16_t iy = (int16_t)((raw_data[2] << 8) | raw_data[3]);
-    int16_t iz = (int16_t)((raw_data[4] << 8) | raw_data[5]);
-
-    // 2. The MMA8451 is 14-bit, left-justified.
-    // Instead of shifting and losing the sign, divide by 16384.0
-    // (4096 counts/g * 4 for the 2-bit left shift = 16384)
-    *x = ((float)ix / 16384.0) * GRAVITY_CONSTANT;
-    *y = ((float)iy / 16384.0) * GRAVITY_CONSTANT;
-    *z = ((float)iz / 16384.0) * GRAVITY_CONSTANT;
+    if (fifo_burst_pos == fifo_burst_len)
+    {
+      int64_t first_us;
+      int n = mma8451_fifo_read(fifo_burst, MMA8451_FIFO_SIZE, &first_us, pdMS_TO_TICKS(1000));
+      if (n < 0)
+      {
+        ESP_LOGW(TAG, "FIFO read failed");
+        vTaskDelay(pdMS_TO_TICKS(100));
+        continue;
+      }
+      fifo_burst_len = n;
+      fifo_burst_pos = 0;
+      fifo_burst_first_us = first_us;
+#if CADENCE_ON_DEVICE
+      cadence_engine_set_rate(&cadence, mma8451_fifo_rate_hz());
+#endif
+      continue;
+    }
+
+    // The batch may start part way into a burst
+    int64_t t_us = fifo_burst_first_us + (int64_t)(fifo_burst_pos * 1000000.0f / mma8451_fifo_rate_hz());
+    if (!sample_batch_push(batch, &fifo_burst[fifo_burst_pos], t_us))
+    {
+      break;
+    }
+#if CADENCE_ON_DEVICE
+    cadence_sample(&fifo_burst[fifo_burst_pos], t_us);
+#endif
+    fifo_burst_pos++;
+#if ESPNOW_BROADCAST
+    if (fifo_burst_pos == fifo_burst_len)
+    {
+      broadcast_beat();
+    }
+#endif
   }
-  return ret;
+  batch->sample_rate_hz = mma8451_fifo_rate_hz();
 }
-
-void collect_and_send_data()
+#else
+static void fill_batch(sample_batch_t *batch)
 {
-  int sample_count = 0;
+  TickType_t last_wake = xTaskGetTickCount();
 
-  while (sample_count < MAX_SAMPLES)
+  while (batch->count < BATCH_SAMPLES)
   {
-    float x, y, z;
-
-    // Read the sensor (Assuming you have a function to get current g-values)
-    if (mma8451_read_accel(&x, &y, &z) == ESP_OK)
+    // Read the sensor
+    mma8451_sample_t sample;
+    if (mma8451_read_sample(&sample) == ESP_OK)
     {
-      // Store just one axis (e.g., Z-axis) or compute magnitude
-      accel_buffer[sample_count] = x;
-      sample_count++;
-      accel_buffer[sample_count] = y;
-      sample_count++;
-      accel_buffer[sample_count] = z;
-      sample_count++;
+      int64_t t_us = esp_timer_get_time();
+      if (!sample_batch_push(batch, &sample, t_us))
+      {
+        break;
+      }
+#if CADENCE_ON_DEVICE
+      cadence_sample(&sample, t_us);
+#endif
     }
 
-    // Control your sampling rate (e.g., 100Hz = 10ms delay)
-    vTaskDelay(pdMS_TO_TICKS(200));
+    // Fixed 200 ms spacing, independent of how long the read took
+    xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(POLLED_PERIOD_MS));
   }
-
-  // Once the buffer is full, send it to your laptop (10.29.199.121)
-  post_acceleration_list(accel_buffer, MAX_SAMPLES);
+  batch->sample_rate_hz = POLLED_RATE_HZ;
 }
+#endif
 
-void app_main(void)
+#if MOTION_GATING
+PERF_COUNTER(idle_periods, "idle_periods");
+
+static int64_t last_motion_us;
+static int64_t last_motion_check_us;
+
+// Called between batches. Returns at once while the wearer moves; after
+// motion_idle_s of rest it parks the sensor on motion watch, blocks until the
+// wearer moves or turns the sensor, and returns the samples the rest spanned.
+static uint32_t gate_on_motion(void)
 {
+  int64_t now = esp_timer_get_time();
+  if (now - last_motion_check_us < MOTION_CHECK_MS * 1000LL)
+  {
+    return 0;
+  }
+  last_motion_check_us = now;
 
-  // WIFI
-  esp_err_t ret = nvs_flash_init();
-  if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+  bool moving = false;
+  if (mma8451_read_motion(&moving) != ESP_OK || moving)
   {
-    ESP_ERROR_CHECK(nvs_flash_erase());
-    ret = nvs_flash_init();
+    last_motion_us = now; // a bus error is no reason to stop sampling
+    return 0;
+  }
+  if (now - last_motion_us < motion_idle_s * 1000000LL)
+  {
+    return 0;
   }
-  ESP_ERROR_CHECK(ret);
-
-  // 2. Initialize TCP/IP and Event Loop
-  ESP_ERROR_CHECK(esp_netif_init());
-  ESP_ERROR_CHECK(esp_event_loop_create_default());
-  esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-  // esp_netif_create_default_wifi_sta();
-
-  // 3. Wi-Fi Configuration
-  wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-  ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-  wifi_config_t wifi_config = {
-      .sta = {
-          .ssid = "MIT",
-          .password = "RxS1T7_)hP",
-      },
-  };
 
-  ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-  ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+  ESP_LOGI(TAG, "No motion for %d s, sampling paused", motion_idle_s);
+  perf_count(&idle_periods, 1);
+  int64_t idle_start_us = esp_timer_get_time();
+  ESP_ERROR_CHECK(mma8451_start_motion_wake(MOTION_IDLE_ODR));
+  uint8_t source;
+  while ((source = mma8451_wait_motion(portMAX_DELAY)) == 0)
+  {
+  }
+  ESP_ERROR_CHECK(mma8451_start_fifo(SAMPLE_ODR, FIFO_WATERMARK, MMA8451_INT1_GPIO));
+
+  // What was left of the last burst is from before the rest
+  fifo_burst_len = 0;
+  fifo_burst_pos = 0;
+  last_motion_us = esp_timer_get_time();
+  int64_t idle_us = last_motion_us - idle_start_us;
+  ESP_LOGI(TAG, "Woke on %s after %lld s", (source & MMA8451_SRC_TRANS) ? "motion" : "an orientation change",
+           idle_us / 1000000);
+  return (uint32_t)(idle_us * mma8451_fifo_rate_hz() / 1000000);
+}
+#endif
 
-  // 4. Start!
-  ESP_ERROR_CHECK(esp_wifi_start());
-  esp_wifi_connect();
+#if CADENCE_ON_DEVICE
+PERF_TIMER(cadence_post_timer, "cadence_post");
 
-  // 1. Wait here indefinitely until notified by the event_handler
-  printf("Waiting for IP...\n");
-  esp_netif_ip_info_t ip_info;
+// Kept open between reports (HTTP keep-alive), re-pointed if the backend moves
+static esp_http_client_handle_t cadence_client;
+static uint32_t cadence_generation;
 
-  // This loop simply asks the system "Do we have an IP?" every 500ms
-  while (esp_netif_get_ip_info(sta_netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0)
+static void post_cadence(const sample_batch_t *batch)
+{
+  char body[160];
+  int len = snprintf(body, sizeof(body),
+                     "{\"device\": \"%08lx\", \"bpm\": %.1f, \"confidence\": %.2f, \"fs\": %.3f, \"seq\": %lu, "
+                     "\"age_us\": %lld}",
+                     (unsigned long)acc_payload_device_id(), batch->bpm, batch->confidence, batch->sample_rate_hz,
+                     (unsigned long)batch->seq, batch_age_us(batch));
+
+  char url[URL_MAX];
+  backend_discovery_url("/cadence", url, sizeof(url));
+  if (cadence_client == NULL)
+  {
+    cadence_generation = backend_discovery_generation();
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = 2000,
+        .event_handler = cadence_event_handler,
+        .keep_alive_enable = true,
+    };
+    cadence_client = esp_http_client_init(&config);
+    esp_http_client_set_header(cadence_client, "Content-Type", "application/json");
+  }
+  else if (backend_discovery_generation() != cadence_generation)
   {
-    vTaskDelay(pdMS_TO_TICKS(500));
+    cadence_generation = backend_discovery_generation();
+    esp_http_client_set_url(cadence_client, url);
   }
 
-  // 2. SUCCESS! The code only reaches this line once you have an IP.
-  printf("IP Received! Connecting to my server...\n");
-  make_google_request();
+  esp_http_client_set_post_field(cadence_client, body, len);
+  esp_err_t err;
+  int64_t send_us;
+  clock_request_start(&send_us);
+  PERF_SCOPE(cadence_post_timer)
+  {
+    err = esp_http_client_perform(cadence_client);
+  }
+  clock_request_done(send_us);
+  if (err != ESP_OK)
+  {
+    ESP_LOGW(TAG, "Cadence report failed: %s", esp_err_to_name(err));
+    esp_http_client_close(cadence_client); // reconnect on the next report
+    backend_discovery_invalidate();
+  }
+}
+#endif
 
-  // 1. Setup I2C
-  ESP_ERROR_CHECK(i2c_master_init());
-  ESP_LOGI(TAG, "I2C initialized on SDA:5, SCL:6");
+// Acquisition only: hands every full batch to the uploader and carries on
+void sampler_task(void *pvParameters)
+{
+  uint32_t total_samples = 0;
+  perf_watch_task(NULL);
+#if CADENCE_ON_DEVICE
+  const uint32_t input_hz = SAMPLING_USE_FIFO ? (800 >> SAMPLE_ODR) : (uint32_t)POLLED_RATE_HZ;
+  cadence_engine_init(&cadence, input_hz, CADENCE_RATE_HZ, cadence_tau_s, &cadence_config);
+#endif
 
-  // 2. Identity Check (Optional but recommended)
-  uint8_t who_am_i = 0;
-  uint8_t reg_who = REG_WHO_AM_I;
-  i2c_master_write_read_device(I2C_MASTER_NUM, MMA8451_ADDR, &reg_who, 1, &who_am_i, 1, pdMS_TO_TICKS(100));
+#if MOTION_GATING
+  last_motion_us = esp_timer_get_time();
+#endif
 
-  if (who_am_i != 0x1A)
+  while (1)
   {
-    ESP_LOGE(TAG, "Device ID 0x%02X not recognized! Check wiring.", who_am_i);
-    return;
+#if MOTION_GATING
+    uint32_t idle_samples = gate_on_motion();
+    total_samples += idle_samples; // the backend skips the gap like lost batches
+#if CADENCE_ON_DEVICE
+    if (idle_samples > 0)
+    {
+      cadence_engine_skip(&cadence, idle_samples);
+    }
+#endif
+#endif
+    sample_batch_t *batch = sample_batch_acquire();
+    batch->start_index = total_samples;
+    fill_batch(batch);
+    total_samples += batch->count;
+#if CADENCE_ON_DEVICE
+    run_cadence(batch);
+#endif
+    if (batch->seq % LOG_EVERY_BATCHES == 0)
+    {
+      log_sensor_state(&batch->samples[batch->count - 1]);
+    }
+    sample_batch_submit(batch);
   }
+}
 
-  // 3. Configure Sensor
-  write_reg(REG_CTRL_REG1, 0x00); // Standby
+void uploader_task(void *pvParameters)
+{
+#if CADENCE_ON_DEVICE
+  TickType_t last_cadence_report = 0;
+#endif
+
+  clock_sync_init(&backend_clock);
+  wifi_connect_wait(portMAX_DELAY);
+  ESP_ERROR_CHECK(backend_discovery_init("cadence-accel"));
+  perf_watch_task(NULL);
+  ESP_ERROR_CHECK(perf_report_start("accelerometer"));
+  ESP_ERROR_CHECK(ota_update_start("accelerometer"));
+  printf("IP Received! Connecting to my server...\n");
+  make_google_request();
+#if UPLOAD_UDP_STREAM
+  // mDNS gives the HTTP port; datagrams go to STREAM_PORT on the same host
+  ESP_ERROR_CHECK(acc_stream_init(backend_discovery_get().host, STREAM_PORT));
+#endif
 
-  // 2. Setup Orientation Engine
-  write_reg(0x11, 0x40); // PL_CFG: Enable PL
-  write_reg(0x12, 0x05); // PL_COUNT: Set a small debounce
-  write_reg(0x13, 0x44); // PL_BF_ZCOMP: Configure trip angles (Standard 45 deg)
+  while (1)
+  {
+    sample_batch_t *batch = sample_batch_wait_full(portMAX_DELAY);
+    if (batch == NULL)
+    {
+      continue;
+    }
+    if (!wifi_connect_is_connected())
+    {
+      // Reconnecting: drop the batch rather than stall on a connect timeout
+      perf_count(&dropped_batches, 1);
+      sample_batch_release(batch);
+      continue;
+    }
 
-  // 3. Set Range and Data Rate
-  write_reg(REG_XYZ_DATA_CFG, 0x00); // +/- 2g
+    // Once a batch is full, send it to the backend
+#if SEND_RAW_SAMPLES
+#if UPLOAD_UDP_STREAM
+    acc_stream_send(batch);
+#else
+    post_acceleration_list(batch);
+#endif
+#endif
+
+#if CADENCE_ON_DEVICE
+    // A few dozen bytes at most once a second, however small the batches are
+    TickType_t now = xTaskGetTickCount();
+    if (now - last_cadence_report >= pdMS_TO_TICKS(cadence_report_ms))
+    {
+      last_cadence_report = now;
+      post_cadence(batch);
+    }
+#endif
+    sample_batch_release(batch);
+  }
+}
 
-  // 4. Return to ACTIVE mode
-  write_reg(REG_CTRL_REG1, 0x01);
+// Task stacks are static, in bytes. /telemetry reports each one's free bytes
+// at its deepest point so far ("stacks"); trim against that, keeping a margin
+// for paths a short run doesn't hit (reconnects, OTA).
+#define SAMPLER_STACK_SIZE 4096
+#define UPLOADER_STACK_SIZE 4096
 
-  while (1)
-  {
-    uint8_t data[6];
-    uint8_t pl_status = 0;
-    uint8_t reg_start = REG_OUT_X_MSB;
-    uint8_t reg_pl = REG_PL_STATUS;
+static StackType_t sampler_stack[SAMPLER_STACK_SIZE];
+static StaticTask_t sampler_tcb;
+static StackType_t uploader_stack[UPLOADER_STACK_SIZE];
+static StaticTask_t uploader_tcb;
 
-    collect_and_send_data();
+void app_main(void)
+{
+#if RUN_KERNEL_BENCHMARK
+  accel_run_benchmark();
+#endif
+  ESP_ERROR_CHECK(node_config_load(tunables, sizeof(tunables) / sizeof(tunables[0])));
+
+  // The backend keeps a cadence per device; the low half of the MAC is
+  // unique enough for a room full of wearers and stable across reboots
+  uint8_t mac[6];
+  ESP_ERROR_CHECK(esp_read_mac(mac, ESP_MAC_WIFI_STA));
+  acc_payload_set_device_id((uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5]);
+  ESP_LOGI(TAG, "Device ID %08lx", (unsigned long)acc_payload_device_id());
+
+  // 1. Wi-Fi connects in the background; sampling doesn't wait for it
+  wifi_connect_config_t wifi_config = WIFI_CONNECT_CONFIG_DEFAULT();
+#if LOW_POWER_MODE
+  wifi_config.power_save = WIFI_PS_MAX_MODEM;
+  wifi_config.listen_interval = WIFI_LISTEN_INTERVAL;
+#endif
+  ESP_ERROR_CHECK(wifi_connect_start(&wifi_config));
+#if ESPNOW_BROADCAST
+  ESP_ERROR_CHECK(espnow_link_init());
+#endif
+
+  // 2. Setup I2C
+  ESP_ERROR_CHECK(i2c_bus_init());
+  ESP_LOGI(TAG, "I2C initialized on SDA:5, SCL:6");
+
+  // 3. Identity check and sensor configuration
+  if (mma8451_init(i2c_bus) != ESP_OK)
+  {
+    return;
   }
+
+  // 4. Start sampling
+#if SAMPLING_USE_FIFO
+#if MOTION_GATING
+  mma8451_set_motion_threshold(motion_threshold_mg);
+#endif
+  ESP_ERROR_CHECK(mma8451_start_fifo(SAMPLE_ODR, FIFO_WATERMARK, MMA8451_INT1_GPIO));
+#if LOW_POWER_MODE
+  power_init();
+#endif
+#else
+  mma8451_start_polled();
+#endif
+
+  // 5. Sample and upload in parallel: the sampler on the real-time core, so
+  // a burst is never held up by the uploader or the Wi-Fi stack
+  ESP_ERROR_CHECK(sample_batch_pool_init());
+  xTaskCreateStaticPinnedToCore(sampler_task, "sampler_task", SAMPLER_STACK_SIZE, NULL, TASK_PRIO_REALTIME,
+                                sampler_stack, &sampler_tcb, TASK_CORE_REALTIME);
+  xTaskCreateStaticPinnedToCore(uploader_task, "uploader_task", UPLOADER_STACK_SIZE, NULL, TASK_PRIO_NETWORK,
+                                uploader_stack, &uploader_tcb, TASK_CORE_NETWORK);
 }
\ No newline at end of file
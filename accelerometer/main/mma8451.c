@@ -0,0 +1,429 @@
+#include "mma8451.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "esp_sleep.h"
+#include "freertos/semphr.h"
+#include "perf_counters.h"
+
+static const char *TAG = "MMA8451";
+
+#define MMA8451_RATE_MIN_SPAN_US 2000000 // measure the data rate over at least 2 s
+#define TRANSIENT_DEBOUNCE_SAMPLES 2    // samples over the threshold before an event; 40 ms at 50 Hz
+
+static i2c_master_dev_handle_t s_dev;
+static mma8451_bus_stats_t s_bus;
+
+// FIFO mode state
+static SemaphoreHandle_t s_watermark_sem;
+static StaticSemaphore_t s_watermark_sem_buf;
+static volatile int64_t s_isr_us; // time of the latest watermark edge
+static uint8_t s_watermark;
+static int s_int1_gpio = -1;
+static bool s_level_wake; // INT1 is level-triggered so it can wake the chip from light sleep
+static float s_nominal_hz;
+static int64_t s_next_us; // predicted time of the next sample to be drained
+static int64_t s_rate_base_us;
+static uint32_t s_rate_base_samples;
+static mma8451_fifo_stats_t s_stats;
+static uint8_t s_transient_ths; // TRANSIENT_THS counts, 0 for no motion detection
+
+static esp_err_t count_transfer(esp_err_t err)
+{
+  s_bus.transfers++;
+  if (err != ESP_OK)
+  {
+    s_bus.errors++;
+    if (err == ESP_ERR_TIMEOUT)
+    {
+      s_bus.timeouts++;
+    }
+    s_bus.last_error = err;
+  }
+  return err;
+}
+
+esp_err_t mma8451_write_reg(uint8_t reg, uint8_t data)
+{
+  uint8_t write_buf[2] = {reg, data};
+  return count_transfer(i2c_master_transmit(s_dev, write_buf, 2, MMA8451_I2C_TIMEOUT_MS));
+}
+
+PERF_TIMER(i2c_read_timer, "i2c_read");
+
+// Register read with auto-increment: write the start address, repeated start, read len bytes
+static esp_err_t read_regs(uint8_t reg, uint8_t *data, size_t len)
+{
+  esp_err_t err;
+  PERF_SCOPE(i2c_read_timer)
+  {
+    err = i2c_master_transmit_receive(s_dev, &reg, 1, data, len, MMA8451_I2C_TIMEOUT_MS);
+  }
+  return count_transfer(err);
+}
+
+const mma8451_bus_stats_t *mma8451_bus_stats(void)
+{
+  return &s_bus;
+}
+
+esp_err_t mma8451_init(i2c_master_bus_handle_t bus)
+{
+  i2c_device_config_t dev_cfg = {
+      .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+      .device_address = MMA8451_ADDR,
+      .scl_speed_hz = MMA8451_SCL_SPEED_HZ,
+  };
+  esp_err_t err = i2c_master_bus_add_device(bus, &dev_cfg, &s_dev);
+  if (err != ESP_OK)
+  {
+    return err;
+  }
+  memset(&s_bus, 0, sizeof(s_bus));
+
+  // Identity Check
+  uint8_t who_am_i = 0;
+  err = read_regs(REG_WHO_AM_I, &who_am_i, 1);
+  if (err != ESP_OK || who_am_i != MMA8451_WHO_AM_I_VALUE)
+  {
+    ESP_LOGE(TAG, "Device ID 0x%02X not recognized! Check wiring.", who_am_i);
+    return ESP_ERR_NOT_FOUND;
+  }
+
+  mma8451_write_reg(REG_CTRL_REG1, 0x00); // Standby
+
+  // Setup Orientation Engine
+  mma8451_write_reg(REG_PL_CFG, 0x40);      // Enable PL
+  mma8451_write_reg(REG_PL_COUNT, 0x05);    // Set a small debounce
+  mma8451_write_reg(REG_PL_BF_ZCOMP, 0x44); // Configure trip angles (Standard 45 deg)
+
+  // Set Range
+  return mma8451_write_reg(REG_XYZ_DATA_CFG, 0x00); // +/- 2g
+}
+
+esp_err_t mma8451_start_polled(void)
+{
+  return mma8451_write_reg(REG_CTRL_REG1, 0x01); // ACTIVE at the default 800 Hz
+}
+
+// Combine MSB/LSB into a full 16-bit signed integer first.
+// This keeps the sign bit at the very top (bit 15)
+static void unpack_samples(const uint8_t *raw, mma8451_sample_t *out, int count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    const uint8_t *p = &raw[i * MMA8451_BYTES_PER_SAMPLE];
+    out[i].x = (int16_t)((p[0] << 8) | p[1]);
+    out[i].y = (int16_t)((p[2] << 8) | p[3]);
+    out[i].z = (int16_t)((p[4] << 8) | p[5]);
+  }
+}
+
+esp_err_t mma8451_read_sample(mma8451_sample_t *out)
+{
+  uint8_t raw_data[MMA8451_BYTES_PER_SAMPLE];
+  // Read 6 bytes starting from OUT_X_MSB (0x01)
+  esp_err_t ret = read_regs(REG_OUT_X_MSB, raw_data, sizeof(raw_data));
+  if (ret == ESP_OK)
+  {
+    unpack_samples(raw_data, out, 1);
+  }
+  return ret;
+}
+
+esp_err_t mma8451_read_accel(float *x, float *y, float *z)
+{
+  mma8451_sample_t sample;
+  esp_err_t ret = mma8451_read_sample(&sample);
+
+  if (ret == ESP_OK)
+  {
+    // The MMA8451 is 14-bit, left-justified: 4096 counts/g * 4 for the
+    // 2-bit left shift = 16384 counts/g on the raw int16
+    *x = mma8451_to_ms2(sample.x);
+    *y = mma8451_to_ms2(sample.y);
+    *z = mma8451_to_ms2(sample.z);
+  }
+  return ret;
+}
+
+esp_err_t mma8451_read_orientation(uint8_t *pl_status)
+{
+  return read_regs(REG_PL_STATUS, pl_status, 1);
+}
+
+void mma8451_set_motion_threshold(uint16_t threshold_mg)
+{
+  uint32_t counts = (threshold_mg + MMA8451_TRANSIENT_MG_PER_COUNT / 2) / MMA8451_TRANSIENT_MG_PER_COUNT;
+  if (threshold_mg > 0 && counts == 0)
+  {
+    counts = 1;
+  }
+  s_transient_ths = counts > 0x7F ? 0x7F : (uint8_t)counts;
+}
+
+// Transient detector on the high-pass filtered data of all three axes, events
+// latched in TRANSIENT_SRC until it is read. Standby only.
+static void configure_transient(void)
+{
+  if (s_transient_ths == 0)
+  {
+    mma8451_write_reg(REG_TRANSIENT_CFG, 0x00);
+    return;
+  }
+  mma8451_write_reg(REG_TRANSIENT_CFG, 0x1E); // ELE, ZTEFE, YTEFE, XTEFE
+  mma8451_write_reg(REG_TRANSIENT_THS, s_transient_ths);
+  mma8451_write_reg(REG_TRANSIENT_COUNT, TRANSIENT_DEBOUNCE_SAMPLES);
+}
+
+esp_err_t mma8451_read_motion(bool *moving)
+{
+  uint8_t src = 0;
+  esp_err_t err = read_regs(REG_TRANSIENT_SRC, &src, 1);
+  *moving = err == ESP_OK && (src & MMA8451_TRANSIENT_EA);
+  return err;
+}
+
+static void IRAM_ATTR mma8451_int1_isr(void *arg)
+{
+  BaseType_t woken = pdFALSE;
+  s_isr_us = esp_timer_get_time();
+  if (s_level_wake)
+  {
+    // INT1 stays low until F_STATUS is read; mask it until the drain
+    gpio_intr_disable(s_int1_gpio);
+  }
+  xSemaphoreGiveFromISR(s_watermark_sem, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+esp_err_t mma8451_start_fifo(mma8451_odr_t odr, uint8_t watermark, int int1_gpio)
+{
+  if (watermark == 0 || watermark > MMA8451_FIFO_SIZE)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  esp_err_t err;
+  if (s_watermark_sem == NULL)
+  {
+    s_int1_gpio = int1_gpio;
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_watermark_sem = xSemaphoreCreateBinaryStatic(&s_watermark_sem_buf);
+
+    // INT1 is active low, push-pull
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << int1_gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    ESP_ERROR_CHECK(gpio_config(&io_conf));
+    err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) // already installed is fine
+    {
+      return err;
+    }
+    ESP_ERROR_CHECK(gpio_isr_handler_add(int1_gpio, mma8451_int1_isr, NULL));
+  }
+  else if (int1_gpio != s_int1_gpio)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  s_watermark = watermark;
+  float nominal_hz = 800.0f / (1 << odr);
+  if (nominal_hz != s_nominal_hz)
+  {
+    s_nominal_hz = nominal_hz;
+    s_stats.measured_hz = nominal_hz;
+  }
+  s_rate_base_us = 0;
+  s_next_us = 0;
+
+  // The FIFO can only be configured in standby
+  mma8451_write_reg(REG_CTRL_REG1, 0x00);
+  mma8451_write_reg(REG_F_SETUP, 0x40 | watermark); // F_MODE=01 circular, F_WMRK
+  mma8451_write_reg(REG_CTRL_REG2, 0x00);           // normal oversampling
+  mma8451_write_reg(REG_CTRL_REG3, 0x00);           // INT active low, push-pull
+  mma8451_write_reg(REG_CTRL_REG4, 0x40);           // INT_EN_FIFO; transients only latch
+  mma8451_write_reg(REG_CTRL_REG5, 0x40);           // FIFO interrupt on INT1
+  configure_transient();
+  xSemaphoreTake(s_watermark_sem, 0); // an edge left over from motion watch is not a watermark
+
+  err = mma8451_write_reg(REG_CTRL_REG1, (odr << 3) | 0x01); // DR, ACTIVE
+  if (err == ESP_OK)
+  {
+    ESP_LOGI(TAG, "FIFO mode at %.0f Hz, watermark %u, INT1 on GPIO %d", s_nominal_hz, watermark, int1_gpio);
+  }
+  return err;
+}
+
+esp_err_t mma8451_enable_wakeup(void)
+{
+  if (s_int1_gpio < 0)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  // Light sleep stops the GPIO edge detector, only a level can wake the chip.
+  // This also switches the interrupt to low level for the awake case.
+  esp_err_t err = gpio_wakeup_enable(s_int1_gpio, GPIO_INTR_LOW_LEVEL);
+  if (err == ESP_OK)
+  {
+    err = esp_sleep_enable_gpio_wakeup();
+  }
+  if (err == ESP_OK)
+  {
+    s_level_wake = true;
+  }
+  return err;
+}
+
+esp_err_t mma8451_start_motion_wake(mma8451_odr_t odr)
+{
+  if (s_watermark_sem == NULL || s_transient_ths == 0)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  mma8451_write_reg(REG_CTRL_REG1, 0x00);
+  mma8451_write_reg(REG_F_SETUP, 0x00);   // FIFO off
+  mma8451_write_reg(REG_CTRL_REG2, 0x03); // MODS=11 low power: lowest current at this rate
+  mma8451_write_reg(REG_CTRL_REG4, 0x30); // INT_EN_TRANS, INT_EN_LNDPRT
+  mma8451_write_reg(REG_CTRL_REG5, 0x30); // both on INT1
+  configure_transient();
+  xSemaphoreTake(s_watermark_sem, 0);
+
+  // Clear whatever is latched, so only new events wake us
+  uint8_t discard;
+  read_regs(REG_TRANSIENT_SRC, &discard, 1);
+  read_regs(REG_PL_STATUS, &discard, 1);
+
+  esp_err_t err = mma8451_write_reg(REG_CTRL_REG1, (odr << 3) | 0x01);
+  if (err == ESP_OK)
+  {
+    ESP_LOGI(TAG, "Watching for motion over %u mg", s_transient_ths * MMA8451_TRANSIENT_MG_PER_COUNT);
+  }
+  return err;
+}
+
+uint8_t mma8451_wait_motion(TickType_t timeout)
+{
+  bool have_edge = xSemaphoreTake(s_watermark_sem, timeout) == pdTRUE;
+  uint8_t source = 0;
+  if (have_edge && read_regs(REG_INT_SOURCE, &source, 1) == ESP_OK)
+  {
+    // Reading the event's own source register releases INT1
+    uint8_t discard;
+    if (source & MMA8451_SRC_TRANS)
+    {
+      read_regs(REG_TRANSIENT_SRC, &discard, 1);
+    }
+    if (source & MMA8451_SRC_LNDPRT)
+    {
+      read_regs(REG_PL_STATUS, &discard, 1);
+    }
+  }
+  if (have_edge && s_level_wake)
+  {
+    gpio_intr_enable(s_int1_gpio);
+  }
+  return source & (MMA8451_SRC_TRANS | MMA8451_SRC_LNDPRT);
+}
+
+float mma8451_fifo_rate_hz(void)
+{
+  return s_stats.measured_hz;
+}
+
+const mma8451_fifo_stats_t *mma8451_fifo_stats(void)
+{
+  return &s_stats;
+}
+
+int mma8451_fifo_read(mma8451_sample_t *out, int max, int64_t *first_us, TickType_t timeout)
+{
+  bool have_edge = xSemaphoreTake(s_watermark_sem, timeout) == pdTRUE;
+  int64_t isr_us = s_isr_us;
+  if (!have_edge)
+  {
+    s_stats.timeouts++;
+  }
+
+  if (max > MMA8451_FIFO_SIZE)
+  {
+    max = MMA8451_FIFO_SIZE;
+  }
+
+  // F_STATUS followed by FIFO data. With F_MODE set the register pointer
+  // runs from F_STATUS into OUT_X_MSB and wraps from OUT_Z_LSB back to
+  // OUT_X_MSB, so one read returns the status and the first samples.
+  // Reading F_STATUS also clears the FIFO interrupt.
+  static uint8_t raw[1 + MMA8451_FIFO_SIZE * MMA8451_BYTES_PER_SAMPLE];
+  int expected = have_edge && s_watermark <= max ? s_watermark : 0;
+  esp_err_t err = read_regs(REG_F_STATUS, raw, 1 + expected * MMA8451_BYTES_PER_SAMPLE);
+  if (s_level_wake)
+  {
+    gpio_intr_enable(s_int1_gpio); // fires again at once if the read didn't release INT1
+  }
+  if (err != ESP_OK)
+  {
+    return -1;
+  }
+
+  uint8_t status = raw[0];
+  int count = status & 0x3F;
+  if (status & 0x80)
+  {
+    // Samples were dropped, so the sample count no longer matches the edge times
+    s_stats.overflows++;
+    s_rate_base_us = 0;
+  }
+  if (count > max)
+  {
+    count = max;
+  }
+
+  // The FIFO filled past the watermark before we got here: fetch the rest
+  if (count > expected &&
+      read_regs(REG_OUT_X_MSB, raw + 1 + expected * MMA8451_BYTES_PER_SAMPLE,
+                (count - expected) * MMA8451_BYTES_PER_SAMPLE) != ESP_OK)
+  {
+    return -1;
+  }
+
+  unpack_samples(raw + 1, out, count);
+
+  float period_us = 1000000.0f / s_stats.measured_hz;
+
+  if (have_edge)
+  {
+    // The edge fired when sample number (drained + watermark) was written
+    uint32_t edge_sample = s_stats.samples + s_watermark;
+    *first_us = isr_us - (int64_t)((s_watermark - 1) * period_us);
+
+    if (s_rate_base_us == 0)
+    {
+      s_rate_base_us = isr_us;
+      s_rate_base_samples = edge_sample;
+    }
+    else if (isr_us - s_rate_base_us >= MMA8451_RATE_MIN_SPAN_US)
+    {
+      s_stats.measured_hz = (edge_sample - s_rate_base_samples) * 1000000.0f / (isr_us - s_rate_base_us);
+    }
+  }
+  else
+  {
+    // No edge to anchor on: continue from the previous burst
+    *first_us = s_next_us != 0 ? s_next_us : esp_timer_get_time() - (int64_t)(count * period_us);
+  }
+
+  s_next_us = *first_us + (int64_t)(count * period_us);
+  s_stats.samples += count;
+  s_stats.bursts++;
+  return count;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/i2c_master.h"
+#include "freertos/FreeRTOS.h"
+#include "accel_sample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MMA8451 accelerometer on the i2c_master bus/device driver.
+//
+// Two ways to sample:
+//  - polled: mma8451_read_accel() reads the latest output registers
+//  - FIFO:   the sensor samples at its own output data rate into its 32-entry
+//            FIFO and pulls INT1 low at the watermark; mma8451_fifo_read()
+//            waits for that edge and drains the FIFO in one burst. The edge
+//            is timestamped in the ISR, which gives every sample a timestamp
+//            and lets the real output data rate be measured.
+//
+// Between FIFO sessions the sensor can be left watching for motion at a low
+// rate (mma8451_start_motion_wake()): its transient detector (high-pass
+// filtered acceleration over a threshold) and the orientation engine are the
+// only things on INT1, so nothing is read until the wearer moves.
+//
+// All transfers go through one device handle with a short timeout and are
+// counted in mma8451_bus_stats(), so a flaky bus shows up in the logs
+// instead of stalling the sampler for a second per read.
+
+#define MMA8451_ADDR 0x1D
+#define MMA8451_SCL_SPEED_HZ 400000
+#define MMA8451_I2C_TIMEOUT_MS 10 // a full 192-byte FIFO drain takes ~5 ms at 400 kHz
+#define MMA8451_WHO_AM_I_VALUE 0x1A
+#define MMA8451_FIFO_SIZE 32
+
+// Registers
+#define REG_F_STATUS 0x00
+#define REG_OUT_X_MSB 0x01
+#define REG_F_SETUP 0x09
+#define REG_INT_SOURCE 0x0C
+#define REG_WHO_AM_I 0x0D
+#define REG_XYZ_DATA_CFG 0x0E
+#define REG_PL_STATUS 0x10 // Portrait/Landscape Status
+#define REG_PL_CFG 0x11    // Portrait/Landscape Configuration
+#define REG_PL_COUNT 0x12
+#define REG_PL_BF_ZCOMP 0x13
+#define REG_TRANSIENT_CFG 0x1D
+#define REG_TRANSIENT_SRC 0x1E
+#define REG_TRANSIENT_THS 0x1F
+#define REG_TRANSIENT_COUNT 0x20
+#define REG_CTRL_REG1 0x2A
+#define REG_CTRL_REG2 0x2B
+#define REG_CTRL_REG3 0x2C
+#define REG_CTRL_REG4 0x2D
+#define REG_CTRL_REG5 0x2E
+
+// Output data rates (CTRL_REG1 DR bits)
+typedef enum
+{
+  MMA8451_ODR_800HZ = 0,
+  MMA8451_ODR_400HZ = 1,
+  MMA8451_ODR_200HZ = 2,
+  MMA8451_ODR_100HZ = 3,
+  MMA8451_ODR_50HZ = 4,
+  MMA8451_ODR_12_5HZ = 5, // the slow rates are for mma8451_start_motion_wake() only
+  MMA8451_ODR_6_25HZ = 6,
+  MMA8451_ODR_1_56HZ = 7,
+} mma8451_odr_t;
+
+// PL_STATUS bits
+#define MMA8451_PL_NEWLP 0x80 // orientation changed since the last read
+
+// INT_SOURCE bits
+#define MMA8451_SRC_FIFO 0x40
+#define MMA8451_SRC_TRANS 0x20  // transient (motion) event
+#define MMA8451_SRC_LNDPRT 0x10 // orientation change
+
+#define MMA8451_TRANSIENT_MG_PER_COUNT 63 // TRANSIENT_THS step, independent of range
+#define MMA8451_TRANSIENT_EA 0x40         // TRANSIENT_SRC: an event happened since the last read
+
+typedef struct
+{
+  uint32_t transfers;
+  uint32_t errors;   // failed transfers, including timeouts
+  uint32_t timeouts;
+  esp_err_t last_error;
+} mma8451_bus_stats_t;
+
+typedef struct
+{
+  uint32_t samples;    // samples drained from the FIFO
+  uint32_t bursts;     // FIFO drains
+  uint32_t overflows;  // drains that found the FIFO overflowed (samples lost)
+  uint32_t timeouts;   // waits that ended without a watermark interrupt
+  float measured_hz;   // output data rate measured from the interrupt timestamps
+} mma8451_fifo_stats_t;
+
+// Add the sensor to bus, check WHO_AM_I and configure range and
+// orientation detection. Leaves the sensor in standby.
+esp_err_t mma8451_init(i2c_master_bus_handle_t bus);
+
+esp_err_t mma8451_write_reg(uint8_t reg, uint8_t data);
+
+// Polled mode: activate at the default data rate
+esp_err_t mma8451_start_polled(void);
+esp_err_t mma8451_read_sample(mma8451_sample_t *out);
+esp_err_t mma8451_read_accel(float *x, float *y, float *z);
+
+// PL_STATUS. OUT_Z_LSB auto-increments back to the start of the output
+// registers rather than on to 0x10, so this is always its own short read.
+esp_err_t mma8451_read_orientation(uint8_t *pl_status);
+
+const mma8451_bus_stats_t *mma8451_bus_stats(void);
+
+// Transient detection threshold, applied by the next mma8451_start_fifo() or
+// mma8451_start_motion_wake() (the registers only take writes in standby).
+// 0, the default, leaves the detector off.
+void mma8451_set_motion_threshold(uint16_t threshold_mg);
+
+// Whether a transient was detected since the last call. Latched in the
+// sensor, so polling this once a second misses nothing.
+esp_err_t mma8451_read_motion(bool *moving);
+
+// Leave FIFO mode for motion watch: FIFO off, low-power oversampling at odr,
+// INT1 on transient and orientation events only. Needs mma8451_start_fifo()
+// to have set up INT1 and a threshold from mma8451_set_motion_threshold().
+// mma8451_start_fifo() goes back to sampling.
+esp_err_t mma8451_start_motion_wake(mma8451_odr_t odr);
+
+// Wait up to timeout for a motion watch event; returns its MMA8451_SRC_TRANS
+// and/or MMA8451_SRC_LNDPRT bits (cleared in the sensor), 0 on a timeout or
+// bus error
+uint8_t mma8451_wait_motion(TickType_t timeout);
+
+// FIFO mode: sample at odr, interrupt on int1_gpio every watermark samples.
+// Called again after mma8451_start_motion_wake() it resumes sampling; the
+// stats carry on and the timestamps re-anchor on the next edge.
+esp_err_t mma8451_start_fifo(mma8451_odr_t odr, uint8_t watermark, int int1_gpio);
+
+// Let the watermark interrupt wake the chip from light sleep (call after
+// mma8451_start_fifo). INT1 becomes level-triggered, masked from the edge
+// until the next drain; timestamps gain the wake-up latency (well under 1 ms).
+esp_err_t mma8451_enable_wakeup(void);
+
+// Wait up to timeout for the watermark, then drain the FIFO into out (max
+// should be MMA8451_FIFO_SIZE). After the edge, F_STATUS and the watermark's
+// worth of samples come in one transfer; only a FIFO that has filled past the
+// watermark needs a second one.
+// Returns the number of samples (>= 0) or -1 on a bus error. *first_us is the
+// esp_timer time of out[0]; samples are 1 / mma8451_fifo_rate_hz() apart.
+int mma8451_fifo_read(mma8451_sample_t *out, int max, int64_t *first_us, TickType_t timeout);
+
+// Measured output data rate once a few bursts have been seen, nominal before
+float mma8451_fifo_rate_hz(void);
+const mma8451_fifo_stats_t *mma8451_fifo_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+#include "sample_batch.h"
+
+#include "esp_log.h"
+#include "freertos/queue.h"
+
+static const char *TAG = "SAMPLE_BATCH";
+
+static sample_batch_t s_batches[SAMPLE_BATCH_COUNT];
+static QueueHandle_t s_free; // empty batches for the sampler
+static QueueHandle_t s_full; // filled batches for the uploader
+static StaticQueue_t s_free_queue;
+static StaticQueue_t s_full_queue;
+static uint8_t s_free_storage[SAMPLE_BATCH_COUNT * sizeof(sample_batch_t *)];
+static uint8_t s_full_storage[SAMPLE_BATCH_COUNT * sizeof(sample_batch_t *)];
+static uint32_t s_seq;
+static uint32_t s_dropped;
+
+esp_err_t sample_batch_pool_init(void)
+{
+  s_free = xQueueCreateStatic(SAMPLE_BATCH_COUNT, sizeof(sample_batch_t *), s_free_storage, &s_free_queue);
+  s_full = xQueueCreateStatic(SAMPLE_BATCH_COUNT, sizeof(sample_batch_t *), s_full_storage, &s_full_queue);
+
+  for (int i = 0; i < SAMPLE_BATCH_COUNT; i++)
+  {
+    sample_batch_t *batch = &s_batches[i];
+    xQueueSend(s_free, &batch, 0);
+  }
+  return ESP_OK;
+}
+
+sample_batch_t *sample_batch_acquire(void)
+{
+  sample_batch_t *batch = NULL;
+
+  if (xQueueReceive(s_free, &batch, 0) != pdTRUE)
+  {
+    // The uploader holds one batch and the rest are queued: recycle the oldest
+    // queued one. The batch being sent is never in s_full, so it is never
+    // overwritten, and with SAMPLE_BATCH_COUNT >= 3 s_full can't be empty here.
+    xQueueReceive(s_full, &batch, portMAX_DELAY);
+    s_dropped++;
+    ESP_LOGW(TAG, "Uploader behind, dropped batch %lu", (unsigned long)batch->seq);
+  }
+
+  batch->count = 0;
+  batch->first_us = 0;
+  batch->seq = s_seq++;
+  return batch;
+}
+
+void sample_batch_submit(sample_batch_t *batch)
+{
+  xQueueSend(s_full, &batch, 0); // never full: there are only SAMPLE_BATCH_COUNT batches
+}
+
+sample_batch_t *sample_batch_wait_full(TickType_t timeout)
+{
+  sample_batch_t *batch = NULL;
+  if (xQueueReceive(s_full, &batch, timeout) != pdTRUE)
+  {
+    return NULL;
+  }
+  return batch;
+}
+
+void sample_batch_release(sample_batch_t *batch)
+{
+  xQueueSend(s_free, &batch, 0);
+}
+
+uint32_t sample_batch_dropped(void)
+{
+  return s_dropped;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "accel_sample.h"
+
+// Batches handed from the sampler task to the uploader task.
+//
+// The sampler fills one batch while the uploader posts another, so
+// acquisition never pauses for JSON building or the HTTP round trip. A third
+// batch lets one finished batch wait while a slow POST is still running. If
+// the uploader falls further behind, the sampler takes back the oldest unsent
+// batch instead of blocking: the backend then misses a stale batch, but the
+// sample stream itself never stops.
+
+#define SAMPLE_BATCH_COUNT 3 // filling, queued, uploading
+
+esp_err_t sample_batch_pool_init(void);
+
+// Sampler side: get an empty batch (never blocks), hand a full one over
+sample_batch_t *sample_batch_acquire(void);
+void sample_batch_submit(sample_batch_t *batch);
+
+// Uploader side: wait for a full batch, give it back once sent
+sample_batch_t *sample_batch_wait_full(TickType_t timeout);
+void sample_batch_release(sample_batch_t *batch);
+
+// Batches reclaimed by the sampler before they were uploaded
+uint32_t sample_batch_dropped(void);
@@ -1,22 +1,95 @@
-from fastapi import FastAPI, Request
-from typing import List
+from fastapi import FastAPI, HTTPException, Request
+from fastapi.exceptions import RequestValidationError
+from fastapi.responses import FileResponse, StreamingResponse
+from pydantic import ValidationError
+from typing import Dict, List, Optional, Tuple
+from contextlib import asynccontextmanager
+from dataclasses import dataclass, field
 from enum import Enum
 from pydantic import BaseModel
+import asyncio
+from collections import deque
+import json
+import os
+import socket
+import struct
 import numpy as np
 import time
 
+try:
+    from . import cadence_engine
+except ImportError:  # run from inside api_endpoint/
+    import cadence_engine
+
 # ============================================
 # CONFIG
 # ============================================
 
-fs = 5
+fs = 5  # default sample rate, for senders that don't report "fs"
+# Cadence engine tuning (components/cadence, the accelerometer's defaults);
+# read whenever the engine is (re)created, so replay.py can override them
 MAX_INTERVALS = 10
+DEAD_ZONE = 1.2  # m/s^2 either side of the baseline before a crossing counts
+BASELINE_TAU_SECONDS = 2.0  # time constant of the baseline, rounded by the engine to a power-of-two alpha
+MIN_STEP_INTERVAL = 0.4  # seconds; shorter intervals are bounce, not steps
+STILL_THRESHOLD_SECONDS = 2  # no step for this long clears the history
+CADENCE_RATE_HZ = 25  # the engine decimates to at least this rate, as on the device
+GRAVITY_CONSTANT = 9.80665
+ACC_UDP_PORT = 8001  # binary batches streamed by the accelerometer over UDP
+HTTP_PORT = int(os.environ.get("CADENCE_HTTP_PORT", "8000"))  # what uvicorn listens on, advertised over mDNS
+MDNS_SERVICE_TYPE = "_cadence._tcp.local."
+PUSH_BPM_THRESHOLD = 2.0  # /led_events pushes when the tempo moves at least this far (or the mood changes)
+PUSH_REFRESH_SECONDS = 15  # otherwise the state is re-sent this often, which doubles as the keep-alive
+FAST_REFRESH_MS = 500  # poll hint for the LED node while the cadence is moving or uncertain
+SETTLE_SECONDS = 5  # the tempo counts as moving for this long after a change
+LOW_CONFIDENCE = 0.5
+STREAM_RESTART_SAMPLES = 256  # a start_index further back than this is a device restart, not reordering
+TRACE_HISTORY = 4000  # trace events kept for GET /trace
+TRACE_ORIGINS = 64  # batches whose sample time is remembered for the end-to-end latency
+RECORD_PATH = os.environ.get("CADENCE_RECORD")  # append every binary batch here, for replay.py
+RECORD_MAGIC = b"CADREC1\n"
+RECORD_ENTRY = struct.Struct("<dI")  # arrival time, payload length; then the acc_payload batch as received
+DEFAULT_DEVICE = "default"  # wearer of batches with neither a device ID nor a sender address
+MAX_WEARERS = 64  # beyond this the longest-silent wearer no LED node streams is forgotten
+REORDER_WAIT_SECONDS = 0.3  # a missing UDP batch is waited for this long (synced sample time) before it counts as lost
+REORDER_MAX_BATCHES = 16  # batches held back behind one gap at most
+FIRMWARE_DIR = os.environ.get("CADENCE_FIRMWARE_DIR",
+                              os.path.join(os.path.dirname(__file__), "firmware"))  # <node>.bin per node
+NODE_CONFIG_PATH = os.environ.get("CADENCE_NODE_CONFIG",
+                                  os.path.join(os.path.dirname(__file__), "node_config.json"))
+APP_DESC_OFFSET = 32  # esp_app_desc_t in an app image: after the image header and first segment header
+APP_DESC_MAGIC = 0xABCD5432
 
 # ============================================
 # APP INIT
 # ============================================
 
-app = FastAPI()
+@asynccontextmanager
+async def lifespan(app):
+    global recording
+
+    transport = await start_udp_ingest()
+    mdns = await start_mdns_advertisement()
+    recording = open_recording(RECORD_PATH)
+    yield
+    if recording is not None:
+        recording.close()
+    if mdns is not None:
+        await mdns.async_unregister_all_services()
+        await mdns.async_close()
+    transport.close()
+
+
+app = FastAPI(lifespan=lifespan)
+
+
+# The accelerometer syncs its clock from this (components/clock_sync): the
+# time is taken as the response leaves, the closest to mid round trip there is
+@app.middleware("http")
+async def stamp_server_time(request: Request, call_next):
+    response = await call_next(request)
+    response.headers["X-Server-Us"] = str(int(time.time() * 1e6))
+    return response
 
 # ============================================
 # ENUMS
@@ -35,93 +108,353 @@ class Emotions(Enum):
 # ============================================
 
 class AccelData(BaseModel):
-    data: List[float]
+    # One [x, y, z] per sample; older firmware sends the flat "data" list
+    frames: Optional[List[Tuple[float, float, float]]] = None
+    data: Optional[List[float]] = None
+    fs: Optional[float] = None  # sample rate of data in Hz
+    t0_us: Optional[int] = None  # device time of the first sample
+    clock_offset_us: Optional[int] = None  # the device's backend-minus-device time, 0 before it synced
+    device: Optional[str] = None  # accelerometer ID; without one the sender's address stands in
+
+# Binary batch (application/octet-stream): this header, then count int16
+# x, y, z triplets of raw counts. Mirrors acc_payload_header_t in the firmware.
+# Version 2 follows the header with zigzag varint deltas instead (acc_payload.h).
+# A header_len of 20 or more appends the sender's device_id; older firmware
+# sends 16 and is told apart by its address instead. 36 or more adds the
+# device time of the first sample and the device's clock offset to ours.
+ACC_PAYLOAD_MAGIC = 0x4341
+ACC_PAYLOAD_VERSION = 1
+ACC_PAYLOAD_VERSION_DELTA = 2
+ACC_PAYLOAD_DELTA_MAX_BYTES = 3
+ACC_PAYLOAD_HEADER = np.dtype([
+    ("magic", "<u2"),
+    ("version", "u1"),
+    ("header_len", "u1"),
+    ("fs_millihz", "<u4"),
+    ("start_index", "<u4"),
+    ("count", "<u2"),
+    ("counts_per_g", "<u2"),
+])
+ACC_PAYLOAD_DEVICE_ID = np.dtype("<u4")  # at ACC_PAYLOAD_HEADER.itemsize, when header_len covers it
+ACC_PAYLOAD_TIMING = np.dtype([("t0_us", "<i8"), ("clock_offset_us", "<i8")])  # after the device ID
+
+
+@dataclass
+class AccBatch:
+    samples: np.ndarray  # (n, 3) counts at counts_per_g
+    fs: float
+    start_index: int
+    counts_per_g: int
+    device: Optional[str] = None
+    t0_us: Optional[int] = None  # device time of samples[0]
+    clock_offset_us: int = 0  # backend minus device time, 0 until the device synced
+
+    def sample_time(self):
+        # Backend time of samples[0], None while the device's clock isn't synced
+        return sample_time(self.t0_us, self.clock_offset_us)
+
+
+def sample_time(t0_us, clock_offset_us):
+    if t0_us is None or not clock_offset_us:
+        return None
+    return (t0_us + clock_offset_us) / 1e6
+
+
+def format_device_id(device_id):
+    # Same spelling as the firmware's "device" JSON field
+    return format(device_id, "08x")
+
+
+def decode_delta_samples(payload, count):
+    # LEB128: a byte below 0x80 ends a value. Vectorised so a batch costs a
+    # handful of numpy calls rather than a Python loop over every byte.
+    data = np.frombuffer(payload, dtype=np.uint8)
+    ends = np.flatnonzero(data < 0x80)
+    if len(ends) < count * 3:
+        raise ValueError("Payload shorter than its sample count")
+    if count == 0:
+        return np.zeros((0, 3), dtype=np.int32)
+
+    ends = ends[:count * 3]
+    data = data[:ends[-1] + 1]
+    starts = np.concatenate(([0], ends[:-1] + 1))
+    lengths = ends - starts + 1
+    if lengths.max() > ACC_PAYLOAD_DELTA_MAX_BYTES:
+        raise ValueError("Delta out of range")
+
+    shifts = 7 * (np.arange(len(data)) - np.repeat(starts, lengths))
+    zigzag = np.add.reduceat((data & 0x7F).astype(np.int64) << shifts, starts)
+    deltas = (zigzag >> 1) ^ -(zigzag & 1)
+    return np.cumsum(deltas.reshape(-1, 3), axis=0, dtype=np.int32)
+
+
+def decode_binary_batch(body):
+    if len(body) < ACC_PAYLOAD_HEADER.itemsize:
+        raise ValueError("Payload shorter than its header")
+
+    header = np.frombuffer(body, dtype=ACC_PAYLOAD_HEADER, count=1)[0]
+    if header["magic"] != ACC_PAYLOAD_MAGIC:
+        raise ValueError("Unknown payload format")
+
+    offset = int(header["header_len"])
+    if offset < ACC_PAYLOAD_HEADER.itemsize or offset > len(body):
+        raise ValueError("Header length out of range")
+    if header["counts_per_g"] == 0 or header["fs_millihz"] == 0:
+        raise ValueError("Zero scale or sample rate")
+    count = int(header["count"])
+    device = None
+    t0_us = None
+    clock_offset_us = 0
+    timing_at = ACC_PAYLOAD_HEADER.itemsize + ACC_PAYLOAD_DEVICE_ID.itemsize
+    if offset >= timing_at:
+        device_id = np.frombuffer(body, dtype=ACC_PAYLOAD_DEVICE_ID, count=1, offset=ACC_PAYLOAD_HEADER.itemsize)[0]
+        device = format_device_id(int(device_id))
+    if offset >= timing_at + ACC_PAYLOAD_TIMING.itemsize:
+        timing = np.frombuffer(body, dtype=ACC_PAYLOAD_TIMING, count=1, offset=timing_at)[0]
+        t0_us = int(timing["t0_us"])
+        clock_offset_us = int(timing["clock_offset_us"])
+    if header["version"] == ACC_PAYLOAD_VERSION_DELTA:
+        samples = decode_delta_samples(body[offset:], count)
+    elif header["version"] == ACC_PAYLOAD_VERSION:
+        if len(body) < offset + count * 6:
+            raise ValueError("Payload shorter than its sample count")
+        # A view onto the request body, no per-value parsing or copies
+        samples = np.frombuffer(body, dtype="<i2", count=count * 3, offset=offset).reshape(-1, 3)
+    else:
+        raise ValueError("Unknown payload version")
+    return AccBatch(samples, header["fs_millihz"] / 1000.0, int(header["start_index"]), int(header["counts_per_g"]),
+                    device, t0_us, clock_offset_us)
+
+
+class DeviceCadence(BaseModel):
+    bpm: float
+    confidence: float
+    fs: Optional[float] = None
+    seq: Optional[int] = None  # batch the estimate ends on, for tracing
+    age_us: Optional[int] = None  # how long before the request its last sample was taken
+    device: Optional[str] = None
+
+
+class TimerStats(BaseModel):
+    n: int
+    min_us: int
+    avg_us: int
+    p50_us: int
+    p99_us: int
+    max_us: int
+
+
+# One window of a node's perf counters (components/perf_counters)
+class DeviceTelemetry(BaseModel):
+    node: str
+    uptime_ms: int
+    timers: Dict[str, TimerStats] = {}
+    counters: Dict[str, int] = {}
+    stacks: Dict[str, int] = {}  # free stack bytes at the high-water mark
+    heap: Dict[str, int] = {}  # free, min_free and largest_block, bytes
+
+
+# Points on a node's own timeline, in backend time (e.g. through its clock sync)
+class TraceMark(BaseModel):
+    trace: int  # flow of the accelerometer batch behind it, the "trace" of /led_state
+    name: str
+    server_us: int
+    dur_us: int = 0
+
+
+class DeviceTrace(BaseModel):
+    node: str
+    events: List[TraceMark]
+
+
+class BeatReference(BaseModel):
+    bpm: float
+    anchor_ms: int  # wall-clock time (ms since epoch) of a beat of the playing track
 
 # ============================================
 # GLOBAL STATE
 # ============================================
 
-running_avg = 0.0
-prev_sample = None
-last_cross_sample = None
-cross_intervals = []
+# What a set of LED subscribers follows: one wearer's cadence, or the group's
+@dataclass
+class TempoState:
+    bpm: float = 65
+    mood: Emotions = Emotions.NEUTRAL
+    settled_bpm: float = 65  # tempo at the last change of PUSH_BPM_THRESHOLD or more
+    last_tempo_change: float = 0.0
+    trace: Optional[int] = None  # trace flow of the batch behind bpm
+    beat_bpm: float = 65.0  # beat grid, free-running on bpm unless the player sets it
+    beat_anchor: float = field(default_factory=time.time)
+    subscribers: set = field(default_factory=set)  # /led_events queues
+    last_pushed_bpm: Optional[float] = None
+    last_pushed_mood: Optional[Emotions] = None
+
 
-global_sample_index = 0
+# One accelerometer: its own cadence engine, sample clock and estimates, so
+# batches from several wearers never mix
+@dataclass
+class Wearer(TempoState):
+    id: str = DEFAULT_DEVICE
+    engine: Optional[cadence_engine.CadenceEngine] = None  # for the current input rate
+    sample_index: int = 0
+    fs: float = fs
+    next_start_index: Optional[int] = None  # start_index the next binary batch should carry
+    dropped_samples: int = 0
+    server_bpm: float = 65  # estimate from the raw samples, kept even while the device's wins
+    device_bpm: Optional[float] = None
+    device_confidence: float = 0.0
+    last_device_cadence: float = 0.0
+    last_seen: float = 0.0
+    host: Optional[str] = None
+    port: Optional[int] = None
+    clock_synced: bool = False
+    network_delay: Optional[float] = None  # arrival of the last batch after its newest sample was taken, s
+    pending: dict = field(default_factory=dict)  # start_index -> AccBatch that arrived ahead of a gap (UDP)
+    reordered_batches: int = 0  # late UDP batches put back in order
 
-current_bpm = 65
-current_mood = Emotions.NEUTRAL
-last_activity_sample = 0
-STILL_THRESHOLD_SECONDS = 2
 
-last_accelerometer_seen = 0.0
+wearers = {}  # device ID -> Wearer
+unknown_wearer = Wearer()  # what LED nodes see for a device that hasn't uploaded; never published
+led_waiting = {}  # device ID -> /led_events queues opened before its first batch
+group = TempoState()  # median of the active wearers; what /tempo_mood and the LCD show
+udp_datagrams = 0
+udp_bad_datagrams = 0
+
 last_led_seen = 0.0
-last_accelerometer_host = None
-last_accelerometer_port = None
 last_led_host = None
 last_led_port = None
 DEVICE_TIMEOUT_SECONDS = 15
 
+TELEMETRY_HISTORY = 60  # report windows kept per node
+telemetry = {}  # node -> deque of {"received": time, **report}
+
+
+def wearer_state(device, host=None):
+    # Firmware that predates device IDs is told apart by its address
+    key = device or host or DEFAULT_DEVICE
+    wearer = wearers.get(key)
+    if wearer is None:
+        # An LED node still streaming a wearer's state keeps it
+        idle = [k for k, w in wearers.items() if not w.subscribers]
+        if len(wearers) >= MAX_WEARERS and idle:
+            del wearers[min(idle, key=lambda k: wearers[k].last_seen)]
+        wearer = wearers[key] = Wearer(id=key)
+        wearer.subscribers.update(led_waiting.pop(key, ()))
+    return wearer
+
+
+def active_wearers(now):
+    return [w for w in wearers.values() if now - w.last_seen <= DEVICE_TIMEOUT_SECONDS]
+
 # ============================================
-# ZERO-CROSSING ENGINE
+# TRACE
 # ============================================
+# Sensor-to-light latency as a Chrome trace (opens in ui.perfetto.dev or
+# chrome://tracing). Each traced batch carries its seq and how long ago its
+# last sample was taken; a flow follows that seq from the sample through
+# calculate_tempo (or /cadence) to the frame where the LED node applied the
+# new BPM. The sample time is the arrival time minus that age, which leaves
+# the upload's network time out; binary batches from a device whose clock is
+# synced replace the age with the delay measured on the synced clock.
+# Every wearer counts its own seqs, so each batch gets a backend-wide flow ID,
+# which is what the LED node echoes back as "trace".
+
+trace_events = deque(maxlen=TRACE_HISTORY)
+trace_pids = {"backend": 1, "leds": 2}
+trace_origins = {}  # flow -> sample time
+next_trace_flow = 1
+last_trace_latency_ms = None
+
+
+def trace_event(node, name, start, **fields):
+    pid = trace_pids.setdefault(node, len(trace_pids) + 1)
+    event = {"name": name, "pid": pid, "tid": 0, "ts": int(start * 1e6)}
+    event.update(fields)
+    trace_events.append(event)
+
 
-def calculate_tempo(data, sampling_rate):
-    global running_avg
-    global prev_sample
-    global last_cross_sample
-    global cross_intervals
-    global global_sample_index
-    global last_activity_sample
+# Starts the flow of a wearer's batch and returns its ID
+def trace_sample(wearer, trace, kind, received):
+    global next_trace_flow
+
+    seq, age_us = trace
+    flow = next_trace_flow
+    next_trace_flow += 1
+    sampled = received - age_us / 1e6
+    node = "accelerometer " + wearer.id
+    trace_event(node, kind, sampled, ph="X", dur=age_us, args={"seq": seq, "flow": flow})
+    trace_event(node, "sample", sampled, ph="s", id=flow, cat="latency")
+    trace_origins[flow] = sampled
+    while len(trace_origins) > TRACE_ORIGINS:
+        del trace_origins[next(iter(trace_origins))]
+    return flow
+
+
+def request_trace(request: Request):
+    # (seq, age_us) from the X-Trace-Seq / X-Sample-Age-Us headers, or None
+    try:
+        return int(request.headers["x-trace-seq"]), int(request.headers["x-sample-age-us"])
+    except (KeyError, ValueError):
+        return None
+
+# ============================================
+# BEAT CLOCK
+# ============================================
+# A beat grid (tempo + the time of one beat) shared with the LED node so its
+# pulse lands on the music's beats. The player posts the grid of the track it
+# is playing, which every TempoState takes; without a player each grid
+# free-runs on its own cadence, so a wearer's lights follow that wearer.
 
-    data = np.array(data)
+PLAYER_BEAT_TIMEOUT_SECONDS = 30
 
-    if len(data) == 0:
-        return 65, []
+beat_source = "cadence"
+last_player_beat = 0.0
 
-    alpha = 0.1
-    DEAD_ZONE = 1.2
-    crossings = []
 
-    for sample in data:
-        running_avg = alpha * sample + (1 - alpha) * running_avg
-        centered = sample - running_avg
-        if prev_sample is not None:
-            if prev_sample < -DEAD_ZONE and centered >= DEAD_ZONE:
-                if last_cross_sample is not None:
-                    interval = (global_sample_index - last_cross_sample) / sampling_rate
-                    if interval >= 0.4:
-                        cross_intervals.append(interval)
-                        if len(cross_intervals) > MAX_INTERVALS:
-                            cross_intervals.pop(0)
+def last_beat_time(state, now):
+    period = 60.0 / state.beat_bpm
+    return state.beat_anchor + np.floor((now - state.beat_anchor) / period) * period
 
-                last_cross_sample = global_sample_index
-                last_activity_sample = global_sample_index
-                crossings.append(global_sample_index)
 
-        prev_sample = centered
-        global_sample_index += 1
+def retime_beat_grid(state, bpm, now):
+    # Re-anchor on the latest beat of the old grid so the phase stays continuous
+    if bpm <= 0:
+        return
+    state.beat_anchor = last_beat_time(state, now)
+    state.beat_bpm = float(bpm)
 
-    # 3️⃣ If no intervals → still
-    if len(cross_intervals) == 0:
-        return 65, crossings
-    
-    time_since_last_cross = (global_sample_index - last_activity_sample) / sampling_rate
+# ============================================
+# CADENCE ENGINE
+# ============================================
 
-    if time_since_last_cross > STILL_THRESHOLD_SECONDS:
-        cross_intervals.clear()
-        return 65, crossings
+# samples: (n, 3) raw counts at cadence_engine.SENSOR_COUNTS_PER_G. The
+# engine is the accelerometer's own (components/cadence), so a batch gives the
+# BPM the device would. Returns the BPM and the steps the batch completed.
+def calculate_tempo(wearer, samples, sampling_rate):
+    input_hz = max(1, int(round(sampling_rate)))
+    if wearer.engine is None or wearer.engine.input_hz != input_hz:
+        # The filter's alpha and decimation are fixed per rate; a new rate starts over
+        wearer.engine = cadence_engine.CadenceEngine(input_hz, CADENCE_RATE_HZ, BASELINE_TAU_SECONDS, DEAD_ZONE,
+                                                     MIN_STEP_INTERVAL, STILL_THRESHOLD_SECONDS, MAX_INTERVALS)
+    wearer.engine.set_rate(sampling_rate)
+    steps = wearer.engine.push(samples)
+    wearer.sample_index += len(samples)
+    return wearer.engine.bpm(), steps
 
-    avg_interval = np.mean(cross_intervals)
 
-    if avg_interval <= 0:
-        return 65, crossings
+# Counts from another scale (the delta format's 14-bit 4096/g, or m/s^2 with
+# counts_per_g = GRAVITY_CONSTANT) to what the engine reads
+def to_sensor_counts(samples, counts_per_g):
+    scaled = np.rint(np.asarray(samples, dtype=float) * (cadence_engine.SENSOR_COUNTS_PER_G / counts_per_g))
+    return np.clip(scaled, -32768, 32767).astype(np.int16)
 
-    freq = 1 / avg_interval
-    bpm = freq * 60
 
-    bpm = max(40, min(bpm, 180))
+# Back to the state at startup, so a replay starts from clean engines
+def reset_tempo_engine():
+    global group
 
-    return bpm, crossings
+    wearers.clear()
+    group = TempoState()
 
 # ============================================
 # MOOD CLASSIFIER
@@ -147,65 +480,613 @@ def classify_mood(bpm):
 async def root():
     return {"message": "Cadence engine running"}
 
-@app.post("/acc_data")
-async def receive_accelerations(payload: AccelData, request: Request):
-    global current_bpm, current_mood, last_accelerometer_seen
-    global last_accelerometer_host, last_accelerometer_port
+def align_stream(wearer, start_index, count):
+    # start_index doubles as the stream's sequence number. Batches the device
+    # dropped are real time that passed: move the sample clock over the gap so
+    # crossing intervals stay in seconds. Returns False for a late or
+    # duplicate datagram, which is older than what was already processed.
+    if wearer.next_start_index is not None:
+        if start_index > wearer.next_start_index:
+            gap = start_index - wearer.next_start_index
+            wearer.dropped_samples += gap
+            wearer.sample_index += gap
+            if wearer.engine is not None:
+                wearer.engine.skip(gap)
+            print("Missed samples from", wearer.id + ":", gap)
+        elif wearer.next_start_index - start_index > STREAM_RESTART_SAMPLES:
+            print("Accelerometer", wearer.id, "restarted its sample count")
+            wearer.pending.clear()  # from before the restart
+        elif start_index < wearer.next_start_index:
+            return False
+    wearer.next_start_index = start_index + count
+    return True
+
+
+def set_state_bpm(state, bpm, now, trace=None):
+    if abs(bpm - state.settled_bpm) >= PUSH_BPM_THRESHOLD:
+        state.settled_bpm = bpm
+        state.last_tempo_change = now
+    state.bpm = bpm
+    state.mood = classify_mood(bpm)
+    if trace is not None:
+        state.trace = trace
+    if now - last_player_beat > PLAYER_BEAT_TIMEOUT_SECONDS:
+        retime_beat_grid(state, bpm, now)
+    publish_led_state(state)
+
+
+# trace: the flow of the batch behind bpm, or None
+def set_current_bpm(wearer, bpm, now, trace=None):
+    set_state_bpm(wearer, bpm, now, trace)
+
+    # The group follows the median, so one wearer stopping to tie a shoe
+    # doesn't drag the room's tempo down
+    active = active_wearers(now)
+    if active:
+        set_state_bpm(group, float(np.median([w.bpm for w in active])), now, trace)
+
+
+def mark_accelerometer_seen(wearer, host, port):
+    wearer.last_seen = time.time()
+    wearer.host = host
+    wearer.port = port
+
+
+def update_tempo(wearer, samples, rate, host, port, trace=None):
+    started = time.time()
+    flow = trace_sample(wearer, trace, "batch", started) if trace is not None else None
+    wearer.fs = rate if rate and rate > 0 else fs
+    wearer.server_bpm, _ = calculate_tempo(wearer, samples, wearer.fs)
+    elapsed_us = int((time.time() - started) * 1e6)
+    trace_event("backend", "calculate_tempo", started, ph="X", dur=elapsed_us,
+                args={"device": wearer.id, "samples": len(samples), "bpm": round(wearer.server_bpm, 1),
+                      "flow": flow})
+    if flow is not None:
+        trace_event("backend", "tempo", started, ph="t", id=flow, cat="latency")
+
+    print("Calculated BPM for", wearer.id + ":", wearer.server_bpm)
+
+    mark_accelerometer_seen(wearer, host, port)
+    # The device's own estimate sees every sample, a lost batch doesn't hurt it
+    if wearer.last_seen - wearer.last_device_cadence > DEVICE_TIMEOUT_SECONDS:
+        set_current_bpm(wearer, wearer.server_bpm, wearer.last_seen, flow)
+
+
+# ============================================
+# RECORDING
+# ============================================
+# With CADENCE_RECORD set, every binary batch that decodes is appended to
+# that file exactly as it arrived (HTTP or UDP), behind an arrival time and
+# a length. replay.py feeds such a file back through calculate_tempo or a
+# running backend. JSON batches aren't recorded; the firmware sends binary
+# unless UPLOAD_BINARY is off.
+
+recording = None
+
+
+def open_recording(path):
+    if not path:
+        return None
+    f = open(path, "ab")
+    if f.tell() == 0:
+        f.write(RECORD_MAGIC)
+    print("Recording accelerometer batches to", path)
+    return f
+
+
+def record_batch(body):
+    if recording is not None:
+        recording.write(RECORD_ENTRY.pack(time.time(), len(body)) + bytes(body))
+        recording.flush()
+
+
+def read_recording(path):
+    # Yields (arrival time, batch body) in recorded order
+    with open(path, "rb") as f:
+        if f.read(len(RECORD_MAGIC)) != RECORD_MAGIC:
+            raise ValueError(path + " is not a cadence recording")
+        while True:
+            entry = f.read(RECORD_ENTRY.size)
+            if len(entry) < RECORD_ENTRY.size:
+                return
+            received, length = RECORD_ENTRY.unpack(entry)
+            body = f.read(length)
+            if len(body) < length:
+                return  # cut off mid-write
+            yield received, body
+
+
+# With the device's clock synced, a batch tells when its samples were
+# taken, so the time it spent in flight is known apart from the wearer
+# stopping (which shows as a start_index gap with no delay)
+def note_sample_time(wearer, sampled, count, rate, received):
+    wearer.clock_synced = sampled is not None
+    if sampled is not None and rate:
+        wearer.network_delay = received - (sampled + (count - 1) / rate)
+
+
+# UDP batches in start_index order. One that arrives ahead of a gap waits in
+# wearer.pending until the gap fills, or until its first sample is
+# REORDER_WAIT_SECONDS old on the synced clock, when the gap counts as lost.
+# HTTP batches arrive in order, and without a synced clock there is no way
+# to tell how long to wait, so those go straight through align_stream.
+def ordered_batches(wearer, batch, received, reorder):
+    if (reorder and batch.sample_time() is not None and wearer.next_start_index is not None
+            and wearer.next_start_index < batch.start_index <= wearer.next_start_index + STREAM_RESTART_SAMPLES):
+        wearer.pending[batch.start_index] = batch
+    elif align_stream(wearer, batch.start_index, len(batch.samples)):
+        if wearer.pending:
+            wearer.reordered_batches += 1
+        yield batch
 
-    raw = payload.data
-    print("Received batch length:", len(raw))
-    print("First 9 values (3 samples):", raw[:9])
+    while wearer.pending:
+        start = min(wearer.pending)
+        head = wearer.pending[start]
+        if (start != wearer.next_start_index and received - head.sample_time() < REORDER_WAIT_SECONDS
+                and len(wearer.pending) < REORDER_MAX_BATCHES):
+            return
+        del wearer.pending[start]
+        if align_stream(wearer, start, len(head.samples)):
+            yield head
 
-    if len(raw) % 3 != 0:
-        return {"error": "Data length must be divisible by 3"}
 
-    matrix = np.array(raw).reshape(-1, 3)
+def ingest_binary_batch(body, host, port, trace=None, reorder=False):
+    batch = decode_binary_batch(body)
+    record_batch(body)
+    wearer = wearer_state(batch.device, host)
+    received = time.time()
+    note_sample_time(wearer, batch.sample_time(), len(batch.samples), batch.fs, received)
+    if trace is not None and wearer.clock_synced:
+        trace = (trace[0], max(0, int(wearer.network_delay * 1e6)))
+    processed = 0
+    for ready in ordered_batches(wearer, batch, received, reorder):
+        update_tempo(wearer, to_sensor_counts(ready.samples, ready.counts_per_g), ready.fs, host, port,
+                     trace if ready is batch else None)
+        processed += len(ready.samples)
+    return processed
 
-    magnitude = np.linalg.norm(matrix, axis=1)
 
-    bpm, _ = calculate_tempo(magnitude, fs)
+@app.post("/acc_data")
+async def receive_accelerations(request: Request):
+    host = request.client.host if request.client else None
+    port = request.client.port if request.client else None
+
+    content_type = request.headers.get("content-type", "")
+    if content_type.startswith("application/octet-stream"):
+        try:
+            received = ingest_binary_batch(await request.body(), host, port, request_trace(request))
+        except ValueError as exc:
+            raise HTTPException(status_code=400, detail=str(exc))
+        return {"received": received}
+
+    try:
+        payload = AccelData.model_validate(await request.json())
+    except ValidationError as exc:
+        raise RequestValidationError(exc.errors())
+    except ValueError:
+        return {"error": "Body is neither JSON nor a binary batch"}
 
-    print("Calculated BPM:", bpm)
+    if payload.frames is not None:
+        # Frame-aligned by the schema, no length check or reshape needed
+        matrix = np.array(payload.frames, dtype=float).reshape(-1, 3)
+    elif payload.data is not None:
+        raw = payload.data
+        if len(raw) % 3 != 0:
+            return {"error": "Data length must be divisible by 3"}
+        matrix = np.array(raw).reshape(-1, 3)
+    else:
+        return {"error": "Batch has neither frames nor data"}
+    print("Received batch length:", len(matrix))
 
-    current_bpm = bpm
-    current_mood = classify_mood(bpm)
-    last_accelerometer_seen = time.time()
-    last_accelerometer_host = request.client.host if request.client else None
-    last_accelerometer_port = request.client.port if request.client else None
+    # JSON carries m/s^2
+    wearer = wearer_state(payload.device, host)
+    note_sample_time(wearer, sample_time(payload.t0_us, payload.clock_offset_us), len(matrix), payload.fs, time.time())
+    update_tempo(wearer, to_sensor_counts(matrix, GRAVITY_CONSTANT), payload.fs, host, port, request_trace(request))
 
     return {"received": len(matrix)}
 
+
+# Streaming transport: each datagram is one binary batch (same format as the
+# octet-stream body), typically a single FIFO burst. No connection or HTTP
+# headers per batch, so a burst reaches calculate_tempo within milliseconds.
+class AccelDatagramProtocol(asyncio.DatagramProtocol):
+    def datagram_received(self, data, addr):
+        global udp_datagrams, udp_bad_datagrams
+
+        udp_datagrams += 1
+        try:
+            ingest_binary_batch(data, addr[0], addr[1], reorder=True)
+        except ValueError as exc:
+            udp_bad_datagrams += 1
+            print("Bad datagram from", addr, exc)
+
+
+async def start_udp_ingest():
+    loop = asyncio.get_running_loop()
+    transport, _ = await loop.create_datagram_endpoint(
+        AccelDatagramProtocol, local_addr=("0.0.0.0", ACC_UDP_PORT)
+    )
+    print("Listening for accelerometer datagrams on UDP", ACC_UDP_PORT)
+    return transport
+
+
+def lan_address():
+    # The address the LAN route goes out of; nothing is actually sent
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        try:
+            s.connect(("10.255.255.255", 1))
+            return s.getsockname()[0]
+        except OSError:
+            return "127.0.0.1"
+
+
+# The devices look the backend up as _cadence._tcp instead of using a fixed IP.
+# Needs the zeroconf package; without it, advertise by hand, e.g.
+#   dns-sd -R cadence _cadence._tcp local 8000
+async def start_mdns_advertisement():
+    try:
+        from zeroconf import ServiceInfo
+        from zeroconf.asyncio import AsyncZeroconf
+    except ImportError:
+        print("zeroconf not installed, not advertising", MDNS_SERVICE_TYPE)
+        return None
+
+    address = lan_address()
+    info = ServiceInfo(
+        MDNS_SERVICE_TYPE,
+        "cadence." + MDNS_SERVICE_TYPE,
+        addresses=[socket.inet_aton(address)],
+        port=HTTP_PORT,
+        properties={"udp": str(ACC_UDP_PORT)},
+    )
+    mdns = AsyncZeroconf()
+    await mdns.async_register_service(info)
+    print("Advertising", MDNS_SERVICE_TYPE, "at", address, HTTP_PORT)
+    return mdns
+
+
+# BPM estimated on the accelerometer itself (same engine, run per sample)
+@app.post("/cadence")
+async def receive_cadence(cadence: DeviceCadence, request: Request):
+    host = request.client.host if request.client else None
+    wearer = wearer_state(cadence.device, host)
+    wearer.device_bpm = cadence.bpm
+    wearer.device_confidence = cadence.confidence
+    mark_accelerometer_seen(wearer, host, request.client.port if request.client else None)
+    wearer.last_device_cadence = wearer.last_seen
+    flow = None
+    if cadence.seq is not None and cadence.age_us is not None:
+        flow = trace_sample(wearer, (cadence.seq, cadence.age_us), "cadence", wearer.last_seen)
+        trace_event("backend", "cadence", wearer.last_seen, ph="X", dur=1,
+                    args={"device": wearer.id, "bpm": round(cadence.bpm, 1), "flow": flow})
+        trace_event("backend", "tempo", wearer.last_seen, ph="t", id=flow, cat="latency")
+    set_current_bpm(wearer, cadence.bpm, wearer.last_seen, flow)
+    return {"bpm": cadence.bpm}
+
+
+def wearer_summary(wearer, now):
+    return {
+        "tempo": round(wearer.bpm, 2),
+        "mood": wearer.mood.name,
+        "connected": (now - wearer.last_seen) <= DEVICE_TIMEOUT_SECONDS,
+        "last_seen": wearer.last_seen,
+        "host": wearer.host,
+        "port": wearer.port,
+        "fs": wearer.fs,
+        "cross_intervals_count": wearer.engine.interval_count() if wearer.engine is not None else 0,
+        "sample_index": wearer.sample_index,
+        "dropped_samples": wearer.dropped_samples,
+        "clock_synced": wearer.clock_synced,
+        "network_delay_ms": round(wearer.network_delay * 1000, 1) if wearer.network_delay is not None else None,
+        "reordered_batches": wearer.reordered_batches,
+        "server_bpm": round(wearer.server_bpm, 2),
+        "device_bpm": round(wearer.device_bpm, 2) if wearer.device_bpm is not None else None,
+        "device_confidence": round(wearer.device_confidence, 2),
+        "running_avg": round(wearer.engine.baseline_ms2(), 4) if wearer.engine is not None else 0.0,
+        "led_subscribers": len(wearer.subscribers),
+        "trace": wearer.trace,
+    }
+
+
+# tempo and mood are the group's; "wearers" has every accelerometer seen
 @app.get("/tempo_mood")
 async def get_tempo_mood():
     now = time.time()
+    latest = max(wearers.values(), key=lambda w: w.last_seen, default=None)
 
     return {
-        "tempo": round(current_bpm, 2),
-        "mood": current_mood.name,
+        "tempo": round(group.bpm, 2),
+        "mood": group.mood.name,
         "devices": {
-            "accelerometer_connected": (now - last_accelerometer_seen) <= DEVICE_TIMEOUT_SECONDS,
+            "accelerometer_connected": bool(active_wearers(now)),
+            "accelerometers_connected": len(active_wearers(now)),
             "led_strip_connected": (now - last_led_seen) <= DEVICE_TIMEOUT_SECONDS,
-            "last_accelerometer_seen": last_accelerometer_seen,
+            "last_accelerometer_seen": latest.last_seen if latest else 0.0,
             "last_led_seen": last_led_seen,
-            "accelerometer_host": last_accelerometer_host,
-            "accelerometer_port": last_accelerometer_port,
+            "accelerometer_host": latest.host if latest else None,
+            "accelerometer_port": latest.port if latest else None,
             "led_strip_host": last_led_host,
             "led_strip_port": last_led_port,
         },
+        "wearers": {w.id: wearer_summary(w, now) for w in wearers.values()},
         "debug": {
-            "fs": fs,
-            "cross_intervals_count": len(cross_intervals),
-            "global_sample_index": global_sample_index,
-            "running_avg": round(running_avg, 4),
+            "udp_datagrams": udp_datagrams,
+            "udp_bad_datagrams": udp_bad_datagrams,
+            "led_subscribers": len(group.subscribers),
+            "led_pushes": led_pushes,
+            "beat_bpm": round(group.beat_bpm, 3),
+            "beat_source": beat_source if time.time() - last_player_beat <= PLAYER_BEAT_TIMEOUT_SECONDS else "cadence",
+            "trace": group.trace,
+            "trace_latency_ms": last_trace_latency_ms,
         },
     }
 
 
-@app.get("/tempo")
-async def get_tempo(request: Request):
+# ============================================
+# LED STATE PUSH
+# ============================================
+# Each /led_events subscriber gets a one-slot queue holding the newest state,
+# so a slow client skips stale updates instead of queueing them. Subscribers
+# follow one TempoState: the group, or with ?device=<id> a single wearer.
+# Everything runs on the event loop (handlers and the UDP protocol), so no
+# locking.
+
+led_pushes = 0
+
+
+# The state a request asks for: ?device=<id> for one wearer (waiting for it
+# if it hasn't reported yet), otherwise the group
+# Only uploads create wearers, so a made-up device ID can't push a real one out
+def led_state_for(device):
+    return wearers.get(device, unknown_wearer) if device else group
+
+
+# Tells a polling LED node to come back soon while the tempo is in flux, or
+# None to let it back off on its own
+def led_refresh_hint(state, now):
+    moving = now - state.last_tempo_change < SETTLE_SECONDS
+    sources = [state] if isinstance(state, Wearer) else active_wearers(now)
+    uncertain = any(now - w.last_device_cadence <= DEVICE_TIMEOUT_SECONDS
+                    and w.device_confidence < LOW_CONFIDENCE for w in sources)
+    return FAST_REFRESH_MS if moving or uncertain else None
+
+
+def led_state_snapshot(state):
+    now = time.time()
+    snapshot = {
+        "tempo": int(round(state.bpm)),
+        "mood": state.mood.value,
+        "beat_bpm": round(state.beat_bpm, 3),
+        "beat_ms": int(last_beat_time(state, now) * 1000),
+        "server_ms": int(now * 1000),
+    }
+    if now - last_player_beat <= PLAYER_BEAT_TIMEOUT_SECONDS:
+        snapshot["beat_source"] = "player"  # LED nodes keep it over the wearer's own steps
+    hint = led_refresh_hint(state, now)
+    if hint is not None:
+        snapshot["refresh_ms"] = hint
+    if state.trace is not None:
+        snapshot["trace"] = state.trace
+    return snapshot
+
+
+def publish_led_state(state, force=False):
+    global led_pushes
+
+    if not state.subscribers:
+        return
+    if (not force and state.last_pushed_bpm is not None and state.mood == state.last_pushed_mood
+            and abs(state.bpm - state.last_pushed_bpm) < PUSH_BPM_THRESHOLD):
+        return
+
+    state.last_pushed_bpm = state.bpm
+    state.last_pushed_mood = state.mood
+    led_pushes += 1
+    snapshot = led_state_snapshot(state)
+    trace_event("backend", "push", time.time(), ph="i", s="p",
+                args={"tempo": snapshot["tempo"], "device": getattr(state, "id", None), "flow": state.trace})
+    for queue in state.subscribers:
+        if queue.full():
+            queue.get_nowait()
+        queue.put_nowait(snapshot)
+
+
+def mark_led_seen(request: Request):
     global last_led_seen, last_led_host, last_led_port
 
     last_led_seen = time.time()
     last_led_host = request.client.host if request.client else None
     last_led_port = request.client.port if request.client else None
-    return int(round(current_bpm))
+
+
+@app.get("/tempo")
+async def get_tempo(request: Request, device: Optional[str] = None):
+    mark_led_seen(request)
+    return int(round(led_state_for(device).bpm))
+
+
+# Compact state for the LED node: mood as the Emotions value so the
+# firmware can index its effect table without string compares.
+# server_ms is stamped as late as possible; the node pairs it with its own
+# send/receive times to estimate the clock offset.
+@app.get("/led_state")
+async def get_led_state(request: Request, device: Optional[str] = None):
+    mark_led_seen(request)
+    return led_state_snapshot(led_state_for(device))
+
+
+# Server-sent events with the same fields as /led_state, sent when the tempo
+# or mood changes and at least every PUSH_REFRESH_SECONDS
+@app.get("/led_events")
+async def led_events(request: Request, device: Optional[str] = None):
+    mark_led_seen(request)
+    queue = asyncio.Queue(maxsize=1)
+    state = led_state_for(device)
+    if state is unknown_wearer:
+        # Handed to the wearer by wearer_state() when it first uploads
+        led_waiting.setdefault(device, set()).add(queue)
+    else:
+        state.subscribers.add(queue)
+
+    async def stream():
+        try:
+            snapshot = led_state_snapshot(led_state_for(device))
+            while True:
+                yield "data: " + json.dumps(snapshot) + "\n\n"
+                try:
+                    snapshot = await asyncio.wait_for(queue.get(), PUSH_REFRESH_SECONDS)
+                except asyncio.TimeoutError:
+                    snapshot = led_state_snapshot(led_state_for(device))
+                mark_led_seen(request)
+        finally:
+            led_state_for(device).subscribers.discard(queue)
+            waiting = led_waiting.get(device)
+            if waiting is not None:
+                waiting.discard(queue)
+                if not waiting:
+                    del led_waiting[device]
+
+    return StreamingResponse(stream(), media_type="text/event-stream",
+                             headers={"Cache-Control": "no-cache"})
+
+
+# For the LCD node: just what it prints, mood as the Emotions value
+@app.get("/display_state")
+async def get_display_state():
+    return {"tempo": int(round(group.bpm)), "mood": group.mood.value}
+
+
+@app.post("/telemetry")
+async def receive_telemetry(report: DeviceTelemetry):
+    history = telemetry.setdefault(report.node, deque(maxlen=TELEMETRY_HISTORY))
+    entry = report.model_dump()
+    entry["received"] = time.time()
+    history.append(entry)
+    return {"ok": True}
+
+
+# Every node's recent windows, oldest first, for the dashboard
+@app.get("/telemetry")
+async def get_telemetry():
+    return {node: list(history) for node, history in telemetry.items()}
+
+
+# Marks from the nodes: the LED node reports the frame that first showed a
+# new BPM, which closes that batch's flow
+@app.post("/trace")
+async def receive_trace(report: DeviceTrace):
+    global last_trace_latency_ms
+
+    for mark in report.events:
+        start = mark.server_us / 1e6
+        trace_event(report.node, mark.name, start, ph="X", dur=max(mark.dur_us, 1),
+                    args={"flow": mark.trace})
+        sampled = trace_origins.get(mark.trace)
+        if sampled is not None:
+            trace_event(report.node, mark.name, start, ph="f", bp="e", id=mark.trace, cat="latency")
+            last_trace_latency_ms = round((start - sampled) * 1000, 1)
+    return {"received": len(report.events)}
+
+
+# Chrome trace JSON of the recent pipeline, newest TRACE_HISTORY events
+@app.get("/trace")
+async def get_trace():
+    names = [{"name": "process_name", "ph": "M", "pid": pid, "tid": 0, "args": {"name": node}}
+             for node, pid in trace_pids.items()]
+    return {"traceEvents": names + list(trace_events), "displayTimeUnit": "ms"}
+
+
+@app.post("/beat")
+async def set_beat_reference(ref: BeatReference):
+    global beat_source, last_player_beat
+
+    if ref.bpm <= 0:
+        return {"error": "bpm must be positive"}
+
+    # The music is the same for everyone in the room
+    beat_source = "player"
+    last_player_beat = time.time()
+    for state in [group, *wearers.values()]:
+        state.beat_bpm = ref.bpm
+        state.beat_anchor = ref.anchor_ms / 1000.0
+        publish_led_state(state, force=True)
+    return {"beat_bpm": ref.bpm, "beat_ms": ref.anchor_ms}
+
+
+# ============================================
+# OTA FIRMWARE AND NODE CONFIG
+# ============================================
+# Each node's ota_update task asks for these every CONFIG_OTA_UPDATE_CHECK_MS.
+# Dropping a build's build/<project>.bin into FIRMWARE_DIR as <node>.bin
+# (accelerometer, leds, lcd) updates that node on its next check, unless it
+# already runs that version (the project's git describe, or PROJECT_VER).
+# Tunables live in NODE_CONFIG_PATH as {"<node>": {"key": value, ...}}; a
+# node restarts when one differs from what it runs.
+
+def firmware_path(node):
+    if not node.isidentifier():
+        raise HTTPException(status_code=404, detail="unknown node")
+    return os.path.join(FIRMWARE_DIR, node + ".bin")
+
+
+def firmware_version(path):
+    # (version, project name) from the image's esp_app_desc_t, None if it isn't an app image
+    with open(path, "rb") as f:
+        f.seek(APP_DESC_OFFSET)
+        desc = f.read(80)
+    if len(desc) < 80 or struct.unpack_from("<I", desc)[0] != APP_DESC_MAGIC:
+        return None
+    version, project = struct.unpack_from("<32s32s", desc, 16)
+    return version.split(b"\0")[0].decode(errors="replace"), project.split(b"\0")[0].decode(errors="replace")
+
+
+def load_node_configs():
+    try:
+        with open(NODE_CONFIG_PATH) as f:
+            return json.load(f)
+    except FileNotFoundError:
+        return {}
+
+
+@app.get("/firmware/{node}")
+async def get_firmware(node: str):
+    path = firmware_path(node)
+    if not os.path.isfile(path):
+        raise HTTPException(status_code=404, detail="no firmware for " + node)
+    desc = firmware_version(path)
+    if desc is None:
+        raise HTTPException(status_code=404, detail=path + " is not an app image")
+    version, project = desc
+    return {"version": version, "project": project, "size": os.path.getsize(path)}
+
+
+@app.get("/firmware/{node}/image")
+async def get_firmware_image(node: str):
+    path = firmware_path(node)
+    if not os.path.isfile(path):
+        raise HTTPException(status_code=404, detail="no firmware for " + node)
+    return FileResponse(path, media_type="application/octet-stream")
+
+
+# Always an object, so a node without an entry just keeps its defaults
+@app.get("/node_config/{node}")
+async def get_node_config(node: str):
+    return load_node_configs().get(node, {})
+
+
+# Replaces the node's tunables; the node validates the values itself and
+# logs the ones it rejects
+@app.put("/node_config/{node}")
+async def put_node_config(node: str, request: Request):
+    try:
+        values = await request.json()
+    except ValueError:
+        return {"error": "body must be JSON"}
+    if not isinstance(values, dict):
+        return {"error": "config must be an object"}
+    configs = load_node_configs()
+    configs[node] = values
+    with open(NODE_CONFIG_PATH + ".tmp", "w") as f:
+        json.dump(configs, f, indent=2)
+    os.replace(NODE_CONFIG_PATH + ".tmp", NODE_CONFIG_PATH)
+    return configs[node]
@@ -0,0 +1,101 @@
+"""ctypes binding of components/cadence, the engine the accelerometer runs.
+
+The backend feeds it the same raw counts the device does, so a batch gives
+the same BPM here as on the device. The shared library is compiled from the
+component's sources on first import (with $CC, default cc) and rebuilt
+whenever they change; set CADENCE_LIB to use a prebuilt one instead.
+"""
+
+from __future__ import annotations
+
+import ctypes
+import os
+import subprocess
+import sys
+from pathlib import Path
+
+import numpy as np
+
+SOURCE_DIR = Path(__file__).resolve().parent.parent / "components" / "cadence"
+BUILD_DIR = Path(__file__).resolve().parent / "build"
+LIB_NAME = "libcadence.dylib" if sys.platform == "darwin" else "libcadence.so"
+
+SENSOR_COUNTS_PER_G = 16384  # what the engine expects: 14-bit counts left-justified, as read
+
+
+class CadenceConfig(ctypes.Structure):
+    # Mirrors cadence_config_t
+    _fields_ = [
+        ("dead_zone_ms2", ctypes.c_float),
+        ("min_interval_s", ctypes.c_float),
+        ("still_s", ctypes.c_float),
+        ("max_intervals", ctypes.c_int),
+    ]
+
+
+def build_library():
+    sources = sorted(SOURCE_DIR.glob("*.c"))
+    headers = sorted((SOURCE_DIR / "include").glob("*.h"))
+    lib = BUILD_DIR / LIB_NAME
+    newest = max(p.stat().st_mtime for p in sources + headers)
+    if lib.exists() and lib.stat().st_mtime >= newest:
+        return lib
+
+    BUILD_DIR.mkdir(exist_ok=True)
+    command = [os.environ.get("CC", "cc"), "-O2", "-shared", "-fPIC", "-I", str(SOURCE_DIR / "include"),
+               *map(str, sources), "-o", str(lib), "-lm"]
+    subprocess.run(command, check=True)
+    return lib
+
+
+def load_library():
+    lib = ctypes.CDLL(os.environ.get("CADENCE_LIB") or str(build_library()))
+    engine = ctypes.c_void_p
+    lib.cadence_engine_size.restype = ctypes.c_size_t
+    lib.cadence_engine_init.argtypes = [engine, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_float,
+                                        ctypes.POINTER(CadenceConfig)]
+    lib.cadence_engine_set_rate.argtypes = [engine, ctypes.c_float]
+    lib.cadence_engine_push.argtypes = [engine, ctypes.POINTER(ctypes.c_int16), ctypes.c_size_t]
+    lib.cadence_engine_push.restype = ctypes.c_uint32
+    lib.cadence_engine_skip.argtypes = [engine, ctypes.c_uint32]
+    for name in ("cadence_engine_bpm", "cadence_engine_confidence", "cadence_engine_baseline_ms2"):
+        getattr(lib, name).argtypes = [engine]
+        getattr(lib, name).restype = ctypes.c_float
+    lib.cadence_engine_interval_count.argtypes = [engine]
+    lib.cadence_engine_interval_count.restype = ctypes.c_int
+    return lib
+
+
+_lib = load_library()
+
+
+class CadenceEngine:
+    def __init__(self, input_hz, cadence_hz, tau_s, dead_zone_ms2, min_interval_s, still_s, max_intervals):
+        self.input_hz = input_hz
+        self._state = ctypes.create_string_buffer(_lib.cadence_engine_size())
+        config = CadenceConfig(dead_zone_ms2, min_interval_s, still_s, max_intervals)
+        _lib.cadence_engine_init(self._state, input_hz, cadence_hz, tau_s, ctypes.byref(config))
+
+    def set_rate(self, input_hz):
+        _lib.cadence_engine_set_rate(self._state, input_hz)
+
+    def push(self, samples):
+        # samples: (n, 3) raw counts at SENSOR_COUNTS_PER_G; returns the steps they completed
+        xyz = np.ascontiguousarray(samples, dtype=np.int16)
+        return _lib.cadence_engine_push(self._state, xyz.ctypes.data_as(ctypes.POINTER(ctypes.c_int16)),
+                                        len(xyz))
+
+    def skip(self, count):
+        _lib.cadence_engine_skip(self._state, count)
+
+    def bpm(self):
+        return _lib.cadence_engine_bpm(self._state)
+
+    def confidence(self):
+        return _lib.cadence_engine_confidence(self._state)
+
+    def baseline_ms2(self):
+        return _lib.cadence_engine_baseline_ms2(self._state)
+
+    def interval_count(self):
+        return _lib.cadence_engine_interval_count(self._state)
@@ -557,6 +557,52 @@ for i, (m_name, m_data) in enumerate(MUSIC_MAP.items()):
         """, unsafe_allow_html=True)
 
 
+# ============================================================
+# DEVICE TELEMETRY
+# ============================================================
+# Perf counters the nodes post to /telemetry every ~10 s: where the frame
+# and latency budgets go in the field.
+
+try:
+    telemetry = requests.get(f"{BACKEND_URL}/telemetry", timeout=1).json()
+except Exception:
+    telemetry = {}
+
+if telemetry:
+    import pandas as pd
+
+    st.markdown("---")
+    st.markdown('<div class="metric-label" style="padding-left: 4px;">Device Telemetry</div>', unsafe_allow_html=True)
+
+    node_cols = st.columns(len(telemetry))
+    for col, (node, windows) in zip(node_cols, sorted(telemetry.items())):
+        latest = windows[-1]
+        with col:
+            age = time.time() - latest["received"]
+            st.markdown(f"""
+            <div class="metric-card">
+                <div class="metric-label">{node}</div>
+                <div class="metric-unit">up {latest['uptime_ms'] // 1000} s &nbsp;|&nbsp; report {age:.0f} s ago</div>
+            </div>
+            """, unsafe_allow_html=True)
+
+            if latest["timers"]:
+                table = pd.DataFrame(latest["timers"]).T[["n", "min_us", "avg_us", "p50_us", "p99_us", "max_us"]]
+                st.dataframe(table, use_container_width=True)
+
+                # p99 of each timer per report window
+                p99 = pd.DataFrame(
+                    [{name: t["p99_us"] for name, t in w["timers"].items()} for w in windows],
+                    index=[datetime.fromtimestamp(w["received"]).strftime("%H:%M:%S") for w in windows],
+                )
+                st.line_chart(p99, height=160)
+
+            extras = {**{f"count: {k}": v for k, v in latest["counters"].items()},
+                      **{f"free stack: {k}": v for k, v in latest["stacks"].items()}}
+            if extras:
+                st.dataframe(pd.Series(extras, name="value"), use_container_width=True)
+
+
 # ============================================================
 # FOOTER
 # ============================================================
@@ -0,0 +1,120 @@
+"""Replay a recorded accelerometer stream (CADENCE_RECORD in algo.py).
+
+Offline, the batches go straight through calculate_tempo, as fast as the
+engine runs, with the tuning constants overridable from the command line:
+
+    python api_endpoint/replay.py walk.cadrec --dead-zone 1.0 --tau 1.5
+
+With --url they are POSTed to a running backend's /acc_data instead, at
+--speed times real time (0 for as fast as it accepts them), which exercises
+the whole ingest path:
+
+    python api_endpoint/replay.py walk.cadrec --url http://127.0.0.1:8000 --speed 20
+"""
+
+from __future__ import annotations
+
+import argparse
+import time
+import urllib.request
+
+import numpy as np
+
+import algo
+
+
+def replay_offline(path, trace_bpm):
+    algo.reset_tempo_engine()
+    batches = samples = steps = 0
+    estimates = {}  # wearer ID -> BPM after each of its batches
+    started = time.perf_counter()
+
+    for received, body in algo.read_recording(path):
+        batch = algo.decode_binary_batch(body)
+        wearer = algo.wearer_state(batch.device)
+        if not algo.align_stream(wearer, batch.start_index, len(batch.samples)):
+            continue
+        bpm, batch_steps = algo.calculate_tempo(wearer, algo.to_sensor_counts(batch.samples, batch.counts_per_g),
+                                                batch.fs)
+        batches += 1
+        samples += len(batch.samples)
+        steps += batch_steps
+        estimates.setdefault(wearer.id, []).append(bpm)
+        if trace_bpm:
+            print(f"{received:.3f} {wearer.id} {batch.start_index} {bpm:.1f}")
+
+    elapsed = time.perf_counter() - started
+    if not estimates:
+        print("No batches in", path)
+        return
+    print(f"{batches} batches, {samples} samples, {steps} steps")
+    for device, bpms in estimates.items():
+        print(f"{device}: BPM final {bpms[-1]:.1f}, mean {np.mean(bpms):.1f}, "
+              f"min {min(bpms):.1f}, max {max(bpms):.1f}, "
+              f"{algo.wearers[device].dropped_samples} samples missing")
+    print(f"{samples / elapsed:.0f} samples/s ({elapsed * 1000:.1f} ms)")
+
+
+def replay_to_backend(path, url, speed):
+    endpoint = url.rstrip("/") + "/acc_data"
+    batches = failures = 0
+    latencies = []
+    first_received = None
+    started = time.perf_counter()
+
+    for received, body in algo.read_recording(path):
+        # Keep the recorded spacing, compressed by speed
+        if first_received is None:
+            first_received = received
+        if speed > 0:
+            due = (received - first_received) / speed
+            delay = due - (time.perf_counter() - started)
+            if delay > 0:
+                time.sleep(delay)
+
+        request = urllib.request.Request(endpoint, data=body, method="POST",
+                                         headers={"Content-Type": "application/octet-stream"})
+        sent = time.perf_counter()
+        try:
+            with urllib.request.urlopen(request, timeout=5) as response:
+                response.read()
+            latencies.append(time.perf_counter() - sent)
+        except OSError as exc:
+            failures += 1
+            print("POST failed:", exc)
+        batches += 1
+
+    elapsed = time.perf_counter() - started
+    if not latencies:
+        print("Nothing was accepted by", endpoint)
+        return
+    latencies_ms = np.array(latencies) * 1000
+    print(f"{batches} batches in {elapsed:.2f} s ({batches / elapsed:.1f}/s), {failures} failed")
+    print(f"POST latency p50 {np.percentile(latencies_ms, 50):.1f} ms, "
+          f"p99 {np.percentile(latencies_ms, 99):.1f} ms, max {latencies_ms.max():.1f} ms")
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Replay a cadence recording")
+    parser.add_argument("recording")
+    parser.add_argument("--url", help="backend to POST the batches to, instead of replaying offline")
+    parser.add_argument("--speed", type=float, default=0, help="times real time for --url, 0 for no pacing")
+    parser.add_argument("--dead-zone", type=float, default=algo.DEAD_ZONE)
+    parser.add_argument("--tau", type=float, default=algo.BASELINE_TAU_SECONDS, help="baseline time constant, s")
+    parser.add_argument("--max-intervals", type=int, default=algo.MAX_INTERVALS)
+    parser.add_argument("--trace-bpm", action="store_true",
+                        help="print arrival time, wearer, start index and BPM per batch")
+    args = parser.parse_args()
+
+    if args.url:
+        replay_to_backend(args.recording, args.url, args.speed)
+        return
+
+    algo.DEAD_ZONE = args.dead_zone
+    algo.BASELINE_TAU_SECONDS = args.tau
+    algo.MAX_INTERVALS = args.max_intervals
+    replay_offline(args.recording, args.trace_bpm)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,165 @@
+// Host timing of the accelerometer kernels, the ones accel_run_benchmark()
+// times on the device, over the same synthetic walking batch
+#include <benchmark/benchmark.h>
+
+#include <math.h>
+#include <vector>
+#include "accel_sample.h"
+#include "acc_payload.h"
+#include "cadence.h"
+#include "cadence_engine.h"
+#include "motion_filter.h"
+
+#define BENCH_RATE_HZ 50
+#define BENCH_STEP_HZ 1.8f  // ~108 steps per minute
+#define BENCH_CADENCE_HZ 25 // as CADENCE_RATE_HZ in accelerometer/main/main.c
+
+// Gravity on z plus a step-shaped bounce, with a little per-axis jitter so
+// the delta encoder sees realistic spreads
+static const sample_batch_t &walking_batch()
+{
+    static sample_batch_t batch;
+    if (batch.count == 0)
+    {
+        const float counts_per_ms2 = MMA8451_COUNTS_PER_G / GRAVITY_CONSTANT;
+        batch.sample_rate_hz = BENCH_RATE_HZ;
+        for (int i = 0; i < SAMPLE_BATCH_MAX_SAMPLES; i++)
+        {
+            float t = (float)i / BENCH_RATE_HZ;
+            float bounce = 3.0f * sinf(2.0f * (float)M_PI * BENCH_STEP_HZ * t);
+            mma8451_sample_t sample = {
+                .x = (int16_t)((int16_t)((0.4f * bounce + (i % 7) * 0.05f) * counts_per_ms2) & ~3),
+                .y = (int16_t)((int16_t)((0.2f * bounce - (i % 5) * 0.05f) * counts_per_ms2) & ~3),
+                .z = (int16_t)((int16_t)((GRAVITY_CONSTANT + bounce) * counts_per_ms2) & ~3),
+            };
+            sample_batch_push(&batch, &sample, (int64_t)i * (1000000 / BENCH_RATE_HZ));
+        }
+    }
+    return batch;
+}
+
+static void BM_to_ms2(benchmark::State &state)
+{
+    const sample_batch_t &batch = walking_batch();
+    for (auto _ : state)
+    {
+        float sum = 0;
+        for (int i = 0; i < batch.count; i++)
+        {
+            const mma8451_sample_t *s = &batch.samples[i];
+            sum += mma8451_to_ms2(s->x) + mma8451_to_ms2(s->y) + mma8451_to_ms2(s->z);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * batch.count);
+}
+BENCHMARK(BM_to_ms2);
+
+static void BM_encode_json(benchmark::State &state)
+{
+    const sample_batch_t &batch = walking_batch();
+    std::vector<char> out(acc_payload_json_size(&batch));
+    size_t len = 0;
+    for (auto _ : state)
+    {
+        len = acc_payload_encode_json(&batch, out.data(), out.size());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch.count);
+    state.counters["bytes"] = (double)len;
+}
+BENCHMARK(BM_encode_json);
+
+static void BM_encode_binary(benchmark::State &state)
+{
+    const sample_batch_t &batch = walking_batch();
+    std::vector<uint8_t> out(acc_payload_binary_size(&batch));
+    size_t len = 0;
+    for (auto _ : state)
+    {
+        len = acc_payload_encode_binary(&batch, out.data(), out.size());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch.count);
+    state.counters["bytes"] = (double)len;
+}
+BENCHMARK(BM_encode_binary);
+
+static void BM_encode_delta(benchmark::State &state)
+{
+    const sample_batch_t &batch = walking_batch();
+    std::vector<uint8_t> out(acc_payload_delta_size(&batch));
+    size_t len = 0;
+    for (auto _ : state)
+    {
+        len = acc_payload_encode_delta(&batch, out.data(), out.size());
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * batch.count);
+    state.counters["bytes"] = (double)len;
+}
+BENCHMARK(BM_encode_delta);
+
+static void BM_motion_filter(benchmark::State &state)
+{
+    const sample_batch_t &batch = walking_batch();
+    motion_filter_t filter;
+    motion_filter_init(&filter, BENCH_RATE_HZ, BENCH_CADENCE_HZ, CADENCE_BASELINE_TAU_S);
+    for (auto _ : state)
+    {
+        for (int i = 0; i < batch.count; i++)
+        {
+            const mma8451_sample_t *s = &batch.samples[i];
+            int32_t out;
+            benchmark::DoNotOptimize(motion_filter_push(&filter, s->x, s->y, s->z, &out));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch.count);
+}
+BENCHMARK(BM_motion_filter);
+
+// cadence_update() alone, on the filter's output for the batch
+static void BM_cadence_update(benchmark::State &state)
+{
+    const sample_batch_t &batch = walking_batch();
+    motion_filter_t filter;
+    motion_filter_init(&filter, BENCH_RATE_HZ, BENCH_CADENCE_HZ, CADENCE_BASELINE_TAU_S);
+    std::vector<int32_t> centered;
+    for (int i = 0; i < batch.count; i++)
+    {
+        const mma8451_sample_t *s = &batch.samples[i];
+        int32_t out;
+        if (motion_filter_push(&filter, s->x, s->y, s->z, &out))
+        {
+            centered.push_back(out);
+        }
+    }
+
+    cadence_t cadence;
+    cadence_init(&cadence, motion_filter_output_hz(&filter, BENCH_RATE_HZ), NULL);
+    for (auto _ : state)
+    {
+        for (int32_t value : centered)
+        {
+            benchmark::DoNotOptimize(cadence_update(&cadence, value));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)centered.size());
+    state.counters["bpm"] = cadence_bpm(&cadence);
+}
+BENCHMARK(BM_cadence_update);
+
+// The whole chain, as the sampler runs it per FIFO burst
+static void BM_cadence_engine(benchmark::State &state)
+{
+    const sample_batch_t &batch = walking_batch();
+    cadence_engine_t cadence;
+    cadence_engine_init(&cadence, BENCH_RATE_HZ, BENCH_CADENCE_HZ, CADENCE_BASELINE_TAU_S, NULL);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(cadence_engine_push(&cadence, &batch.samples[0].x, batch.count));
+    }
+    state.SetItemsProcessed(state.iterations() * batch.count);
+    state.counters["bpm"] = cadence_engine_bpm(&cadence);
+}
+BENCHMARK(BM_cadence_engine);
@@ -0,0 +1,95 @@
+// Host timing of the per-pixel LED kernels, the ones kernel_run_benchmark()
+// times on the device, over KERNEL_BENCH_LED_NUM LEDs
+#include <benchmark/benchmark.h>
+
+#include <vector>
+#include "color.h"
+#include "effects.h"
+#include "frame_blend.h"
+#include "kernel_bench.h"
+#include "pulse_math.h"
+
+#define BENCH_FRAME_US 16667 // 60 fps
+#define BENCH_BPM 120
+
+// Reference: one call per pixel, as led_rainbow_task used to do
+static void BM_hsv2rgb_reference(benchmark::State &state)
+{
+    std::vector<uint8_t> grb(KERNEL_BENCH_LED_NUM * 3);
+    uint32_t round = 0;
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < KERNEL_BENCH_LED_NUM; i++)
+        {
+            uint32_t r, g, b;
+            led_strip_hsv2rgb((round * 2 + i * 10) % 360, 100, 100, &r, &g, &b);
+            grb[i * 3 + 0] = g;
+            grb[i * 3 + 1] = r;
+            grb[i * 3 + 2] = b;
+        }
+        round++;
+        benchmark::DoNotOptimize(grb.data());
+    }
+    state.SetItemsProcessed(state.iterations() * KERNEL_BENCH_LED_NUM);
+}
+BENCHMARK(BM_hsv2rgb_reference);
+
+static void BM_hsv8_to_grb(benchmark::State &state)
+{
+    std::vector<uint8_t> hue(KERNEL_BENCH_LED_NUM);
+    std::vector<uint8_t> grb(KERNEL_BENCH_LED_NUM * 3);
+    for (size_t i = 0; i < KERNEL_BENCH_LED_NUM; i++)
+    {
+        hue[i] = (uint8_t)(i * 7);
+    }
+    for (auto _ : state)
+    {
+        hue[0] += 1; // keep the compiler from hoisting the conversion out of the loop
+        hsv8_to_grb(hue.data(), KERNEL_BENCH_LED_NUM, 255, 127, grb.data());
+        benchmark::DoNotOptimize(grb.data());
+    }
+    state.SetItemsProcessed(state.iterations() * KERNEL_BENCH_LED_NUM);
+}
+BENCHMARK(BM_hsv8_to_grb);
+
+// One pulse frame: advance the beat, then fill the strip
+static void BM_pulse_frame(benchmark::State &state)
+{
+    static PulseEffect<KERNEL_BENCH_LED_NUM> pulse{0, 0, 200};
+    std::vector<uint8_t> grb(KERNEL_BENCH_LED_NUM * 3);
+    BeatPhase beat;
+    beat_phase_init(&beat, 0);
+    EffectContext ctx = {};
+    ctx.bpm = BENCH_BPM;
+    ctx.beat = &beat;
+    for (auto _ : state)
+    {
+        ctx.t_us += BENCH_FRAME_US;
+        beat_phase_advance(&beat, ctx.t_us, BENCH_BPM);
+        pulse.render(grb.data(), ctx);
+        benchmark::DoNotOptimize(grb.data());
+    }
+    state.SetItemsProcessed(state.iterations() * KERNEL_BENCH_LED_NUM);
+}
+BENCHMARK(BM_pulse_frame);
+
+// Crossfade step from a rainbow frame into a pulse frame
+static void BM_frame_blend(benchmark::State &state)
+{
+    std::vector<uint8_t> hue(KERNEL_BENCH_LED_NUM);
+    std::vector<uint8_t> from(KERNEL_BENCH_LED_NUM * 3);
+    std::vector<uint8_t> grb(KERNEL_BENCH_LED_NUM * 3, 200);
+    for (size_t i = 0; i < KERNEL_BENCH_LED_NUM; i++)
+    {
+        hue[i] = (uint8_t)(i * 7);
+    }
+    hsv8_to_grb(hue.data(), KERNEL_BENCH_LED_NUM, 255, 127, from.data());
+    uint8_t step = 0;
+    for (auto _ : state)
+    {
+        frame_blend(grb.data(), from.data(), grb.size(), step++);
+        benchmark::DoNotOptimize(grb.data());
+    }
+    state.SetItemsProcessed(state.iterations() * KERNEL_BENCH_LED_NUM);
+}
+BENCHMARK(BM_frame_blend);
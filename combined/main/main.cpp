@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "mma8451.h"
+#include "cadence_engine.h"
+#include "effect_engine.h"
+#include "frame_scheduler.h"
+#include "led_frame.h"
+#include "pulse_math.h"
+#include "lcd.h"
+#include "display.h"
+#include "perf_counters.h"
+#include "task_placement.h"
+
+#if CONFIG_COMBINED_BACKEND
+#include "esp_http_client.h"
+#include "esp_mac.h"
+#include "wifi_connect.h"
+#include "backend_discovery.h"
+#include "ota_update.h"
+#endif
+
+// One board, no network in the loop: the accelerometer's cadence engine
+// drives the LED pulse and the LCD directly.
+//
+//   sensor task (core 1)  FIFO burst -> cadence engine, one sample at a time
+//        | CadenceState, published lock-free (seqlock below)
+//   LED task (core 1)     pulse locked onto the footsteps, mood from the BPM
+//   status task (core 0)  LCD updates; with CONFIG_COMBINED_BACKEND also
+//                         Wi-Fi, /cadence reports and OTA
+//
+// A step reaches the lights within one FIFO burst (40 ms at 100 Hz) plus one
+// frame, against two HTTP round trips through the backend for the three
+// separate nodes.
+
+static const char *TAG = "CADENCE_NODE";
+
+#define I2C_MASTER_NUM I2C_NUM_0
+#define SAMPLE_ODR MMA8451_ODR_100HZ
+#define FIFO_WATERMARK 4 // one wake-up per 40 ms
+#define CADENCE_RATE_HZ 25 // the motion filter decimates to at least this rate
+
+#define REST_BPM 40 // pulse while nobody walks
+#define STEP_LOCK_MIN_CONFIDENCE 0.5f // steadier than this, the pulse peaks land on the steps
+#define DISPLAY_UPDATE_MS 250
+#define CADENCE_REPORT_MS 1000
+
+// Same thresholds as classify_mood() in api_endpoint/algo.py
+#define MOOD_CALM_BELOW 70
+#define MOOD_NEUTRAL_BELOW 100
+#define MOOD_HAPPY_BELOW 130
+#define MOOD_NERVOUS_BELOW 160
+
+// The control loop has the real-time core to itself; the LCD and the backend
+// stay on core 0 with Wi-Fi and lwIP (task_placement.h)
+#define CONTROL_CORE TASK_CORE_REALTIME
+#define STATUS_CORE TASK_CORE_NETWORK
+#define SENSOR_TASK_PRIORITY (TASK_PRIO_REALTIME + 1) // above the LEDs: a sample never waits for a frame
+#define LED_TASK_PRIORITY TASK_PRIO_REALTIME
+#define STATUS_TASK_PRIORITY TASK_PRIO_NETWORK
+#define DISPLAY_TASK_PRIORITY TASK_PRIO_BACKGROUND
+
+// Latest cadence. Written by the sensor task only; the LED and status tasks
+// read it without a lock: the writer makes seq odd while it updates, and a
+// reader retries if seq was odd or moved under it. The writer never waits,
+// and a reader on the same core can't interrupt it (lower priority).
+typedef struct
+{
+    uint32_t bpm_milli;   // engine estimate in milli-BPM
+    float confidence;
+    int64_t last_step_us; // esp_timer time of the sample that completed the last step, 0 before the first
+    uint32_t steps;
+    float sample_rate_hz;
+} CadenceState;
+
+static std::atomic<uint32_t> cadence_seq{0};
+static CadenceState cadence_shared;
+
+static void cadence_publish(const CadenceState &state)
+{
+    uint32_t seq = cadence_seq.load(std::memory_order_relaxed);
+    cadence_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    cadence_shared = state;
+    cadence_seq.store(seq + 2, std::memory_order_release);
+}
+
+static CadenceState cadence_read(void)
+{
+    CadenceState state;
+    uint32_t before, after;
+    do
+    {
+        before = cadence_seq.load(std::memory_order_acquire);
+        state = cadence_shared;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = cadence_seq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return state;
+}
+
+// Walking: a step within the engine's still time (its history clears after that)
+static bool cadence_walking(const CadenceState &state, int64_t now_us)
+{
+    return state.last_step_us != 0 && now_us - state.last_step_us < (int64_t)(CADENCE_STILL_S * 1000000);
+}
+
+static uint32_t cadence_shown_bpm(const CadenceState &state, int64_t now_us)
+{
+    return cadence_walking(state, now_us) ? (state.bpm_milli + 500) / 1000 : REST_BPM;
+}
+
+static int mood_for_bpm(uint32_t bpm)
+{
+    if (bpm < MOOD_CALM_BELOW)
+    {
+        return MOOD_CALM;
+    }
+    if (bpm < MOOD_NEUTRAL_BELOW)
+    {
+        return MOOD_NEUTRAL;
+    }
+    if (bpm < MOOD_HAPPY_BELOW)
+    {
+        return MOOD_HAPPY;
+    }
+    if (bpm < MOOD_NERVOUS_BELOW)
+    {
+        return MOOD_NERVOUS;
+    }
+    return MOOD_ANGRY;
+}
+
+static i2c_master_bus_handle_t i2c_bus;
+
+static esp_err_t i2c_bus_init(void)
+{
+    i2c_master_bus_config_t bus_cfg = {};
+    bus_cfg.i2c_port = I2C_MASTER_NUM;
+    bus_cfg.sda_io_num = (gpio_num_t)CONFIG_COMBINED_ACCEL_SDA_GPIO;
+    bus_cfg.scl_io_num = (gpio_num_t)CONFIG_COMBINED_ACCEL_SCL_GPIO;
+    bus_cfg.clk_source = I2C_CLK_SRC_DEFAULT;
+    bus_cfg.glitch_ignore_cnt = 7;
+    bus_cfg.flags.enable_internal_pullup = true;
+    return i2c_new_master_bus(&bus_cfg, &i2c_bus);
+}
+
+PERF_TIMER(cadence_timer, "cadence_burst");
+PERF_COUNTER(sensor_errors, "sensor_errors");
+
+static mma8451_sample_t fifo_burst[MMA8451_FIFO_SIZE];
+static cadence_engine_t cadence;
+
+void sensor_task(void *pvParameters)
+{
+    perf_watch_task(NULL);
+    cadence_engine_init(&cadence, 800 >> SAMPLE_ODR, CADENCE_RATE_HZ, CADENCE_BASELINE_TAU_S, NULL);
+    CadenceState state = {};
+
+    while (1)
+    {
+        int64_t first_us;
+        int n = mma8451_fifo_read(fifo_burst, MMA8451_FIFO_SIZE, &first_us, pdMS_TO_TICKS(1000));
+        if (n <= 0)
+        {
+            if (n < 0)
+            {
+                perf_count(&sensor_errors, 1);
+            }
+            continue;
+        }
+
+        state.sample_rate_hz = mma8451_fifo_rate_hz();
+        cadence_engine_set_rate(&cadence, state.sample_rate_hz);
+        PERF_SCOPE(cadence_timer)
+        {
+            // One sample at a time, so a step is stamped with the sample that completed it
+            for (int i = 0; i < n; i++)
+            {
+                if (cadence_engine_push(&cadence, &fifo_burst[i].x, 1) > 0)
+                {
+                    state.last_step_us = first_us + (int64_t)(i * 1000000.0f / state.sample_rate_hz);
+                    state.steps++;
+                }
+            }
+        }
+        state.bpm_milli = (uint32_t)(cadence_engine_bpm(&cadence) * 1000.0f);
+        state.confidence = cadence_engine_confidence(&cadence);
+        cadence_publish(state);
+    }
+}
+
+// 10 MHz RMT ticks, channel memory refilled by interrupt (no DMA) as on the LED node
+static const LedFrameConfig strip_config = {CONFIG_COMBINED_LED_GPIO, CONFIG_COMBINED_LED_NUM, 10000000, false, 0};
+static LedFrameSet led_frames;
+static StripEffects<CONFIG_COMBINED_LED_NUM> strip_effects;
+static EffectEngine effect_engine;
+
+PERF_TIMER(render_timer, "render");
+PERF_TIMER(present_timer, "present");
+
+// Each step is a beat. Once the cadence is steady the beat phase locks onto
+// the footsteps, so the pulse peaks as the foot lands; otherwise (first
+// steps, stumbling, standing) it free-runs on the shown BPM.
+void led_effect_task(void *pvParameters)
+{
+    // Set up from here, on the control core: the RMT channel's refill
+    // interrupt lands on the core that created it, away from Wi-Fi
+    ESP_ERROR_CHECK(led_frame_set_init(&led_frames, &strip_config, 1));
+    effect_engine.init(&led_frames);
+    effect_engine.bind_strip(0, strip_effects);
+    perf_watch_task(NULL);
+
+    FrameScheduler sched;
+    frame_scheduler_init(&sched, FRAME_PERIOD_MS);
+    BeatPhase phase;
+    beat_phase_init(&phase, frame_scheduler_elapsed_us(&sched));
+    int mood = MOOD_NEUTRAL;
+
+    while (1)
+    {
+        int64_t now_us = frame_scheduler_elapsed_us(&sched);
+        CadenceState state = cadence_read();
+        uint32_t bpm = cadence_shown_bpm(state, sched.start_us + now_us);
+
+        if (cadence_walking(state, sched.start_us + now_us) && state.confidence >= STEP_LOCK_MIN_CONFIDENCE)
+        {
+            beat_phase_lock(&phase, now_us, state.bpm_milli, state.last_step_us - sched.start_us);
+        }
+        else
+        {
+            beat_phase_advance(&phase, now_us, bpm);
+        }
+
+        int next_mood = mood_for_bpm(bpm);
+        if (next_mood != mood)
+        {
+            mood = next_mood;
+            effect_engine.select_mood(mood);
+        }
+
+        EffectContext ctx = {
+            .t_us = now_us,
+            .bpm = bpm,
+            .mood = mood,
+            .beat = &phase,
+            .led_offset = 0,
+        };
+        PERF_SCOPE(render_timer)
+        {
+            effect_engine.render(ctx);
+        }
+        PERF_SCOPE(present_timer)
+        {
+            led_frame_set_present(&led_frames);
+        }
+        frame_scheduler_wait(&sched);
+    }
+}
+
+#if CONFIG_COMBINED_BACKEND
+PERF_TIMER(cadence_post_timer, "cadence_post");
+
+static uint32_t device_id;
+static esp_http_client_handle_t cadence_client;
+static uint32_t cadence_generation;
+
+// Same report as the accelerometer node's, so the backend lists this board
+// among the wearers
+static void post_cadence(const CadenceState &state)
+{
+    char body[128];
+    int len = snprintf(body, sizeof(body), "{\"device\": \"%08lx\", \"bpm\": %.1f, \"confidence\": %.2f, \"fs\": %.3f}",
+                       (unsigned long)device_id, state.bpm_milli / 1000.0f, state.confidence, state.sample_rate_hz);
+
+    char url[64];
+    backend_discovery_url("/cadence", url, sizeof(url));
+    if (cadence_client == NULL)
+    {
+        cadence_generation = backend_discovery_generation();
+        esp_http_client_config_t config = {};
+        config.url = url;
+        config.method = HTTP_METHOD_POST;
+        config.timeout_ms = 2000;
+        config.keep_alive_enable = true;
+        cadence_client = esp_http_client_init(&config);
+        esp_http_client_set_header(cadence_client, "Content-Type", "application/json");
+    }
+    else if (backend_discovery_generation() != cadence_generation)
+    {
+        cadence_generation = backend_discovery_generation();
+        esp_http_client_set_url(cadence_client, url);
+    }
+
+    esp_http_client_set_post_field(cadence_client, body, len);
+    esp_err_t err;
+    PERF_SCOPE(cadence_post_timer)
+    {
+        err = esp_http_client_perform(cadence_client);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Cadence report failed: %s", esp_err_to_name(err));
+        esp_http_client_close(cadence_client);
+        backend_discovery_invalidate();
+    }
+}
+#endif
+
+// Everything off the control loop. The display task redraws on its own; this
+// only posts the newest value.
+void status_task(void *pvParameters)
+{
+    perf_watch_task(NULL);
+    display_update_t shown = {};
+#if CONFIG_COMBINED_BACKEND
+    bool backend_up = false;
+    TickType_t last_report = 0;
+#endif
+
+    while (1)
+    {
+        CadenceState state = cadence_read();
+        uint32_t bpm = cadence_shown_bpm(state, esp_timer_get_time());
+        display_update_t update = {
+            .bpm = (int)bpm,
+            .mood = (display_mood_t)mood_for_bpm(bpm),
+        };
+        if (update.bpm != shown.bpm || update.mood != shown.mood)
+        {
+            display_post(&update);
+            shown = update;
+        }
+
+#if CONFIG_COMBINED_BACKEND
+        // Never waits for Wi-Fi: the display keeps updating while it connects
+        if (!backend_up && wifi_connect_is_connected())
+        {
+            ESP_ERROR_CHECK(backend_discovery_init("cadence-node"));
+            ESP_ERROR_CHECK(perf_report_start("combined"));
+            ESP_ERROR_CHECK(ota_update_start("combined"));
+            backend_up = true;
+        }
+        TickType_t now = xTaskGetTickCount();
+        if (backend_up && wifi_connect_is_connected() && now - last_report >= pdMS_TO_TICKS(CADENCE_REPORT_MS))
+        {
+            last_report = now;
+            post_cadence(state);
+        }
+#endif
+        vTaskDelay(pdMS_TO_TICKS(DISPLAY_UPDATE_MS));
+    }
+}
+
+// Task stacks are static, in bytes. /telemetry reports each one's free bytes
+// at its deepest point so far ("stacks"); trim against that, keeping a margin
+// for paths a short run doesn't hit (reconnects, OTA).
+#define SENSOR_STACK_SIZE 4096
+#define LED_STACK_SIZE 4096
+#define STATUS_STACK_SIZE 4096
+
+static StackType_t sensor_stack[SENSOR_STACK_SIZE];
+static StaticTask_t sensor_tcb;
+static StackType_t led_stack[LED_STACK_SIZE];
+static StaticTask_t led_tcb;
+static StackType_t status_stack[STATUS_STACK_SIZE];
+static StaticTask_t status_tcb;
+
+extern "C" void app_main(void)
+{
+    lcd_config_t lcd_config = {
+        .rs = (gpio_num_t)CONFIG_COMBINED_LCD_RS_GPIO,
+        .e = (gpio_num_t)CONFIG_COMBINED_LCD_E_GPIO,
+        .rw = GPIO_NUM_NC,
+        .d4 = (gpio_num_t)CONFIG_COMBINED_LCD_D4_GPIO,
+        .d5 = (gpio_num_t)CONFIG_COMBINED_LCD_D5_GPIO,
+        .d6 = (gpio_num_t)CONFIG_COMBINED_LCD_D6_GPIO,
+        .d7 = (gpio_num_t)CONFIG_COMBINED_LCD_D7_GPIO,
+        .slow_timing = false,
+        .fast_gpio = true,
+    };
+    ESP_ERROR_CHECK(lcd_init(&lcd_config));
+    ESP_ERROR_CHECK(display_start(DISPLAY_TASK_PRIORITY, STATUS_CORE));
+
+    ESP_ERROR_CHECK(i2c_bus_init());
+    if (mma8451_init(i2c_bus) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "No accelerometer, the lights stay at rest");
+    }
+    else
+    {
+        ESP_ERROR_CHECK(mma8451_start_fifo(SAMPLE_ODR, FIFO_WATERMARK, CONFIG_COMBINED_ACCEL_INT1_GPIO));
+        xTaskCreateStaticPinnedToCore(sensor_task, "sensor", SENSOR_STACK_SIZE, NULL, SENSOR_TASK_PRIORITY,
+                                      sensor_stack, &sensor_tcb, CONTROL_CORE);
+    }
+    xTaskCreateStaticPinnedToCore(led_effect_task, "led_effect", LED_STACK_SIZE, NULL, LED_TASK_PRIORITY, led_stack,
+                                  &led_tcb, CONTROL_CORE);
+
+#if CONFIG_COMBINED_BACKEND
+    uint8_t mac[6];
+    ESP_ERROR_CHECK(esp_read_mac(mac, ESP_MAC_WIFI_STA));
+    device_id = (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 | (uint32_t)mac[4] << 8 | mac[5];
+    ESP_LOGI(TAG, "Device ID %08lx", (unsigned long)device_id);
+    wifi_connect_config_t wifi_config = WIFI_CONNECT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(wifi_connect_start(&wifi_config));
+#endif
+    xTaskCreateStaticPinnedToCore(status_task, "status", STATUS_STACK_SIZE, NULL, STATUS_TASK_PRIORITY, status_stack,
+                                  &status_tcb, STATUS_CORE);
+}
@@ -0,0 +1,141 @@
+#include "backend_discovery.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "mdns.h"
+
+static const char *TAG = "BACKEND_DISCOVERY";
+
+static SemaphoreHandle_t s_lock;
+static StaticSemaphore_t s_lock_buf;
+static backend_addr_t s_addr;
+static bool s_valid;              // s_addr can be used without resolving
+static int64_t s_last_resolve_us; // when the last mDNS query went out
+static bool s_resolved_once;
+static uint32_t s_generation;
+
+static void use_fallback(void)
+{
+    strncpy(s_addr.host, CONFIG_BACKEND_DISCOVERY_FALLBACK_HOST, sizeof(s_addr.host) - 1);
+    s_addr.host[sizeof(s_addr.host) - 1] = '\0';
+    s_addr.port = CONFIG_BACKEND_DISCOVERY_FALLBACK_PORT;
+    s_addr.discovered = false;
+}
+
+// First IPv4 address of a result, asking for the host's A record if the
+// answer didn't carry one
+static bool result_ipv4(const mdns_result_t *result, esp_ip4_addr_t *ip)
+{
+    for (const mdns_ip_addr_t *a = result->addr; a != NULL; a = a->next)
+    {
+        if (a->addr.type == ESP_IPADDR_TYPE_V4)
+        {
+            *ip = a->addr.u_addr.ip4;
+            return true;
+        }
+    }
+    return result->hostname != NULL &&
+           mdns_query_a(result->hostname, CONFIG_BACKEND_DISCOVERY_QUERY_MS, ip) == ESP_OK;
+}
+
+// Called with s_lock held
+static void resolve(void)
+{
+    s_last_resolve_us = esp_timer_get_time();
+    s_resolved_once = true;
+
+    backend_addr_t previous = s_addr;
+    mdns_result_t *results = NULL;
+    esp_err_t err = mdns_query_ptr(CONFIG_BACKEND_DISCOVERY_SERVICE, "_tcp", CONFIG_BACKEND_DISCOVERY_QUERY_MS,
+                                   4, &results);
+    bool found = false;
+    for (mdns_result_t *r = results; err == ESP_OK && r != NULL && !found; r = r->next)
+    {
+        esp_ip4_addr_t ip;
+        if (r->port != 0 && result_ipv4(r, &ip))
+        {
+            esp_ip4addr_ntoa(&ip, s_addr.host, sizeof(s_addr.host));
+            s_addr.port = r->port;
+            s_addr.discovered = true;
+            found = true;
+        }
+    }
+    mdns_query_results_free(results);
+
+    if (found)
+    {
+        ESP_LOGI(TAG, "Backend at %s:%u", s_addr.host, s_addr.port);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "No %s._tcp answer (%s), using %s:%d", CONFIG_BACKEND_DISCOVERY_SERVICE,
+                 esp_err_to_name(err), CONFIG_BACKEND_DISCOVERY_FALLBACK_HOST,
+                 CONFIG_BACKEND_DISCOVERY_FALLBACK_PORT);
+        use_fallback();
+    }
+
+    if (strcmp(previous.host, s_addr.host) != 0 || previous.port != s_addr.port)
+    {
+        s_generation++;
+    }
+    s_valid = true;
+}
+
+esp_err_t backend_discovery_init(const char *hostname)
+{
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+    use_fallback();
+
+    esp_err_t err = mdns_init();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    if (hostname != NULL)
+    {
+        mdns_hostname_set(hostname);
+    }
+    return ESP_OK;
+}
+
+backend_addr_t backend_discovery_get(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // After a failure, only query again once the retry interval has passed;
+    // until then keep handing out the address we have
+    if (!s_resolved_once ||
+        (!s_valid && esp_timer_get_time() - s_last_resolve_us >= CONFIG_BACKEND_DISCOVERY_MIN_RETRY_MS * 1000LL))
+    {
+        resolve();
+    }
+    backend_addr_t addr = s_addr;
+    xSemaphoreGive(s_lock);
+    return addr;
+}
+
+int backend_discovery_url(const char *path, char *buf, size_t len)
+{
+    backend_addr_t addr = backend_discovery_get();
+    int n = snprintf(buf, len, "http://%s:%u%s", addr.host, addr.port, path);
+    return (n < 0 || (size_t)n >= len) ? -1 : n;
+}
+
+void backend_discovery_invalidate(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_valid = false;
+    xSemaphoreGive(s_lock);
+}
+
+uint32_t backend_discovery_generation(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t generation = s_generation;
+    xSemaphoreGive(s_lock);
+    return generation;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Finds the cadence backend on the LAN instead of baking in its IP.
+//
+// The backend advertises _cadence._tcp over mDNS. The first
+// backend_discovery_url() call resolves it and caches the address; later
+// calls only format a string, so there is no DNS or mDNS on the hot path.
+// When a request to the backend fails, the caller reports it with
+// backend_discovery_invalidate() and the next call resolves again (at most
+// every CONFIG_BACKEND_DISCOVERY_MIN_RETRY_MS). If nothing answers, the
+// Kconfig fallback address is used.
+//
+// Call from tasks only, after Wi-Fi is up; a resolution blocks for up to
+// CONFIG_BACKEND_DISCOVERY_QUERY_MS.
+
+#define BACKEND_HOST_MAX 16 // dotted IPv4
+
+typedef struct
+{
+    char host[BACKEND_HOST_MAX];
+    uint16_t port;
+    bool discovered; // false: the fallback address
+} backend_addr_t;
+
+esp_err_t backend_discovery_init(const char *hostname);
+
+// Current backend address, resolving first if there is none cached
+backend_addr_t backend_discovery_get(void);
+
+// "http://<host>:<port><path>" into buf; returns the length, or -1 if it didn't fit
+int backend_discovery_url(const char *path, char *buf, size_t len);
+
+// A request to the cached address failed: resolve again on the next call
+void backend_discovery_invalidate(void);
+
+// Bumped whenever the cached address changes, so long-lived clients know
+// when to update their URL
+uint32_t backend_discovery_generation(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,140 @@
+#include "cadence.h"
+
+#include <math.h>
+#include <string.h>
+#include "motion_filter.h"
+
+void cadence_init(cadence_t *c, float fs, const cadence_config_t *config)
+{
+    memset(c, 0, sizeof(*c));
+    cadence_config_t defaults = CADENCE_CONFIG_DEFAULT();
+    c->config = config != NULL ? *config : defaults;
+    if (c->config.max_intervals < 1 || c->config.max_intervals > CADENCE_MAX_INTERVALS)
+    {
+        c->config.max_intervals = CADENCE_MAX_INTERVALS;
+    }
+    c->dead_zone = motion_filter_from_ms2(c->config.dead_zone_ms2);
+    cadence_set_rate(c, fs);
+}
+
+void cadence_set_rate(cadence_t *c, float fs)
+{
+    c->fs = fs;
+    c->min_interval = (uint32_t)ceilf(c->config.min_interval_s * fs);
+    c->still_samples = (uint32_t)(c->config.still_s * fs);
+}
+
+// Ring insert that keeps the sums current: the interval falling out is
+// subtracted, the new one added
+static void add_interval(cadence_t *c, uint32_t interval)
+{
+    if (c->interval_count == c->config.max_intervals)
+    {
+        uint32_t old = c->intervals[c->interval_next];
+        c->interval_sum -= old;
+        c->interval_sq_sum -= (uint64_t)old * old;
+    }
+    else
+    {
+        c->interval_count++;
+    }
+    c->intervals[c->interval_next] = interval;
+    c->interval_sum += interval;
+    c->interval_sq_sum += (uint64_t)interval * interval;
+    c->interval_next = (c->interval_next + 1) % c->config.max_intervals;
+}
+
+bool cadence_update(cadence_t *c, int32_t centered)
+{
+    bool step = false;
+
+    // Hysteresis: a step is a rise from below -dead_zone to above +dead_zone
+    if (centered < -c->dead_zone)
+    {
+        c->armed = true;
+    }
+    else if (c->armed && centered >= c->dead_zone)
+    {
+        c->armed = false;
+        if (c->have_cross)
+        {
+            uint32_t interval = c->sample_index - c->last_cross;
+            if (interval >= c->min_interval)
+            {
+                add_interval(c, interval);
+            }
+        }
+        c->have_cross = true;
+        c->last_cross = c->sample_index;
+        c->steps++;
+        step = true;
+    }
+
+    c->sample_index++;
+    return step;
+}
+
+void cadence_skip(cadence_t *c, uint32_t samples)
+{
+    c->sample_index += samples;
+}
+
+// Drops the history once no step has been seen for still_s
+static bool is_still(cadence_t *c)
+{
+    if (c->interval_count == 0)
+    {
+        return true;
+    }
+    if (c->sample_index - c->last_cross > c->still_samples)
+    {
+        c->interval_count = 0;
+        c->interval_next = 0;
+        c->interval_sum = 0;
+        c->interval_sq_sum = 0;
+        return true;
+    }
+    return false;
+}
+
+// Mean step interval in samples
+static float mean_interval(const cadence_t *c)
+{
+    return (float)c->interval_sum / c->interval_count;
+}
+
+float cadence_bpm(cadence_t *c)
+{
+    if (is_still(c))
+    {
+        return CADENCE_DEFAULT_BPM;
+    }
+
+    float avg_interval = mean_interval(c);
+    if (avg_interval <= 0)
+    {
+        return CADENCE_DEFAULT_BPM;
+    }
+
+    float bpm = 60.0f * c->fs / avg_interval;
+    return fmaxf(CADENCE_MIN_BPM, fminf(bpm, CADENCE_MAX_BPM));
+}
+
+float cadence_confidence(cadence_t *c)
+{
+    if (is_still(c))
+    {
+        return 0.0f;
+    }
+
+    // Regularity: 1 - coefficient of variation of the intervals. The
+    // variance comes exactly from the integer sums: (n * sum(x^2) - sum(x)^2) / n^2
+    uint64_t n = (uint64_t)c->interval_count;
+    uint64_t spread = n * c->interval_sq_sum - (uint64_t)c->interval_sum * c->interval_sum;
+    float var = (float)spread / (float)(n * n);
+    float cv = sqrtf(var) / mean_interval(c);
+    float regularity = fmaxf(0.0f, 1.0f - cv);
+
+    float fill = (float)c->interval_count / c->config.max_intervals;
+    return regularity * fill;
+}
@@ -0,0 +1,62 @@
+#include "cadence_engine.h"
+
+void cadence_engine_init(cadence_engine_t *e, uint32_t input_hz, uint32_t cadence_hz, float tau_s,
+                         const cadence_config_t *config)
+{
+    e->input_hz = input_hz;
+    e->skip_pending = 0;
+    motion_filter_init(&e->filter, input_hz, cadence_hz, tau_s);
+    cadence_init(&e->cadence, motion_filter_output_hz(&e->filter, input_hz), config);
+}
+
+void cadence_engine_set_rate(cadence_engine_t *e, float input_hz)
+{
+    cadence_set_rate(&e->cadence, motion_filter_output_hz(&e->filter, input_hz));
+}
+
+uint32_t cadence_engine_push(cadence_engine_t *e, const int16_t *xyz, size_t count)
+{
+    uint32_t steps = 0;
+    for (size_t i = 0; i < count; i++, xyz += 3)
+    {
+        int32_t centered;
+        if (motion_filter_push(&e->filter, xyz[0], xyz[1], xyz[2], &centered) &&
+            cadence_update(&e->cadence, centered))
+        {
+            steps++;
+        }
+    }
+    return steps;
+}
+
+void cadence_engine_skip(cadence_engine_t *e, uint32_t count)
+{
+    e->skip_pending += count;
+    cadence_skip(&e->cadence, e->skip_pending >> e->filter.decim_shift);
+    e->skip_pending &= (1u << e->filter.decim_shift) - 1;
+}
+
+float cadence_engine_bpm(cadence_engine_t *e)
+{
+    return cadence_bpm(&e->cadence);
+}
+
+float cadence_engine_confidence(cadence_engine_t *e)
+{
+    return cadence_confidence(&e->cadence);
+}
+
+float cadence_engine_baseline_ms2(const cadence_engine_t *e)
+{
+    return motion_filter_to_ms2(motion_filter_baseline(&e->filter));
+}
+
+int cadence_engine_interval_count(const cadence_engine_t *e)
+{
+    return e->cadence.interval_count;
+}
+
+size_t cadence_engine_size(void)
+{
+    return sizeof(cadence_engine_t);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Zero-crossing cadence engine, shared by the accelerometer firmware and the
+// backend (api_endpoint/cadence_engine.py binds it with ctypes).
+//
+// An upward crossing of the high-passed magnitude through the dead zone
+// marks a step, and the BPM comes from the mean of the last max_intervals
+// step intervals. Input comes from motion_filter (baseline already removed,
+// in counts), intervals are kept in samples in a fixed ring with a running
+// sum and sum of squares, so every update, cadence_bpm() and
+// cadence_confidence() are constant time. Floats only appear in those two.
+// State is a fixed-size struct, so it runs without allocation.
+
+#define CADENCE_MAX_INTERVALS 10     // ring capacity, and the default history
+#define CADENCE_DEAD_ZONE_MS2 1.2f   // m/s^2 either side of the baseline
+#define CADENCE_MIN_INTERVAL_S 0.4f  // shorter intervals are bounce, not steps
+#define CADENCE_STILL_S 2.0f         // no step for this long clears the history
+#define CADENCE_BASELINE_TAU_S 2.0f  // EMA time constant (alpha 0.1 at 5 Hz)
+#define CADENCE_DEFAULT_BPM 65.0f
+#define CADENCE_MIN_BPM 40.0f
+#define CADENCE_MAX_BPM 180.0f
+
+typedef struct
+{
+    float dead_zone_ms2;
+    float min_interval_s;
+    float still_s;
+    int max_intervals; // steps averaged, 1..CADENCE_MAX_INTERVALS
+} cadence_config_t;
+
+#define CADENCE_CONFIG_DEFAULT() {CADENCE_DEAD_ZONE_MS2, CADENCE_MIN_INTERVAL_S, CADENCE_STILL_S, CADENCE_MAX_INTERVALS}
+
+typedef struct
+{
+    cadence_config_t config;
+    float fs;
+    int32_t dead_zone;          // counts
+    uint32_t min_interval;      // samples
+    uint32_t still_samples;
+    bool armed;                 // went below -dead_zone since the last crossing
+    uint32_t sample_index;
+    bool have_cross;
+    uint32_t last_cross;
+    uint32_t intervals[CADENCE_MAX_INTERVALS]; // ring of step intervals in samples
+    int interval_count;
+    int interval_next;
+    uint32_t interval_sum;      // of the intervals in the ring
+    uint64_t interval_sq_sum;
+    uint32_t steps;
+} cadence_t;
+
+// config may be NULL for CADENCE_CONFIG_DEFAULT()
+void cadence_init(cadence_t *c, float fs, const cadence_config_t *config);
+
+// Follow a new (e.g. measured) sample rate without losing the step history
+void cadence_set_rate(cadence_t *c, float fs);
+
+// Feed one high-passed magnitude sample in counts; returns true if it
+// completed a step
+bool cadence_update(cadence_t *c, int32_t centered);
+
+// Samples that never arrived: move the clock on so intervals stay in time
+void cadence_skip(cadence_t *c, uint32_t samples);
+
+// Current estimate; CADENCE_DEFAULT_BPM while still or before two steps
+float cadence_bpm(cadence_t *c);
+
+// 0..1: how full and how regular the interval history is
+float cadence_confidence(cadence_t *c);
+
+#ifdef __cplusplus
+}
+#endif
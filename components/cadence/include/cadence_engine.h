@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cadence.h"
+#include "motion_filter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One accelerometer stream through motion_filter and cadence.
+//
+// The accelerometer feeds it every sample as taken; the backend feeds it
+// each uploaded batch through api_endpoint/cadence_engine.py. Same code, same
+// constants, so the two only differ by the samples a lost batch takes away.
+// Input is raw MMA8451 counts (14-bit left-justified, 16384 per g) with x, y
+// and z interleaved, which is also the layout of an mma8451_sample_t array.
+
+typedef struct
+{
+    motion_filter_t filter;
+    cadence_t cadence;
+    uint32_t input_hz;     // nominal rate the filter was set up for
+    uint32_t skip_pending; // skipped input samples short of one decimated sample
+} cadence_engine_t;
+
+// cadence_hz: the lowest rate the filter may decimate to; config may be NULL
+void cadence_engine_init(cadence_engine_t *e, uint32_t input_hz, uint32_t cadence_hz, float tau_s,
+                         const cadence_config_t *config);
+
+// Follow the measured input rate (close to the nominal input_hz)
+void cadence_engine_set_rate(cadence_engine_t *e, float input_hz);
+
+// Feed count samples; returns the steps they completed
+uint32_t cadence_engine_push(cadence_engine_t *e, const int16_t *xyz, size_t count);
+
+// count input samples were lost: advance the step clock over them
+void cadence_engine_skip(cadence_engine_t *e, uint32_t count);
+
+float cadence_engine_bpm(cadence_engine_t *e);
+float cadence_engine_confidence(cadence_engine_t *e);
+float cadence_engine_baseline_ms2(const cadence_engine_t *e);
+int cadence_engine_interval_count(const cadence_engine_t *e);
+
+// For bindings that allocate the state themselves
+size_t cadence_engine_size(void);
+
+#ifdef __cplusplus
+}
+#endif
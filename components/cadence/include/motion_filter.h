@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Integer front end for the cadence engine.
+//
+// raw counts -> squared magnitude -> integer square root -> EMA high-pass
+// -> boxcar decimation. Input is the MMA8451's output registers as read
+// (14-bit, left-justified). Everything stays in sensor counts (4096 counts/g
+// after dropping the 2 padding bits); physical units only appear where a
+// value leaves the engine or is logged (motion_filter_to_ms2()).
+//
+// The EMA uses a power-of-two alpha, so the per-sample cost is a few
+// multiplies, shifts and adds plus a 16-step bitwise square root, with no
+// FPU or soft-float calls.
+
+#define MOTION_COUNTS_PER_G 4096 // 14-bit counts at +/-2 g
+#define MOTION_EMA_FRAC_BITS 8   // fractional bits kept in the baseline
+#define MOTION_GRAVITY_MS2 9.80665f
+
+typedef struct
+{
+    uint8_t ema_shift;   // alpha = 2^-ema_shift
+    uint8_t decim_shift; // one output per 2^decim_shift inputs
+    bool seeded;
+    int32_t baseline;    // EMA of the magnitude, counts << MOTION_EMA_FRAC_BITS
+    int32_t decim_sum;
+    uint32_t decim_count;
+} motion_filter_t;
+
+// input_hz: sample rate fed in; output_hz: desired rate out (rounded to a
+// power-of-two decimation); tau_s: baseline time constant
+void motion_filter_init(motion_filter_t *f, uint32_t input_hz, uint32_t output_hz, float tau_s);
+
+// Feed one raw sample. Returns true and sets *out to the high-passed
+// magnitude in counts once per decimation period.
+bool motion_filter_push(motion_filter_t *f, int16_t x, int16_t y, int16_t z, int32_t *out);
+
+// Rate of the values motion_filter_push() returns, for a given input rate
+static inline float motion_filter_output_hz(const motion_filter_t *f, float input_hz)
+{
+    return input_hz / (float)(1u << f->decim_shift);
+}
+
+// Baseline (roughly gravity) in counts
+static inline int32_t motion_filter_baseline(const motion_filter_t *f)
+{
+    return f->baseline >> MOTION_EMA_FRAC_BITS;
+}
+
+// |a|^2 in counts^2; at most 3 * 8192^2, which fits comfortably in 32 bits
+static inline uint32_t motion_magnitude_sq(int16_t x, int16_t y, int16_t z)
+{
+    int32_t cx = x >> 2;
+    int32_t cy = y >> 2;
+    int32_t cz = z >> 2;
+    return (uint32_t)(cx * cx + cy * cy + cz * cz);
+}
+
+uint32_t motion_isqrt(uint32_t v);
+
+static inline float motion_filter_to_ms2(int32_t counts)
+{
+    return counts * (MOTION_GRAVITY_MS2 / MOTION_COUNTS_PER_G);
+}
+
+static inline int32_t motion_filter_from_ms2(float ms2)
+{
+    return (int32_t)(ms2 * (MOTION_COUNTS_PER_G / MOTION_GRAVITY_MS2) + 0.5f);
+}
+
+#ifdef __cplusplus
+}
+#endif
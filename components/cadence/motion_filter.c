@@ -0,0 +1,77 @@
+#include "motion_filter.h"
+
+#include <string.h>
+
+// n such that 2^n is the power of two nearest v
+static uint8_t nearest_log2(uint32_t v)
+{
+    uint8_t n = 0;
+    while (n < 16 && (1u << (n + 1)) <= v + (v >> 1))
+    {
+        n++;
+    }
+    return n;
+}
+
+void motion_filter_init(motion_filter_t *f, uint32_t input_hz, uint32_t output_hz, float tau_s)
+{
+    memset(f, 0, sizeof(*f));
+    f->ema_shift = nearest_log2((uint32_t)(tau_s * input_hz));
+
+    // Round the decimation down so the output rate never drops below output_hz
+    uint32_t ratio = output_hz > 0 ? input_hz / output_hz : 1;
+    while ((2u << f->decim_shift) <= ratio)
+    {
+        f->decim_shift++;
+    }
+}
+
+// Bitwise square root, floor(sqrt(v)): one compare/subtract per result bit
+uint32_t motion_isqrt(uint32_t v)
+{
+    uint32_t result = 0;
+    uint32_t bit = 1u << 30;
+
+    while (bit > v)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (v >= result + bit)
+        {
+            v -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else
+        {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+bool motion_filter_push(motion_filter_t *f, int16_t x, int16_t y, int16_t z, int32_t *out)
+{
+    int32_t mag = (int32_t)motion_isqrt(motion_magnitude_sq(x, y, z));
+    int32_t scaled = mag << MOTION_EMA_FRAC_BITS;
+
+    if (!f->seeded)
+    {
+        f->baseline = scaled; // start at gravity rather than ramping up from 0
+        f->seeded = true;
+    }
+    f->baseline += (scaled - f->baseline) >> f->ema_shift;
+
+    f->decim_sum += mag - (f->baseline >> MOTION_EMA_FRAC_BITS);
+    if (++f->decim_count < (1u << f->decim_shift))
+    {
+        return false;
+    }
+
+    *out = f->decim_sum >> f->decim_shift;
+    f->decim_sum = 0;
+    f->decim_count = 0;
+    return true;
+}
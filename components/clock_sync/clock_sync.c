@@ -0,0 +1,41 @@
+#include "clock_sync.h"
+
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "CLOCK_SYNC";
+
+void clock_sync_init(clock_sync_t *sync)
+{
+    memset(sync, 0, sizeof(*sync));
+}
+
+void clock_sync_add_sample(clock_sync_t *sync, int64_t send_us, int64_t recv_us, int64_t server_us)
+{
+    clock_sync_sample_t sample = {
+        .offset_us = server_us - (send_us + recv_us) / 2,
+        .rtt_us = recv_us - send_us,
+    };
+
+    sync->samples[sync->next] = sample;
+    sync->next = (sync->next + 1) % CLOCK_SYNC_WINDOW;
+    if (sync->count < CLOCK_SYNC_WINDOW)
+    {
+        sync->count++;
+    }
+
+    // Lowest round trip in the window wins
+    const clock_sync_sample_t *best = &sync->samples[0];
+    for (int i = 1; i < sync->count; i++)
+    {
+        if (sync->samples[i].rtt_us < best->rtt_us)
+        {
+            best = &sync->samples[i];
+        }
+    }
+
+    ESP_LOGD(TAG, "sample offset=%lldus rtt=%lldus, using offset change %+lldus (rtt %lldus)",
+             sample.offset_us, sample.rtt_us, best->offset_us - sync->offset_us, best->rtt_us);
+    sync->offset_us = best->offset_us;
+    sync->rtt_us = best->rtt_us;
+}
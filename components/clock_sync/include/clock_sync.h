@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lightweight estimate of the offset between esp_timer time and the
+// backend's wall clock, from the timestamps of ordinary HTTP requests.
+//
+// Each request gives one sample: the server stamps its clock while handling
+// it, and assuming it did so half way through the round trip,
+//   offset = server_us - (send_us + recv_us) / 2
+// with an error of at most rtt / 2. Of the last CLOCK_SYNC_WINDOW samples the
+// one with the smallest RTT is used, which discards requests that queued
+// behind Wi-Fi retries or needed a fresh TCP connection. The window slides,
+// so the estimate follows the drift between the two clocks.
+//
+// The LED node takes its samples from /led_state polls (server_ms), the
+// accelerometer from the X-Server-Us header of its uploads.
+
+#define CLOCK_SYNC_WINDOW 8
+
+typedef struct
+{
+    int64_t offset_us;
+    int64_t rtt_us;
+} clock_sync_sample_t;
+
+typedef struct
+{
+    clock_sync_sample_t samples[CLOCK_SYNC_WINDOW];
+    int count;
+    int next;
+    int64_t offset_us; // server time minus local time
+    int64_t rtt_us;    // round trip of the sample offset_us came from
+} clock_sync_t;
+
+void clock_sync_init(clock_sync_t *sync);
+
+// send_us / recv_us are esp_timer times around the request, server_us the
+// backend's timestamp from the response
+void clock_sync_add_sample(clock_sync_t *sync, int64_t send_us, int64_t recv_us, int64_t server_us);
+
+static inline bool clock_sync_valid(const clock_sync_t *sync)
+{
+    return sync->count > 0;
+}
+
+// Convert a backend timestamp to esp_timer time
+static inline int64_t clock_sync_to_local(const clock_sync_t *sync, int64_t server_us)
+{
+    return server_us - sync->offset_us;
+}
+
+// Convert an esp_timer time to backend time
+static inline int64_t clock_sync_to_server(const clock_sync_t *sync, int64_t local_us)
+{
+    return local_us + sync->offset_us;
+}
+
+#ifdef __cplusplus
+}
+#endif
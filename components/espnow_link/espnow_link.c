@@ -0,0 +1,233 @@
+#include "espnow_link.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "wifi_connect.h"
+
+#define PACKET_MAGIC 0x4243 // "CB"
+#define PACKET_VERSION 1
+#define NO_STEP UINT32_MAX
+#define SEQ_RESTART_GAP 1000 // a jump further than this is a sender reboot, not loss
+
+static const char *TAG = "espnow_link";
+
+static const uint8_t s_broadcast[ESP_NOW_ETH_ALEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+
+// On the air, little-endian like the uploads
+typedef struct __attribute__((packed))
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t mood;
+    uint32_t device;
+    uint32_t seq;
+    uint32_t bpm_milli;
+    uint16_t confidence_milli;
+    uint16_t reserved;
+    uint32_t step_age_us; // send time minus the last step, NO_STEP if none (or over an hour ago)
+} beat_packet_t;
+
+_Static_assert(sizeof(beat_packet_t) == 24, "beat packet layout changed");
+
+// Latest beat per sender; written by the Wi-Fi task's receive callback
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static espnow_beat_t s_senders[ESPNOW_LINK_MAX_SENDERS];
+static int s_sender_count;
+static uint32_t s_seq;
+static espnow_link_stats_t s_stats;
+
+static bool is_fresh(const espnow_beat_t *beat, int64_t now_us)
+{
+    return now_us - beat->received_us < CONFIG_ESPNOW_LINK_STALE_MS * 1000LL;
+}
+
+// Called with s_lock held. A full table gives the slot that was quiet the longest.
+static espnow_beat_t *sender_slot_locked(uint32_t device)
+{
+    espnow_beat_t *oldest = NULL;
+    for (int i = 0; i < s_sender_count; i++)
+    {
+        if (s_senders[i].device == device)
+        {
+            return &s_senders[i];
+        }
+        if (oldest == NULL || s_senders[i].received_us < oldest->received_us)
+        {
+            oldest = &s_senders[i];
+        }
+    }
+    if (s_sender_count < ESPNOW_LINK_MAX_SENDERS)
+    {
+        oldest = &s_senders[s_sender_count++];
+    }
+    memset(oldest, 0, sizeof(*oldest));
+    return oldest;
+}
+
+static void on_receive(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    int64_t now_us = esp_timer_get_time();
+    beat_packet_t packet;
+    if (len != sizeof(packet))
+    {
+        s_stats.rejected++;
+        return;
+    }
+    memcpy(&packet, data, sizeof(packet));
+    if (packet.magic != PACKET_MAGIC || packet.version != PACKET_VERSION)
+    {
+        s_stats.rejected++;
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    espnow_beat_t *beat = sender_slot_locked(packet.device);
+    uint32_t gap = packet.seq - beat->seq;
+    if (beat->received_us != 0 && gap > 1 && gap < SEQ_RESTART_GAP)
+    {
+        s_stats.lost += gap - 1;
+    }
+    beat->device = packet.device;
+    beat->seq = packet.seq;
+    beat->bpm_milli = packet.bpm_milli;
+    beat->confidence = packet.confidence_milli / 1000.0f;
+    beat->mood = (espnow_mood_t)packet.mood;
+    beat->last_step_us = packet.step_age_us == NO_STEP ? 0 : now_us - packet.step_age_us;
+    beat->received_us = now_us;
+    s_stats.received++;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+esp_err_t espnow_link_init(void)
+{
+    esp_err_t err = esp_now_init();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_now_init failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Channel 0: whatever the station is on
+    esp_now_peer_info_t peer = {0};
+    memcpy(peer.peer_addr, s_broadcast, sizeof(s_broadcast));
+    peer.channel = 0;
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    err = esp_now_add_peer(&peer);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    wifi_connect_hold_channel(true);
+    return esp_now_register_recv_cb(on_receive);
+}
+
+esp_err_t espnow_link_send(espnow_beat_t *beat)
+{
+    int64_t step_age_us = beat->last_step_us == 0 ? -1 : esp_timer_get_time() - beat->last_step_us;
+    beat->seq = ++s_seq;
+
+    beat_packet_t packet = {
+        .magic = PACKET_MAGIC,
+        .version = PACKET_VERSION,
+        .mood = (uint8_t)beat->mood,
+        .device = beat->device,
+        .seq = beat->seq,
+        .bpm_milli = beat->bpm_milli,
+        .confidence_milli = (uint16_t)(beat->confidence * 1000.0f + 0.5f),
+        .reserved = 0,
+        .step_age_us = step_age_us < 0 || step_age_us >= NO_STEP ? NO_STEP : (uint32_t)step_age_us,
+    };
+    esp_err_t err = esp_now_send(s_broadcast, (const uint8_t *)&packet, sizeof(packet));
+    if (err == ESP_OK)
+    {
+        s_stats.sent++;
+    }
+    else
+    {
+        s_stats.send_errors++;
+    }
+    return err;
+}
+
+bool espnow_link_get(uint32_t device, espnow_beat_t *out)
+{
+    int64_t now_us = esp_timer_get_time();
+    bool found = false;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < s_sender_count; i++)
+    {
+        if (s_senders[i].device == device && is_fresh(&s_senders[i], now_us))
+        {
+            *out = s_senders[i];
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return found;
+}
+
+bool espnow_link_group(espnow_beat_t *out)
+{
+    int64_t now_us = esp_timer_get_time();
+    espnow_beat_t fresh[ESPNOW_LINK_MAX_SENDERS];
+    int n = 0;
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < s_sender_count; i++)
+    {
+        if (is_fresh(&s_senders[i], now_us))
+        {
+            fresh[n++] = s_senders[i];
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (n == 0)
+    {
+        return false;
+    }
+
+    // Insertion sort by BPM; a handful of entries
+    for (int i = 1; i < n; i++)
+    {
+        espnow_beat_t key = fresh[i];
+        int j = i - 1;
+        for (; j >= 0 && fresh[j].bpm_milli > key.bpm_milli; j--)
+        {
+            fresh[j + 1] = fresh[j];
+        }
+        fresh[j + 1] = key;
+    }
+    *out = fresh[(n - 1) / 2];
+    return true;
+}
+
+espnow_mood_t espnow_link_mood_for_bpm(float bpm)
+{
+    if (bpm < 70)
+    {
+        return ESPNOW_MOOD_CALM;
+    }
+    if (bpm < 100)
+    {
+        return ESPNOW_MOOD_NEUTRAL;
+    }
+    if (bpm < 130)
+    {
+        return ESPNOW_MOOD_HAPPY;
+    }
+    if (bpm < 160)
+    {
+        return ESPNOW_MOOD_NERVOUS;
+    }
+    return ESPNOW_MOOD_ANGRY;
+}
+
+const espnow_link_stats_t *espnow_link_stats(void)
+{
+    return &s_stats;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Direct accelerometer -> LED/LCD link over ESP-NOW, next to the HTTP path.
+//
+// The accelerometer broadcasts a small beat packet after every FIFO burst:
+// its BPM, confidence, mood and how long ago its last step landed. LED and
+// LCD nodes in range pick it up a few milliseconds later, with no AP, TCP or
+// backend in between; the backend still gets the uploads and /cadence
+// reports for logging, and is what the nodes fall back to once the link has
+// been quiet for CONFIG_ESPNOW_LINK_STALE_MS.
+//
+// The step time travels as an age, not a timestamp, so the nodes need no
+// common clock: a receiver subtracts it from its own receive time, which is
+// off only by the air time.
+//
+// ESP-NOW shares the Wi-Fi channel, so every node must be on the same one.
+// Joining the same AP does that. espnow_link_init() turns on
+// wifi_connect_hold_channel(), so while the AP is down a node that has
+// joined it retries only on its channel and stays there between retries
+// instead of scanning, and the link rides out the outage. A node that never
+// joined has no channel to hold and scans as usual.
+// Receivers should keep the radio on (WIFI_PS_NONE): in modem sleep they
+// miss broadcasts.
+
+#define ESPNOW_LINK_MAX_SENDERS 8
+
+// Same values as Emotions in api_endpoint/algo.py
+typedef enum
+{
+    ESPNOW_MOOD_UNKNOWN = 0,
+    ESPNOW_MOOD_NEUTRAL = 1,
+    ESPNOW_MOOD_CALM = 2,
+    ESPNOW_MOOD_HAPPY = 3,
+    ESPNOW_MOOD_SAD = 4,
+    ESPNOW_MOOD_ANGRY = 5,
+    ESPNOW_MOOD_NERVOUS = 6,
+} espnow_mood_t;
+
+typedef struct
+{
+    uint32_t device;      // sender's device ID, as in its uploads
+    uint32_t seq;
+    uint32_t bpm_milli;
+    float confidence;
+    espnow_mood_t mood;
+    int64_t last_step_us; // esp_timer time of the sender's last step on this node's clock, 0 if none
+    int64_t received_us;  // esp_timer time it arrived; unused by espnow_link_send()
+} espnow_beat_t;
+
+typedef struct
+{
+    uint32_t sent;
+    uint32_t send_errors;
+    uint32_t received;
+    uint32_t rejected; // wrong size, magic or version
+    uint32_t lost;     // gaps in a sender's seq
+} espnow_link_stats_t;
+
+// After wifi_connect_start(): ESP-NOW runs on the started driver, and the
+// station holds its channel from here on
+esp_err_t espnow_link_init(void);
+
+// Broadcast one beat; beat->seq is filled in
+esp_err_t espnow_link_send(espnow_beat_t *beat);
+
+// Latest beat from device, if it arrived within CONFIG_ESPNOW_LINK_STALE_MS
+bool espnow_link_get(uint32_t device, espnow_beat_t *out);
+
+// Latest beat of the group: of the senders heard within the stale time, the
+// one at the median BPM (lower median for an even count), so the nodes
+// follow a typical wearer the way the backend's group tempo does
+bool espnow_link_group(espnow_beat_t *out);
+
+// classify_mood() in api_endpoint/algo.py
+espnow_mood_t espnow_link_mood_for_bpm(float bpm);
+
+const espnow_link_stats_t *espnow_link_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
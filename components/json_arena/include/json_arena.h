@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// cJSON allocations from a fixed buffer instead of the heap.
+//
+// Parsing a response makes a dozen small cJSON allocations and frees them a
+// moment later, several times a second on the LED node. Inside a
+// json_arena_begin() / json_arena_end() scope every cJSON allocation the
+// calling task makes is carved from its arena instead; cJSON_Delete() leaves
+// those alone and json_arena_end() releases them all at once. Other tasks,
+// and this one outside a scope, go to the heap as before.
+//
+// The first json_arena_init() installs the cJSON hooks. An allocation that
+// doesn't fit falls back to the heap and is counted in overflows, so an
+// undersized arena shows up in the logs rather than as a failed parse.
+
+#define JSON_ARENA_MAX 4
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t size;
+    size_t used;
+    size_t high_water; // most bytes one scope needed
+    uint32_t overflows;
+    TaskHandle_t owner; // task inside a scope, NULL outside
+} json_arena_t;
+
+// buf must outlive the arena; at most JSON_ARENA_MAX arenas
+void json_arena_init(json_arena_t *arena, void *buf, size_t size);
+
+// Scopes don't nest; a task has at most one open
+void json_arena_begin(json_arena_t *arena);
+void json_arena_end(json_arena_t *arena);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,122 @@
+#include "json_arena.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include "cJSON.h"
+#include "esp_log.h"
+
+#define ARENA_ALIGN 8 // cJSON items hold a double
+
+static const char *TAG = "JSON_ARENA";
+
+// Registered once at init and never removed. Each arena's used and owner are
+// only written by the task inside its scope, so allocations take no lock.
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static json_arena_t *s_arenas[JSON_ARENA_MAX];
+static int s_arena_count;
+
+static json_arena_t *current_arena(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < s_arena_count; i++)
+    {
+        if (s_arenas[i]->owner == self)
+        {
+            return s_arenas[i];
+        }
+    }
+    return NULL;
+}
+
+static bool in_arena(const void *ptr)
+{
+    for (int i = 0; i < s_arena_count; i++)
+    {
+        const uint8_t *buf = s_arenas[i]->buf;
+        if ((const uint8_t *)ptr >= buf && (const uint8_t *)ptr < buf + s_arenas[i]->size)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *arena_malloc(size_t size)
+{
+    json_arena_t *arena = current_arena();
+    if (arena != NULL)
+    {
+        uintptr_t base = (uintptr_t)arena->buf;
+        size_t start = ((base + arena->used + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1)) - base;
+        if (start + size <= arena->size)
+        {
+            arena->used = start + size;
+            return arena->buf + start;
+        }
+        arena->overflows++;
+    }
+    return malloc(size);
+}
+
+static void arena_free(void *ptr)
+{
+    if (!in_arena(ptr))
+    {
+        free(ptr);
+    }
+}
+
+void json_arena_init(json_arena_t *arena, void *buf, size_t size)
+{
+    arena->buf = (uint8_t *)buf;
+    arena->size = size;
+    arena->used = 0;
+    arena->high_water = 0;
+    arena->overflows = 0;
+    arena->owner = NULL;
+
+    portENTER_CRITICAL(&s_lock);
+    bool first = s_arena_count == 0;
+    bool registered = s_arena_count < JSON_ARENA_MAX;
+    if (registered)
+    {
+        s_arenas[s_arena_count++] = arena;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (!registered)
+    {
+        ESP_LOGE(TAG, "More than %d arenas, this one stays on the heap", JSON_ARENA_MAX);
+        arena->size = 0;
+    }
+    if (first)
+    {
+        cJSON_Hooks hooks = {
+            .malloc_fn = arena_malloc,
+            .free_fn = arena_free,
+        };
+        cJSON_InitHooks(&hooks);
+    }
+}
+
+void json_arena_begin(json_arena_t *arena)
+{
+    arena->used = 0;
+    arena->owner = xTaskGetCurrentTaskHandle();
+}
+
+void json_arena_end(json_arena_t *arena)
+{
+    arena->owner = NULL;
+    if (arena->used > arena->high_water)
+    {
+        arena->high_water = arena->used;
+    }
+    if (arena->overflows > 0)
+    {
+        ESP_LOGW(TAG, "%lu allocations didn't fit in %u bytes", (unsigned long)arena->overflows,
+                 (unsigned)arena->size);
+        arena->overflows = 0;
+    }
+    arena->used = 0;
+}
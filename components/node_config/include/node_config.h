@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runtime tunables kept in NVS, so changing one needs neither a reflash nor
+// a firmware update.
+//
+// A node lists its tunables in a table of node_config_param_t, each pointing
+// at the variable that holds its compiled-in default, and calls
+// node_config_load() at boot before anything reads them. The backend serves
+// the values it wants for a node as a JSON object (GET /node_config/<node>);
+// the ota_update task hands that to node_config_apply(), which stores the
+// merged result as one blob when a value differs and reports the change so
+// the node restarts. Values therefore only change at boot, and no code has
+// to cope with a tunable changing under it.
+//
+// Keys the table doesn't know and values out of range or of the wrong type
+// are logged and skipped; a key the backend leaves out keeps its value.
+
+typedef enum
+{
+    NODE_CONFIG_TYPE_INT,
+    NODE_CONFIG_TYPE_FLOAT,
+    NODE_CONFIG_TYPE_STRING,
+} node_config_type_t;
+
+typedef struct
+{
+    const char *key;         // JSON field
+    node_config_type_t type;
+    void *value;             // int *, float * or a char array
+    float min;               // numbers only
+    float max;
+    size_t size;             // strings only, sizeof the array
+} node_config_param_t;
+
+#define NODE_CONFIG_INT(key, var, min, max) {(key), NODE_CONFIG_TYPE_INT, &(var), (min), (max), 0}
+#define NODE_CONFIG_FLOAT(key, var, min, max) {(key), NODE_CONFIG_TYPE_FLOAT, &(var), (min), (max), 0}
+#define NODE_CONFIG_STRING(key, array) {(key), NODE_CONFIG_TYPE_STRING, (array), 0, 0, sizeof(array)}
+
+#define NODE_CONFIG_BLOB_MAX 512
+
+// Registers params (which must outlive the program) and applies the stored
+// blob over their defaults. Initializes NVS if nothing has yet.
+esp_err_t node_config_load(const node_config_param_t *params, size_t count);
+
+// Merges the backend's JSON into the stored config. *changed is true when a
+// value differs from the running one; the blob is then rewritten and the
+// new value takes effect at the next boot.
+esp_err_t node_config_apply(const char *json, bool *changed);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,233 @@
+#include "node_config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cJSON.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+static const char *TAG = "NODE_CONFIG";
+
+#define NVS_NAMESPACE "node_config"
+#define NVS_KEY_BLOB "config"
+#define STRING_MAX 64 // longest NODE_CONFIG_STRING array
+
+static const node_config_param_t *s_params;
+static size_t s_count;
+
+typedef union
+{
+    int i;
+    float f;
+    char s[STRING_MAX];
+} param_value_t;
+
+static esp_err_t nvs_init(void)
+{
+    esp_err_t ret = nvs_flash_init(); // a no-op if wifi_connect got there first
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    return ret;
+}
+
+static const node_config_param_t *find_param(const char *key)
+{
+    for (size_t i = 0; i < s_count; i++)
+    {
+        if (strcmp(s_params[i].key, key) == 0)
+        {
+            return &s_params[i];
+        }
+    }
+    return NULL;
+}
+
+// Type and range check of one JSON value; false leaves *out alone
+static bool parse_value(const node_config_param_t *p, const cJSON *item, param_value_t *out)
+{
+    switch (p->type)
+    {
+    case NODE_CONFIG_TYPE_INT:
+        if (!cJSON_IsNumber(item) || item->valuedouble < p->min || item->valuedouble > p->max ||
+            item->valuedouble != floor(item->valuedouble))
+        {
+            return false;
+        }
+        out->i = (int)item->valuedouble;
+        return true;
+    case NODE_CONFIG_TYPE_FLOAT:
+        if (!cJSON_IsNumber(item) || item->valuedouble < p->min || item->valuedouble > p->max)
+        {
+            return false;
+        }
+        out->f = (float)item->valuedouble;
+        return true;
+    case NODE_CONFIG_TYPE_STRING:
+        if (!cJSON_IsString(item) || strlen(item->valuestring) >= p->size || p->size > STRING_MAX)
+        {
+            return false;
+        }
+        strcpy(out->s, item->valuestring);
+        return true;
+    }
+    return false;
+}
+
+static bool equals_running(const node_config_param_t *p, const param_value_t *v)
+{
+    switch (p->type)
+    {
+    case NODE_CONFIG_TYPE_INT:
+        return *(const int *)p->value == v->i;
+    case NODE_CONFIG_TYPE_FLOAT:
+        return *(const float *)p->value == v->f;
+    case NODE_CONFIG_TYPE_STRING:
+        return strcmp((const char *)p->value, v->s) == 0;
+    }
+    return true;
+}
+
+static void set_running(const node_config_param_t *p, const param_value_t *v)
+{
+    switch (p->type)
+    {
+    case NODE_CONFIG_TYPE_INT:
+        *(int *)p->value = v->i;
+        break;
+    case NODE_CONFIG_TYPE_FLOAT:
+        *(float *)p->value = v->f;
+        break;
+    case NODE_CONFIG_TYPE_STRING:
+        strcpy((char *)p->value, v->s);
+        break;
+    }
+}
+
+// The stored blob, parsed; NULL if there is none
+static cJSON *read_blob(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return NULL;
+    }
+    char blob[NODE_CONFIG_BLOB_MAX];
+    size_t len = sizeof(blob);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_BLOB, blob, &len);
+    nvs_close(nvs);
+    return err == ESP_OK ? cJSON_ParseWithLength(blob, len) : NULL;
+}
+
+static esp_err_t write_blob(const cJSON *root)
+{
+    char *blob = cJSON_PrintUnformatted(root);
+    if (blob == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    size_t len = strlen(blob);
+    esp_err_t err = len < NODE_CONFIG_BLOB_MAX ? ESP_OK : ESP_ERR_INVALID_SIZE;
+    nvs_handle_t nvs;
+    if (err == ESP_OK)
+    {
+        err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    }
+    if (err == ESP_OK)
+    {
+        err = nvs_set_blob(nvs, NVS_KEY_BLOB, blob, len);
+        if (err == ESP_OK)
+        {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    cJSON_free(blob);
+    return err;
+}
+
+esp_err_t node_config_load(const node_config_param_t *params, size_t count)
+{
+    s_params = params;
+    s_count = count;
+    esp_err_t err = nvs_init();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    cJSON *root = read_blob();
+    for (size_t i = 0; i < count; i++)
+    {
+        const cJSON *item = cJSON_GetObjectItemCaseSensitive(root, params[i].key);
+        param_value_t v;
+        if (item == NULL)
+        {
+            continue;
+        }
+        if (parse_value(&params[i], item, &v))
+        {
+            set_running(&params[i], &v);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Stored %s is out of range, keeping the default", params[i].key);
+        }
+    }
+    if (root != NULL)
+    {
+        ESP_LOGI(TAG, "Loaded %d stored value(s)", cJSON_GetArraySize(root));
+    }
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+esp_err_t node_config_apply(const char *json, bool *changed)
+{
+    *changed = false;
+    cJSON *wanted = cJSON_Parse(json);
+    if (!cJSON_IsObject(wanted))
+    {
+        cJSON_Delete(wanted);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Merge over what is stored, so keys the backend stops sending keep their value
+    cJSON *stored = read_blob();
+    if (stored == NULL)
+    {
+        stored = cJSON_CreateObject();
+    }
+
+    const cJSON *item;
+    cJSON_ArrayForEach(item, wanted)
+    {
+        const node_config_param_t *p = find_param(item->string);
+        param_value_t v;
+        if (p == NULL || !parse_value(p, item, &v))
+        {
+            ESP_LOGW(TAG, "Ignoring %s: %s", item->string, p == NULL ? "unknown key" : "bad value");
+            continue;
+        }
+        if (!equals_running(p, &v))
+        {
+            ESP_LOGI(TAG, "%s changes at the next boot", p->key);
+            *changed = true;
+        }
+        cJSON_DeleteItemFromObjectCaseSensitive(stored, p->key);
+        cJSON_AddItemToObject(stored, p->key, cJSON_Duplicate(item, true));
+    }
+
+    esp_err_t err = *changed ? write_blob(stored) : ESP_OK;
+    if (err != ESP_OK)
+    {
+        *changed = false; // nothing would be different after a restart
+    }
+    cJSON_Delete(stored);
+    cJSON_Delete(wanted);
+    return err;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Over-the-air firmware and tunables from the backend.
+//
+// ota_update_start() runs a low-priority task that every
+// CONFIG_OTA_UPDATE_CHECK_MS asks the backend for
+//  - GET /node_config/<node>: tunables, handed to node_config_apply()
+//  - GET /firmware/<node>: {"version": ...} of the image it holds for the node
+// A tunable that changed, or an image whose version differs from the running
+// one, restarts the node; the image is first streamed from
+// /firmware/<node>/image into the idle one of the two app slots
+// (partitions.csv in each project).
+//
+// With the bootloader's rollback on, an updated image boots pending and is
+// kept only after its first successful check, which proves Wi-Fi, discovery
+// and HTTP work. If it crashes before that, or CONFIG_OTA_UPDATE_VALIDATE_S
+// pass, the previous image comes back, and a version that was rolled back is
+// not downloaded again.
+//
+// Call after wifi_connect_wait() and backend_discovery_init(). node names the
+// firmware (same names as perf_report_start()) and must outlive the task.
+
+esp_err_t ota_update_start(const char *node);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,236 @@
+#include "ota_update.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "cJSON.h"
+#include "esp_app_desc.h"
+#include "esp_http_client.h"
+#include "esp_https_ota.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "backend_discovery.h"
+#include "json_arena.h"
+#include "node_config.h"
+#include "task_placement.h"
+
+static const char *TAG = "OTA_UPDATE";
+
+#define URL_MAX 96
+#define REQUEST_PATH_MAX 48
+#define BODY_MAX NODE_CONFIG_BLOB_MAX
+#define JSON_ARENA_SIZE 2048 // parsing and re-printing a full config blob
+#define TASK_STACK_SIZE 6144
+
+static char s_body[BODY_MAX];
+static int s_body_len;
+static esp_http_client_handle_t s_client; // kept open between checks
+static json_arena_t s_json;
+static uint8_t s_json_buf[JSON_ARENA_SIZE];
+static StackType_t s_task_stack[TASK_STACK_SIZE];
+static StaticTask_t s_task_tcb;
+static bool s_pending_verify; // running image is fresh from an update and not yet confirmed
+static esp_timer_handle_t s_validate_timer;
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_DATA && s_body_len + evt->data_len < BODY_MAX)
+    {
+        memcpy(s_body + s_body_len, evt->data, evt->data_len);
+        s_body_len += evt->data_len;
+        s_body[s_body_len] = '\0';
+    }
+    return ESP_OK;
+}
+
+// GET path into s_body; returns the HTTP status, or -1 if the request failed
+static int http_get(const char *path)
+{
+    char url[URL_MAX];
+    if (backend_discovery_url(path, url, sizeof(url)) < 0)
+    {
+        return -1;
+    }
+    if (s_client == NULL)
+    {
+        esp_http_client_config_t config = {
+            .url = url,
+            .method = HTTP_METHOD_GET,
+            .timeout_ms = 5000,
+            .event_handler = http_event_handler,
+            .keep_alive_enable = true,
+        };
+        s_client = esp_http_client_init(&config);
+    }
+    else
+    {
+        esp_http_client_set_url(s_client, url);
+    }
+    s_body_len = 0;
+    s_body[0] = '\0';
+    esp_err_t err = esp_http_client_perform(s_client);
+    int status = err == ESP_OK ? esp_http_client_get_status_code(s_client) : -1;
+    if (err != ESP_OK)
+    {
+        esp_http_client_close(s_client); // reconnect on the next check
+        backend_discovery_invalidate();
+    }
+    return status;
+}
+
+static void validate_timeout_cb(void *arg)
+{
+    ESP_LOGE(TAG, "Updated image never reached the backend, rolling back");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+static void confirm_image(void)
+{
+    if (!s_pending_verify)
+    {
+        return;
+    }
+    s_pending_verify = false;
+    esp_timer_stop(s_validate_timer);
+    ESP_ERROR_CHECK(esp_ota_mark_app_valid_cancel_rollback());
+    ESP_LOGI(TAG, "Image %s confirmed", esp_app_get_description()->version);
+}
+
+// Whether version is what the bootloader last rolled back from
+static bool was_rolled_back(const char *version)
+{
+    const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+    esp_app_desc_t desc;
+    return invalid != NULL && esp_ota_get_partition_description(invalid, &desc) == ESP_OK &&
+           strncmp(desc.version, version, sizeof(desc.version)) == 0;
+}
+
+static void install_image(const char *node, const char *version)
+{
+    char path[REQUEST_PATH_MAX];
+    char url[URL_MAX];
+    snprintf(path, sizeof(path), "/firmware/%s/image", node);
+    if (backend_discovery_url(path, url, sizeof(url)) < 0)
+    {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Updating %s -> %s from %s", esp_app_get_description()->version, version, url);
+    esp_http_client_config_t http_config = {
+        .url = url,
+        .timeout_ms = 10000,
+        .keep_alive_enable = true,
+    };
+    esp_https_ota_config_t ota_config = {
+        .http_config = &http_config,
+    };
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_https_ota(&ota_config);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Update failed: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "Image written in %lld ms, restarting", (esp_timer_get_time() - start_us) / 1000);
+    esp_restart();
+}
+
+static void check_config(const char *node)
+{
+    char path[REQUEST_PATH_MAX];
+    snprintf(path, sizeof(path), "/node_config/%s", node);
+    if (http_get(path) != 200)
+    {
+        return;
+    }
+    bool changed = false;
+    esp_err_t err = node_config_apply(s_body, &changed);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Config not applied: %s", esp_err_to_name(err));
+    }
+    else if (changed)
+    {
+        ESP_LOGI(TAG, "Config changed, restarting");
+        esp_restart();
+    }
+}
+
+// Returns false if the backend couldn't be asked
+static bool check_firmware(const char *node)
+{
+    char path[REQUEST_PATH_MAX];
+    snprintf(path, sizeof(path), "/firmware/%s", node);
+    int status = http_get(path);
+    if (status == 404)
+    {
+        return true; // reachable, just nothing to offer
+    }
+    if (status != 200)
+    {
+        return false;
+    }
+
+    cJSON *root = cJSON_Parse(s_body);
+    const char *version = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(root, "version"));
+    const char *running = esp_app_get_description()->version;
+    bool update = version != NULL && strncmp(version, running, sizeof(esp_app_get_description()->version)) != 0;
+    if (update && was_rolled_back(version))
+    {
+        ESP_LOGW(TAG, "Not installing %s again, it was rolled back", version);
+        update = false;
+    }
+    if (update)
+    {
+        confirm_image(); // the running image got this far, so it is a safe fallback
+        install_image(node, version);
+    }
+    cJSON_Delete(root);
+    return true;
+}
+
+static void update_task(void *arg)
+{
+    const char *node = (const char *)arg;
+
+    json_arena_init(&s_json, s_json_buf, sizeof(s_json_buf));
+
+    while (1)
+    {
+        json_arena_begin(&s_json);
+        check_config(node);
+        bool reachable = check_firmware(node);
+        json_arena_end(&s_json);
+        if (reachable)
+        {
+            confirm_image();
+        }
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_OTA_UPDATE_CHECK_MS));
+    }
+}
+
+esp_err_t ota_update_start(const char *node)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY)
+    {
+        s_pending_verify = true;
+        esp_timer_create_args_t timer_args = {
+            .callback = validate_timeout_cb,
+            .name = "ota_validate",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_validate_timer));
+        ESP_ERROR_CHECK(esp_timer_start_once(s_validate_timer, CONFIG_OTA_UPDATE_VALIDATE_S * 1000000ULL));
+        ESP_LOGI(TAG, "Running updated image %s from %s, pending verification",
+                 esp_app_get_description()->version, running->label);
+    }
+
+    xTaskCreateStaticPinnedToCore(update_task, "ota_update", TASK_STACK_SIZE, (void *)node, TASK_PRIO_BACKGROUND,
+                                  s_task_stack, &s_task_tcb, TASK_CORE_NETWORK);
+    return ESP_OK;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lightweight field instrumentation shared by the node firmwares.
+//
+// A perf_timer_t times a code section with the CPU cycle counter (a register
+// read at each end) and keeps min / max / mean plus a log-linear histogram
+// for percentiles: four buckets per power of two of microseconds, so p99 is
+// reported to within 25 % from 1 us to 30 s in 96 buckets. A perf_counter_t
+// counts events. Both are statics that register themselves on first use.
+//
+//     PERF_TIMER(http_timer, "http_post");
+//     PERF_SCOPE(http_timer) { esp_http_client_perform(client); }
+//
+// perf_report_start() posts a window of everything recorded, plus the stack
+// high-water marks of watched tasks and the heap's free space, to the
+// backend's /telemetry every CONFIG_PERF_COUNTERS_REPORT_MS and then clears
+// the window.
+//
+// Records take a spinlock, so timers can be shared between tasks (not ISRs).
+// The cycle counter is per core: on the dual-core ESP32-S3 a task that
+// migrates cores mid-section gives one bad sample, which only the max shows.
+// It also wraps after ~15 s at 240 MHz. With power management on, the CPU
+// clock changes and stops in light sleep, so timers use esp_timer instead.
+
+#define PERF_BUCKETS 96
+#define PERF_MAX_METRICS 24
+#define PERF_MAX_TASKS 8
+
+typedef struct
+{
+    const char *name;
+    bool registered;
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[PERF_BUCKETS];
+} perf_timer_t;
+
+typedef struct
+{
+    const char *name;
+    bool registered;
+    uint32_t value;
+} perf_counter_t;
+
+#define PERF_TIMER(var, label) static perf_timer_t var __attribute__((unused)) = {.name = (label)}
+#define PERF_COUNTER(var, label) static perf_counter_t var __attribute__((unused)) = {.name = (label)}
+
+#if CONFIG_PERF_COUNTERS_ENABLE
+
+// Start of a section: CPU cycles, or esp_timer microseconds with power management
+static inline uint32_t perf_begin(void)
+{
+#if CONFIG_PM_ENABLE
+    return (uint32_t)esp_timer_get_time();
+#else
+    return esp_cpu_get_cycle_count();
+#endif
+}
+
+// Record the section that perf_begin() returned start for
+void perf_end(perf_timer_t *timer, uint32_t start);
+
+// Record a duration measured some other way
+void perf_record_us(perf_timer_t *timer, uint32_t us);
+
+void perf_count(perf_counter_t *counter, uint32_t n);
+
+// Times the statement or block that follows. Don't break out of it.
+#define PERF_SCOPE(timer) \
+    for (uint32_t _perf_start = perf_begin(), _perf_once = 1; _perf_once; _perf_once = 0, perf_end(&(timer), _perf_start))
+
+#else
+
+static inline uint32_t perf_begin(void) { return 0; }
+static inline void perf_end(perf_timer_t *timer, uint32_t start) {}
+static inline void perf_record_us(perf_timer_t *timer, uint32_t us) {}
+static inline void perf_count(perf_counter_t *counter, uint32_t n) {}
+#define PERF_SCOPE(timer)
+
+#endif
+
+// Report the stack high-water mark of a task (NULL: the calling task)
+void perf_watch_task(TaskHandle_t task);
+
+// Approximate percentile (0-100) of a timer's window, in microseconds
+uint32_t perf_timer_percentile(const perf_timer_t *timer, uint32_t percent);
+
+// JSON for the current window: {"node", "uptime_ms", "timers": {name: {"n",
+// "min_us", "avg_us", "p50_us", "p99_us", "max_us"}}, "counters": {name: n},
+// "stacks": {task: free_bytes}, "heap": {"free", "min_free", "largest_block"}}.
+// Returns the length, or -1 if it didn't fit.
+// With reset, the window is cleared once copied.
+int perf_report_json(const char *node, char *buf, size_t len, bool reset);
+
+// Start a low-priority task posting the report as node every
+// CONFIG_PERF_COUNTERS_REPORT_MS. Call after backend_discovery_init().
+esp_err_t perf_report_start(const char *node);
+
+#ifdef __cplusplus
+}
+#endif
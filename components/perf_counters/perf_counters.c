@@ -0,0 +1,280 @@
+#include "perf_counters.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_system.h"
+#include "backend_discovery.h"
+#include "task_placement.h"
+
+#define REPORT_PATH "/telemetry"
+#define REPORT_MAX 2048
+#define URL_MAX 64
+#define REPORT_STACK_SIZE 3072
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static perf_timer_t *s_timers[PERF_MAX_METRICS];
+static int s_timer_count;
+static perf_counter_t *s_counters[PERF_MAX_METRICS];
+static int s_counter_count;
+static TaskHandle_t s_tasks[PERF_MAX_TASKS];
+static int s_task_count;
+
+// Largest value that lands in a bucket
+static uint32_t bucket_upper_us(int index)
+{
+    if (index < 4)
+    {
+        return index;
+    }
+    int e = index / 4 + 1;
+    uint32_t width = 1u << (e - 2);
+    return (uint32_t)(4 + index % 4) * width + width - 1;
+}
+
+#if CONFIG_PERF_COUNTERS_ENABLE
+// Bucket i < 4 holds i us. Above that, each power of two [2^e, 2^(e+1)) is
+// split into four equal buckets starting at 4 * (e - 1).
+static int bucket_of(uint32_t us)
+{
+    if (us < 4)
+    {
+        return us;
+    }
+    int e = 31 - __builtin_clz(us);
+    int index = 4 * (e - 1) + ((us >> (e - 2)) & 3);
+    return index < PERF_BUCKETS ? index : PERF_BUCKETS - 1;
+}
+
+// Called with s_lock held
+static void record_locked(perf_timer_t *timer, uint32_t us)
+{
+    if (!timer->registered && s_timer_count < PERF_MAX_METRICS)
+    {
+        timer->registered = true;
+        timer->min_us = UINT32_MAX;
+        s_timers[s_timer_count++] = timer;
+    }
+    timer->count++;
+    timer->total_us += us;
+    if (us < timer->min_us)
+    {
+        timer->min_us = us;
+    }
+    if (us > timer->max_us)
+    {
+        timer->max_us = us;
+    }
+    timer->buckets[bucket_of(us)]++;
+}
+
+void perf_record_us(perf_timer_t *timer, uint32_t us)
+{
+    portENTER_CRITICAL(&s_lock);
+    record_locked(timer, us);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void perf_end(perf_timer_t *timer, uint32_t start)
+{
+#if CONFIG_PM_ENABLE
+    uint32_t us = (uint32_t)esp_timer_get_time() - start;
+#else
+    uint32_t us = (esp_cpu_get_cycle_count() - start) / esp_rom_get_cpu_ticks_per_us();
+#endif
+    perf_record_us(timer, us);
+}
+
+void perf_count(perf_counter_t *counter, uint32_t n)
+{
+    portENTER_CRITICAL(&s_lock);
+    if (!counter->registered && s_counter_count < PERF_MAX_METRICS)
+    {
+        counter->registered = true;
+        s_counters[s_counter_count++] = counter;
+    }
+    counter->value += n;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+#endif
+
+void perf_watch_task(TaskHandle_t task)
+{
+    if (task == NULL)
+    {
+        task = xTaskGetCurrentTaskHandle();
+    }
+    portENTER_CRITICAL(&s_lock);
+    if (s_task_count < PERF_MAX_TASKS)
+    {
+        s_tasks[s_task_count++] = task;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t perf_timer_percentile(const perf_timer_t *timer, uint32_t percent)
+{
+    if (timer->count == 0)
+    {
+        return 0;
+    }
+    // The rank'th smallest sample, rounded up so p100 is the largest
+    uint32_t rank = (uint32_t)(((uint64_t)timer->count * percent + 99) / 100);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+    uint32_t seen = 0;
+    for (int i = 0; i < PERF_BUCKETS; i++)
+    {
+        seen += timer->buckets[i];
+        if (seen >= rank)
+        {
+            uint32_t upper = bucket_upper_us(i);
+            return upper < timer->max_us ? upper : timer->max_us;
+        }
+    }
+    return timer->max_us;
+}
+
+// snprintf into buf at *pos; false once it no longer fits
+static bool append(char *buf, size_t len, size_t *pos, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + *pos, len - *pos, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= len - *pos)
+    {
+        return false;
+    }
+    *pos += n;
+    return true;
+}
+
+int perf_report_json(const char *node, char *buf, size_t len, bool reset)
+{
+    size_t pos = 0;
+    bool ok = append(buf, len, &pos, "{\"node\":\"%s\",\"uptime_ms\":%lld,\"timers\":{", node,
+                     esp_timer_get_time() / 1000);
+
+    for (int i = 0; ok && i < s_timer_count; i++)
+    {
+        // Copy one timer at a time so the lock is only held for a memcpy
+        perf_timer_t t;
+        portENTER_CRITICAL(&s_lock);
+        t = *s_timers[i];
+        if (reset)
+        {
+            perf_timer_t *live = s_timers[i];
+            live->count = 0;
+            live->total_us = 0;
+            live->min_us = UINT32_MAX;
+            live->max_us = 0;
+            memset(live->buckets, 0, sizeof(live->buckets));
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        ok = append(buf, len, &pos, "%s\"%s\":{\"n\":%lu,\"min_us\":%lu,\"avg_us\":%lu,\"p50_us\":%lu,"
+                                    "\"p99_us\":%lu,\"max_us\":%lu}",
+                    i ? "," : "", t.name, (unsigned long)t.count, (unsigned long)(t.count ? t.min_us : 0),
+                    (unsigned long)(t.count ? t.total_us / t.count : 0),
+                    (unsigned long)perf_timer_percentile(&t, 50), (unsigned long)perf_timer_percentile(&t, 99),
+                    (unsigned long)t.max_us);
+    }
+
+    ok = ok && append(buf, len, &pos, "},\"counters\":{");
+    for (int i = 0; ok && i < s_counter_count; i++)
+    {
+        portENTER_CRITICAL(&s_lock);
+        uint32_t value = s_counters[i]->value;
+        if (reset)
+        {
+            s_counters[i]->value = 0;
+        }
+        portEXIT_CRITICAL(&s_lock);
+        ok = append(buf, len, &pos, "%s\"%s\":%lu", i ? "," : "", s_counters[i]->name, (unsigned long)value);
+    }
+
+    // Free stack in bytes (ESP-IDF counts stack in bytes, not words)
+    ok = ok && append(buf, len, &pos, "},\"stacks\":{");
+    for (int i = 0; ok && i < s_task_count; i++)
+    {
+        ok = append(buf, len, &pos, "%s\"%s\":%u", i ? "," : "", pcTaskGetName(s_tasks[i]),
+                    (unsigned)uxTaskGetStackHighWaterMark(s_tasks[i]));
+    }
+
+    // Flat free and minimum free mean no steady-state allocation; a shrinking
+    // largest block with free flat means fragmentation
+    ok = ok && append(buf, len, &pos, "},\"heap\":{\"free\":%u,\"min_free\":%u,\"largest_block\":%u}}",
+                      (unsigned)esp_get_free_heap_size(), (unsigned)esp_get_minimum_free_heap_size(),
+                      (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    return ok ? (int)pos : -1;
+}
+
+#if CONFIG_PERF_COUNTERS_ENABLE
+static const char *TAG = "PERF";
+static char s_report[REPORT_MAX];
+static StackType_t s_report_stack[REPORT_STACK_SIZE];
+static StaticTask_t s_report_tcb;
+
+static void report_task(void *arg)
+{
+    const char *node = (const char *)arg;
+    perf_watch_task(NULL);
+
+    // Kept open between reports, re-pointed if the backend moves
+    char url[URL_MAX];
+    backend_discovery_url(REPORT_PATH, url, sizeof(url));
+    uint32_t generation = backend_discovery_generation();
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = 2000,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(CONFIG_PERF_COUNTERS_REPORT_MS));
+
+        int len = perf_report_json(node, s_report, sizeof(s_report), true);
+        if (len < 0)
+        {
+            ESP_LOGW(TAG, "Report larger than %d bytes, dropped", REPORT_MAX);
+            continue;
+        }
+
+        backend_discovery_url(REPORT_PATH, url, sizeof(url));
+        if (backend_discovery_generation() != generation)
+        {
+            generation = backend_discovery_generation();
+            esp_http_client_set_url(client, url);
+        }
+        esp_http_client_set_post_field(client, s_report, len);
+        esp_err_t err = esp_http_client_perform(client);
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Telemetry post failed: %s", esp_err_to_name(err));
+            esp_http_client_close(client); // reconnect on the next report
+            backend_discovery_invalidate();
+        }
+    }
+}
+#endif
+
+esp_err_t perf_report_start(const char *node)
+{
+#if CONFIG_PERF_COUNTERS_ENABLE
+    xTaskCreateStaticPinnedToCore(report_task, "perf_report", REPORT_STACK_SIZE, (void *)node, TASK_PRIO_BACKGROUND,
+                                  s_report_stack, &s_report_tcb, TASK_CORE_NETWORK);
+#endif
+    return ESP_OK;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "sdkconfig.h"
+
+// Where the node firmwares run their tasks.
+//
+// Real-time work, sampling and rendering, runs pinned on TASK_CORE_REALTIME
+// above everything else the app does. Networking (HTTP, JSON, ESP-NOW
+// polling) and background reporting run on TASK_CORE_NETWORK, core 0, next
+// to the Wi-Fi, lwIP and esp_timer tasks. On dual-core chips that keeps
+// frame and sample timing independent of network load; on single-core chips
+// both are core 0 and only the priorities separate them.
+//
+// Interrupts are serviced on the core that allocated them, so drivers whose
+// ISR timing matters (RMT refills without DMA) are best set up from a task
+// already on TASK_CORE_REALTIME.
+
+#if CONFIG_FREERTOS_NUMBER_OF_CORES > 1
+#define TASK_CORE_REALTIME CONFIG_TASK_PLACEMENT_REALTIME_CORE
+#else
+#define TASK_CORE_REALTIME 0
+#endif
+#define TASK_CORE_NETWORK 0
+
+#define TASK_PRIO_REALTIME CONFIG_TASK_PLACEMENT_REALTIME_PRIORITY
+#define TASK_PRIO_NETWORK CONFIG_TASK_PLACEMENT_NETWORK_PRIORITY
+#define TASK_PRIO_BACKGROUND CONFIG_TASK_PLACEMENT_BACKGROUND_PRIORITY
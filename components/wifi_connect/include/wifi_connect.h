@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Station-mode Wi-Fi shared by the node firmwares.
+//
+// wifi_connect_start() brings up NVS, netif, the default event loop and the
+// driver and returns at once; wifi_connect_wait() blocks on the
+// IP_EVENT_STA_GOT_IP event group bit instead of polling for an address.
+//
+// The BSSID and channel of the last AP that gave us an IP are kept in NVS.
+// On boot they are handed to the driver, which then skips the all-channel
+// scan and associates straight away. If that AP is gone the cache is dropped
+// after a couple of failures and the next attempt scans normally.
+//
+// A dropped connection is retried from an esp_timer with exponential backoff
+// (CONFIG_WIFI_CONNECT_BACKOFF_MIN_MS doubling to ..._MAX_MS), so a node
+// rides out an AP reboot instead of going silent.
+//
+// With wifi_connect_hold_channel(true) a node that has joined once never
+// scans again: the cache is kept however often the AP fails to answer, every
+// retry goes to that AP on its channel, and the radio is put back on that
+// channel between retries. An AP that comes back on another channel is then
+// only found after a reboot.
+
+typedef struct
+{
+    const char *ssid;         // NULL: CONFIG_WIFI_CONNECT_SSID
+    const char *password;     // NULL: CONFIG_WIFI_CONNECT_PASSWORD
+    wifi_ps_type_t power_save; // WIFI_PS_MIN_MODEM is the driver default
+    uint16_t listen_interval;  // beacons between wake-ups under WIFI_PS_MAX_MODEM, 0 = default
+} wifi_connect_config_t;
+
+#define WIFI_CONNECT_CONFIG_DEFAULT() {NULL, NULL, WIFI_PS_MIN_MODEM, 0}
+
+typedef struct
+{
+    uint32_t connects;       // times an IP was obtained
+    uint32_t disconnects;
+    uint32_t fast_connects;  // connects that used the cached BSSID/channel
+    int64_t last_connect_us; // wifi_connect_start() to IP for the latest connect
+} wifi_connect_stats_t;
+
+esp_err_t wifi_connect_start(const wifi_connect_config_t *config);
+
+// Wait until the station has an IP; ESP_ERR_TIMEOUT if it doesn't in time
+esp_err_t wifi_connect_wait(TickType_t timeout);
+
+bool wifi_connect_is_connected(void);
+esp_netif_t *wifi_connect_netif(void);
+const wifi_connect_stats_t *wifi_connect_stats(void);
+
+// Stay on the channel of the last joined AP through outages (for ESP-NOW)
+void wifi_connect_hold_channel(bool hold);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,256 @@
+#include "wifi_connect.h"
+
+#include <string.h>
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/event_groups.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+static const char *TAG = "WIFI_CONNECT";
+
+#define CONNECTED_BIT BIT0
+#define NVS_NAMESPACE "wifi_connect"
+#define NVS_KEY_AP "ap"
+#define CACHE_MAX_FAILURES 2 // failed attempts on the cached AP before scanning again
+
+// Last AP that gave us an IP
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+} cached_ap_t;
+
+static EventGroupHandle_t s_events;
+static StaticEventGroup_t s_events_buf;
+static esp_netif_t *s_netif;
+static esp_timer_handle_t s_retry_timer;
+static wifi_config_t s_wifi_config;
+static wifi_connect_stats_t s_stats;
+
+static cached_ap_t s_cached;
+static bool s_using_cache;
+static int s_cache_failures;
+static cached_ap_t s_joined; // AP of the current association
+static bool s_hold_channel; // wifi_connect_hold_channel()
+static uint32_t s_backoff_ms;
+static int64_t s_attempt_start_us;
+
+static esp_err_t nvs_init(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    return ret;
+}
+
+static bool load_cached_ap(cached_ap_t *ap)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return false;
+    }
+    size_t len = sizeof(*ap);
+    esp_err_t err = nvs_get_blob(nvs, NVS_KEY_AP, ap, &len);
+    nvs_close(nvs);
+    return err == ESP_OK && len == sizeof(*ap) && ap->channel != 0;
+}
+
+static void store_cached_ap(const cached_ap_t *ap)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK)
+    {
+        return;
+    }
+    if (ap != NULL)
+    {
+        nvs_set_blob(nvs, NVS_KEY_AP, ap, sizeof(*ap));
+    }
+    else
+    {
+        nvs_erase_key(nvs, NVS_KEY_AP);
+    }
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void retry_timer_cb(void *arg)
+{
+    s_attempt_start_us = esp_timer_get_time();
+    esp_wifi_connect();
+}
+
+static void schedule_retry(void)
+{
+    ESP_LOGW(TAG, "Disconnected, retrying in %lu ms", (unsigned long)s_backoff_ms);
+    esp_timer_stop(s_retry_timer); // not running is fine
+    esp_timer_start_once(s_retry_timer, (uint64_t)s_backoff_ms * 1000);
+
+    s_backoff_ms *= 2;
+    if (s_backoff_ms > CONFIG_WIFI_CONNECT_BACKOFF_MAX_MS)
+    {
+        s_backoff_ms = CONFIG_WIFI_CONNECT_BACKOFF_MAX_MS;
+    }
+}
+
+// The cached AP didn't answer: forget it and let the driver scan
+static void drop_cache(void)
+{
+    ESP_LOGW(TAG, "Cached AP unreachable, falling back to a full scan");
+    s_using_cache = false;
+    s_wifi_config.sta.bssid_set = false;
+    s_wifi_config.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+    store_cached_ap(NULL);
+}
+
+// Retry only the AP we last joined, and park the radio on its channel while
+// waiting out the backoff, so ESP-NOW peers there keep hearing us
+static void hold_joined_channel(void)
+{
+    if (!s_wifi_config.sta.bssid_set || s_wifi_config.sta.channel != s_joined.channel ||
+        memcmp(s_wifi_config.sta.bssid, s_joined.bssid, sizeof(s_joined.bssid)) != 0)
+    {
+        ESP_LOGI(TAG, "Holding channel %u until the AP is back", s_joined.channel);
+        s_wifi_config.sta.bssid_set = true;
+        memcpy(s_wifi_config.sta.bssid, s_joined.bssid, sizeof(s_joined.bssid));
+        s_wifi_config.sta.channel = s_joined.channel;
+        esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+    }
+    esp_wifi_set_channel(s_joined.channel, WIFI_SECOND_CHAN_NONE);
+}
+
+static void event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START)
+    {
+        s_attempt_start_us = esp_timer_get_time();
+        esp_wifi_connect();
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_CONNECTED)
+    {
+        const wifi_event_sta_connected_t *event = (const wifi_event_sta_connected_t *)data;
+        memcpy(s_joined.bssid, event->bssid, sizeof(s_joined.bssid));
+        s_joined.channel = event->channel;
+    }
+    else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED)
+    {
+        const wifi_event_sta_disconnected_t *event = (const wifi_event_sta_disconnected_t *)data;
+        bool was_connected = xEventGroupGetBits(s_events) & CONNECTED_BIT;
+        xEventGroupClearBits(s_events, CONNECTED_BIT);
+        if (was_connected)
+        {
+            s_stats.disconnects++;
+        }
+        ESP_LOGW(TAG, "Disconnected (reason %d)", event->reason);
+
+        if (s_hold_channel && s_joined.channel != 0)
+        {
+            hold_joined_channel();
+        }
+        else if (s_using_cache && !was_connected && ++s_cache_failures >= CACHE_MAX_FAILURES)
+        {
+            drop_cache();
+        }
+        schedule_retry();
+    }
+    else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP)
+    {
+        const ip_event_got_ip_t *event = (const ip_event_got_ip_t *)data;
+        s_stats.connects++;
+        s_stats.last_connect_us = esp_timer_get_time() - s_attempt_start_us;
+        if (s_using_cache)
+        {
+            s_stats.fast_connects++;
+        }
+        ESP_LOGI(TAG, "Got IP " IPSTR " on channel %u in %lld ms%s", IP2STR(&event->ip_info.ip),
+                 s_joined.channel, s_stats.last_connect_us / 1000, s_using_cache ? " (cached AP)" : "");
+
+        s_backoff_ms = CONFIG_WIFI_CONNECT_BACKOFF_MIN_MS;
+        s_cache_failures = 0;
+        if (memcmp(&s_joined, &s_cached, sizeof(s_joined)) != 0)
+        {
+            s_cached = s_joined;
+            store_cached_ap(&s_cached); // flash write only when the AP changes
+        }
+        xEventGroupSetBits(s_events, CONNECTED_BIT);
+    }
+}
+
+esp_err_t wifi_connect_start(const wifi_connect_config_t *config)
+{
+    ESP_ERROR_CHECK(nvs_init());
+    ESP_ERROR_CHECK(esp_netif_init());
+    esp_err_t err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) // already created is fine
+    {
+        return err;
+    }
+
+    s_events = xEventGroupCreateStatic(&s_events_buf);
+    esp_timer_create_args_t timer_args = {};
+    timer_args.callback = retry_timer_cb;
+    timer_args.name = "wifi_retry";
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_retry_timer));
+    s_backoff_ms = CONFIG_WIFI_CONNECT_BACKOFF_MIN_MS;
+
+    s_netif = esp_netif_create_default_wifi_sta();
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, event_handler, NULL));
+
+    const char *ssid = config->ssid != NULL ? config->ssid : CONFIG_WIFI_CONNECT_SSID;
+    const char *password = config->password != NULL ? config->password : CONFIG_WIFI_CONNECT_PASSWORD;
+    memset(&s_wifi_config, 0, sizeof(s_wifi_config));
+    strncpy((char *)s_wifi_config.sta.ssid, ssid, sizeof(s_wifi_config.sta.ssid));
+    strncpy((char *)s_wifi_config.sta.password, password, sizeof(s_wifi_config.sta.password));
+    s_wifi_config.sta.listen_interval = config->listen_interval;
+
+    s_using_cache = load_cached_ap(&s_cached);
+    if (s_using_cache)
+    {
+        // Known AP: one channel, no scan
+        s_wifi_config.sta.bssid_set = true;
+        memcpy(s_wifi_config.sta.bssid, s_cached.bssid, sizeof(s_cached.bssid));
+        s_wifi_config.sta.channel = s_cached.channel;
+        ESP_LOGI(TAG, "Using cached AP on channel %u", s_cached.channel);
+    }
+
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_start()); // connects from WIFI_EVENT_STA_START
+    return esp_wifi_set_ps(config->power_save);
+}
+
+esp_err_t wifi_connect_wait(TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(s_events, CONNECTED_BIT, pdFALSE, pdTRUE, timeout);
+    return (bits & CONNECTED_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+bool wifi_connect_is_connected(void)
+{
+    return s_events != NULL && (xEventGroupGetBits(s_events) & CONNECTED_BIT);
+}
+
+esp_netif_t *wifi_connect_netif(void)
+{
+    return s_netif;
+}
+
+const wifi_connect_stats_t *wifi_connect_stats(void)
+{
+    return &s_stats;
+}
+
+void wifi_connect_hold_channel(bool hold)
+{
+    s_hold_channel = hold;
+}
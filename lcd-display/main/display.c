@@ -0,0 +1,128 @@
+#include "display.h"
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "lcd.h"
+#include "lcd_glyphs.h"
+#include "perf_counters.h"
+
+static const char *TAG = "DISPLAY";
+
+#define DISPLAY_STACK_SIZE 3072
+
+static QueueHandle_t s_latest; // length 1, written with xQueueOverwrite
+static StaticQueue_t s_latest_queue;
+static uint8_t s_latest_storage[sizeof(display_update_t)];
+static StackType_t s_display_stack[DISPLAY_STACK_SIZE];
+static StaticTask_t s_display_tcb;
+
+PERF_TIMER(flush_timer, "lcd_flush");
+
+static const char *const s_mood_names[DISPLAY_MOOD_COUNT] = {
+    "Waiting", "Neutral", "Calm", "Happy", "Sad", "Angry", "Nervous",
+};
+
+const char *display_mood_name(display_mood_t mood) {
+    if (mood < 0 || mood >= DISPLAY_MOOD_COUNT) {
+        mood = DISPLAY_MOOD_UNKNOWN;
+    }
+    return s_mood_names[mood];
+}
+
+void display_post(const display_update_t *update) {
+    xQueueOverwrite(s_latest, update);
+}
+
+// Bar graph: cells BAR_COL..15 of line 2, 5 pixel columns per cell
+#define BAR_COL 8
+#define BAR_CELLS (LCD_COLS - BAR_COL)
+#define BAR_LEVELS (BAR_CELLS * 5)
+#define BAR_MIN_BPM 40
+#define BAR_MAX_BPM 180
+#define FRAME_MS 40
+#define LCD_FULL_BLOCK '\xFF' // in the HD44780 A00 character ROM
+
+// 1-4 pixel columns filled from the left
+static const lcd_glyph_t s_bar_glyphs[4] = {
+    {{0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10}},
+    {{0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18}},
+    {{0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C}},
+    {{0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E}},
+};
+
+static int bar_level(int bpm) {
+    if (bpm <= BAR_MIN_BPM) {
+        return 0;
+    }
+    if (bpm >= BAR_MAX_BPM) {
+        return BAR_LEVELS;
+    }
+    return (bpm - BAR_MIN_BPM) * BAR_LEVELS / (BAR_MAX_BPM - BAR_MIN_BPM);
+}
+
+static void draw_bar(int level) {
+    char cells[BAR_CELLS + 1];
+    for (int i = 0; i < BAR_CELLS; i++) {
+        int filled = level - i * 5;
+        if (filled >= 5) {
+            cells[i] = LCD_FULL_BLOCK;
+        } else if (filled > 0) {
+            cells[i] = LCD_GLYPH_CHAR(filled - 1);
+        } else {
+            cells[i] = ' ';
+        }
+    }
+    cells[BAR_CELLS] = '\0';
+    lcd_write_at(1, BAR_COL, cells);
+}
+
+static void display_task(void *arg) {
+    display_update_t shown = {.bpm = -1, .mood = DISPLAY_MOOD_UNKNOWN};
+    int level = 0;
+    int target = 0;
+    perf_watch_task(NULL);
+
+    // Uploaded once; every later frame only rewrites the DDRAM cells that moved
+    lcd_glyphs_load(0, s_bar_glyphs, 4);
+    lcd_write_line(0, "Tempo --- BPM");
+    lcd_write_line(1, display_mood_name(DISPLAY_MOOD_UNKNOWN));
+    lcd_flush();
+
+    while (1) {
+        // Wait for news, or just the next frame while the bar is moving
+        display_update_t update;
+        TickType_t wait = level != target ? pdMS_TO_TICKS(FRAME_MS) : portMAX_DELAY;
+        if (xQueueReceive(s_latest, &update, wait) == pdTRUE &&
+            (update.bpm != shown.bpm || update.mood != shown.mood)) {
+            char line[LCD_COLS + 1];
+            snprintf(line, sizeof(line), "Tempo %3d BPM", update.bpm);
+            lcd_write_line(0, line);
+            snprintf(line, sizeof(line), "%-*s", BAR_COL, display_mood_name(update.mood));
+            lcd_write_at(1, 0, line);
+            target = bar_level(update.bpm);
+            shown = update;
+        }
+
+        if (level != target) {
+            level += level < target ? 1 : -1;
+        }
+        draw_bar(level);
+        int sent;
+        PERF_SCOPE(flush_timer) {
+            sent = lcd_flush(); // only the changed digits, letters and bar cell
+        }
+        if (sent > 0) {
+            ESP_LOGD(TAG, "BPM %d, %s, bar %d (%d bytes)", shown.bpm, display_mood_name(shown.mood), level, sent);
+        }
+    }
+}
+
+esp_err_t display_start(int priority, int core) {
+    s_latest = xQueueCreateStatic(1, sizeof(display_update_t), s_latest_storage, &s_latest_queue);
+    xTaskCreateStaticPinnedToCore(display_task, "display_task", DISPLAY_STACK_SIZE, NULL, priority, s_display_stack,
+                                  &s_display_tcb, core);
+    return ESP_OK;
+}
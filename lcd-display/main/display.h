@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What the LCD shows: BPM on line 1, mood and a BPM bar graph on line 2.
+// The bar moves one pixel column per frame towards the latest BPM, using
+// custom glyphs for the partly filled cell.
+//
+// Producers (the network task, a local sensor, ...) hand updates over with
+// display_post(), which overwrites a one-slot queue and never blocks, so a
+// slow parallel bus can't hold them up and the display task only ever draws
+// the newest value. Bursts coalesce: ten posts between two redraws cost one
+// redraw, with no backlog.
+
+// Same values as Emotions in api_endpoint/algo.py
+typedef enum {
+    DISPLAY_MOOD_UNKNOWN = 0,
+    DISPLAY_MOOD_NEUTRAL = 1,
+    DISPLAY_MOOD_CALM = 2,
+    DISPLAY_MOOD_HAPPY = 3,
+    DISPLAY_MOOD_SAD = 4,
+    DISPLAY_MOOD_ANGRY = 5,
+    DISPLAY_MOOD_NERVOUS = 6,
+    DISPLAY_MOOD_COUNT,
+} display_mood_t;
+
+typedef struct {
+    int bpm;
+    display_mood_t mood;
+} display_update_t;
+
+// Create the queue and the display task, pinned to core (the LCD must be initialised)
+esp_err_t display_start(int priority, int core);
+
+// Latest value wins; safe from any task
+void display_post(const display_update_t *update);
+
+const char *display_mood_name(display_mood_t mood);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,301 @@
+#include "lcd.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#if SOC_DEDICATED_GPIO_SUPPORTED
+#include "driver/dedic_gpio.h"
+#endif
+
+static const char *TAG = "LCD";
+
+// Datasheet timings (HD44780U, 2.7-5.5 V)
+#define LCD_ENABLE_PULSE_US 1   // PWEH >= 450 ns
+#define LCD_EXEC_US 40          // most instructions and data writes: 37 us
+#define LCD_CLEAR_US 1600       // clear display / return home: 1.52 ms
+#define LCD_BUSY_TIMEOUT_US 2000
+
+static lcd_config_t s_cfg;
+static lcd_stats_t s_stats;
+
+static char s_glass[LCD_ROWS][LCD_COLS];   // what the display shows
+static char s_pending[LCD_ROWS][LCD_COLS]; // what lcd_flush() should make it show
+static bool s_glass_known;
+static int s_cursor_row = -1;              // DDRAM cursor, -1 when unknown
+static bool s_in_cgram;                    // data writes go to glyph memory
+static int s_cursor_col;
+
+// Bundle bit order: D4..D7 are the nibble, then RS and E
+#define BUNDLE_DATA_MASK 0x0F
+#define BUNDLE_RS (1 << 4)
+#define BUNDLE_E (1 << 5)
+#if SOC_DEDICATED_GPIO_SUPPORTED
+static dedic_gpio_bundle_handle_t s_bundle;
+#endif
+static uint32_t s_rs; // BUNDLE_RS for data, 0 for commands
+
+static void lcd_delay_ms(int ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
+
+static void lcd_set_e(int level) {
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    if (s_bundle != NULL) {
+        dedic_gpio_bundle_write(s_bundle, BUNDLE_E, level ? BUNDLE_E : 0);
+        return;
+    }
+#endif
+    gpio_set_level(s_cfg.e, level);
+}
+
+// Pulse E pin long enough to latch data
+static void lcd_pulse_enable() {
+    lcd_set_e(1);
+    if (s_cfg.slow_timing) {
+        lcd_delay_ms(5);
+    } else {
+        esp_rom_delay_us(LCD_ENABLE_PULSE_US);
+    }
+    lcd_set_e(0);
+    if (s_cfg.slow_timing) {
+        lcd_delay_ms(5);
+    } else {
+        esp_rom_delay_us(LCD_ENABLE_PULSE_US);
+    }
+}
+
+// Send a 4-bit nibble, with RS as set by lcd_send_byte()
+static void lcd_send_nibble(uint8_t nibble) {
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    if (s_bundle != NULL) {
+        dedic_gpio_bundle_write(s_bundle, BUNDLE_DATA_MASK | BUNDLE_RS, (nibble & BUNDLE_DATA_MASK) | s_rs);
+        lcd_pulse_enable();
+        return;
+    }
+#endif
+    gpio_set_level(s_cfg.rs, s_rs ? 1 : 0);
+    gpio_set_level(s_cfg.d4, (nibble >> 0) & 0x01);
+    gpio_set_level(s_cfg.d5, (nibble >> 1) & 0x01);
+    gpio_set_level(s_cfg.d6, (nibble >> 2) & 0x01);
+    gpio_set_level(s_cfg.d7, (nibble >> 3) & 0x01);
+    lcd_pulse_enable();
+}
+
+static void lcd_data_direction(gpio_mode_t mode) {
+    gpio_set_direction(s_cfg.d4, mode);
+    gpio_set_direction(s_cfg.d5, mode);
+    gpio_set_direction(s_cfg.d6, mode);
+    gpio_set_direction(s_cfg.d7, mode);
+}
+
+// Poll the busy flag (D7 of the high nibble) until the controller is ready.
+// Both nibbles have to be clocked out on every read.
+static void lcd_wait_busy() {
+    lcd_data_direction(GPIO_MODE_INPUT);
+    gpio_set_level(s_cfg.rs, 0);
+    gpio_set_level(s_cfg.rw, 1);
+
+    int64_t deadline = esp_timer_get_time() + LCD_BUSY_TIMEOUT_US;
+    while (1) {
+        gpio_set_level(s_cfg.e, 1);
+        esp_rom_delay_us(LCD_ENABLE_PULSE_US); // tDDR: data valid 360 ns after E rises
+        bool busy = gpio_get_level(s_cfg.d7);
+        gpio_set_level(s_cfg.e, 0);
+        esp_rom_delay_us(LCD_ENABLE_PULSE_US);
+        lcd_pulse_enable(); // low nibble (address counter), not needed
+
+        if (!busy) {
+            break;
+        }
+        s_stats.busy_polls++;
+        if (esp_timer_get_time() > deadline) {
+            s_stats.busy_timeouts++;
+            break;
+        }
+    }
+
+    gpio_set_level(s_cfg.rw, 0);
+    lcd_data_direction(GPIO_MODE_OUTPUT);
+}
+
+// Wait until an instruction that takes exec_us has finished
+static void lcd_wait_ready(uint32_t exec_us) {
+    if (s_cfg.slow_timing) {
+        lcd_delay_ms(exec_us > LCD_EXEC_US ? 10 : 2);
+    } else if (s_cfg.rw != GPIO_NUM_NC) {
+        lcd_wait_busy();
+    } else {
+        esp_rom_delay_us(exec_us);
+    }
+}
+
+// Send a byte (command or data)
+void lcd_send_byte(uint8_t data, bool is_data) {
+    s_rs = is_data ? BUNDLE_RS : 0;
+    lcd_send_nibble(data >> 4);   // high nibble first
+    if (s_cfg.slow_timing) {
+        lcd_delay_ms(2);          // small delay between nibbles
+    }
+    lcd_send_nibble(data & 0x0F); // then low nibble
+
+    // Clear (0x01) and return home (0x02/0x03) are the slow instructions
+    bool slow = !is_data && (data & 0xFC) == 0;
+    lcd_wait_ready(slow ? LCD_CLEAR_US : LCD_EXEC_US);
+
+    // Follow the cursor, which advances one cell per character (entry mode 0x06)
+    if (is_data) {
+        if (s_in_cgram) {
+            // glyph rows, the glass copy is unaffected
+        } else if (s_cursor_row < 0) {
+            s_glass_known = false; // written somewhere we can't tell
+        } else {
+            if (s_cursor_col < LCD_COLS) {
+                s_glass[s_cursor_row][s_cursor_col] = data;
+            }
+            s_cursor_col++;
+        }
+    } else if (data == 0x01) {
+        s_in_cgram = false;
+        memset(s_glass, ' ', sizeof(s_glass));
+        s_glass_known = true;
+        s_cursor_row = 0;
+        s_cursor_col = 0;
+    } else if ((data & 0xFE) == 0x02) {
+        s_in_cgram = false;
+        s_cursor_row = 0;
+        s_cursor_col = 0;
+    } else if (data & 0x80) {
+        uint8_t addr = data & 0x7F;
+        s_in_cgram = false;
+        s_cursor_row = addr >= 0x40 ? 1 : 0;
+        s_cursor_col = addr - (s_cursor_row ? 0x40 : 0x00);
+    } else if (data & 0x40) {
+        s_in_cgram = true; // CGRAM address: data goes to glyph memory
+        s_cursor_row = -1; // and the next DDRAM write needs a cursor move
+    }
+}
+
+void lcd_command(uint8_t cmd) {
+    lcd_send_byte(cmd, false);
+}
+
+void lcd_clear(void) {
+    lcd_command(0x01);
+}
+
+void lcd_set_cursor(uint8_t line, uint8_t col) {
+    uint8_t addr = (line == 0 ? 0x00 : 0x40) + col;
+    lcd_command(0x80 | addr);
+}
+
+void lcd_print(const char *str) {
+    while (*str) {
+        lcd_send_byte(*str++, true);
+        if (s_cfg.slow_timing) {
+            lcd_delay_ms(3); // tiny delay between characters
+        }
+    }
+}
+
+void lcd_write_at(uint8_t row, uint8_t col, const char *str) {
+    if (row >= LCD_ROWS) {
+        return;
+    }
+    while (*str && col < LCD_COLS) {
+        s_pending[row][col++] = *str++;
+    }
+}
+
+void lcd_write_line(uint8_t row, const char *str) {
+    if (row >= LCD_ROWS) {
+        return;
+    }
+    memset(s_pending[row], ' ', LCD_COLS);
+    lcd_write_at(row, 0, str);
+}
+
+int lcd_flush(void) {
+    int sent = 0;
+    for (int row = 0; row < LCD_ROWS; row++) {
+        for (int col = 0; col < LCD_COLS; col++) {
+            char c = s_pending[row][col];
+            if (s_glass_known && s_glass[row][col] == c) {
+                continue;
+            }
+            if (s_cursor_row != row || s_cursor_col != col) {
+                lcd_set_cursor(row, col);
+                sent++;
+            }
+            lcd_send_byte(c, true);
+            sent++;
+        }
+    }
+    s_glass_known = true; // either it was, or every cell has just been written
+    s_stats.flushes++;
+    s_stats.flush_bytes += sent;
+    return sent;
+}
+
+const lcd_stats_t *lcd_stats(void) {
+    return &s_stats;
+}
+
+// Initialize LCD in 4-bit mode
+esp_err_t lcd_init(const lcd_config_t *config) {
+    s_cfg = *config;
+
+    gpio_num_t outputs[] = {s_cfg.rs, s_cfg.e, s_cfg.rw, s_cfg.d4, s_cfg.d5, s_cfg.d6, s_cfg.d7};
+    for (int i = 0; i < sizeof(outputs) / sizeof(outputs[0]); i++) {
+        if (outputs[i] == GPIO_NUM_NC) {
+            continue;
+        }
+        gpio_reset_pin(outputs[i]);
+        ESP_ERROR_CHECK(gpio_set_direction(outputs[i], GPIO_MODE_OUTPUT));
+        gpio_set_level(outputs[i], 0);
+    }
+
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    if (s_cfg.fast_gpio && s_cfg.rw == GPIO_NUM_NC) {
+        const int bundle_gpios[] = {s_cfg.d4, s_cfg.d5, s_cfg.d6, s_cfg.d7, s_cfg.rs, s_cfg.e};
+        dedic_gpio_bundle_config_t bundle_config = {
+            .gpio_array = bundle_gpios,
+            .array_size = sizeof(bundle_gpios) / sizeof(bundle_gpios[0]),
+            .flags = {.out_en = 1},
+        };
+        esp_err_t err = dedic_gpio_new_bundle(&bundle_config, &s_bundle);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "No dedicated GPIO bundle (%s), using per-pin writes", esp_err_to_name(err));
+            s_bundle = NULL;
+        } else {
+            dedic_gpio_bundle_write(s_bundle, 0x3F, 0);
+        }
+    }
+#endif
+
+    memset(s_pending, ' ', sizeof(s_pending));
+    lcd_delay_ms(50); // power-up
+
+    // 4-bit init sequence. The busy flag can't be read until the interface
+    // width is set, so these waits are fixed (4.1 ms, 100 us, 100 us).
+    lcd_send_nibble(0x03); esp_rom_delay_us(s_cfg.slow_timing ? 10000 : 4500);
+    lcd_send_nibble(0x03); esp_rom_delay_us(s_cfg.slow_timing ? 10000 : 150);
+    lcd_send_nibble(0x03); esp_rom_delay_us(s_cfg.slow_timing ? 10000 : 150);
+    lcd_send_nibble(0x02); esp_rom_delay_us(s_cfg.slow_timing ? 10000 : 150);
+
+    lcd_command(0x28); // 4-bit, 2 lines, 5x8 dots
+    lcd_command(0x0C); // display ON, cursor OFF
+    lcd_command(0x06); // entry mode
+    lcd_clear();
+
+#if SOC_DEDICATED_GPIO_SUPPORTED
+    bool bundled = s_bundle != NULL;
+#else
+    bool bundled = false;
+#endif
+    ESP_LOGI(TAG, "LCD Initialized (%s timing, %s, %s)", s_cfg.slow_timing ? "slow" : "fast",
+             s_cfg.rw != GPIO_NUM_NC ? "busy flag" : "fixed delays",
+             bundled ? "dedicated GPIO bundle" : "per-pin GPIO");
+    return ESP_OK;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// HD44780 16x2 character LCD, 4-bit parallel bus.
+//
+// Timing follows the datasheet instead of sleeping whole milliseconds:
+// the enable pulse is ~1 us and a command waits its execution time (37 us,
+// 1.52 ms for clear/home). If R/W is wired (rw != GPIO_NUM_NC) the driver
+// polls the busy flag instead and moves on as soon as the controller is
+// ready. A full 32-character redraw takes ~2 ms instead of over a second.
+//
+// Reading the busy flag means the LCD drives D7: on a 5 V module that pin
+// needs a level shifter or a divider before it reaches the ESP32-S3.
+//
+// With fast_gpio (and R/W tied to ground) D4-D7, RS and E form a dedicated
+// GPIO bundle, so a nibble plus RS is one CPU register write and the enable
+// edges are one write each, instead of a gpio_set_level() call per pin.
+// Chips without dedicated GPIO, or a wired R/W (the data pins have to turn
+// around for busy-flag reads), use the per-pin path.
+
+#define LCD_COLS 16
+#define LCD_ROWS 2
+
+typedef struct {
+    gpio_num_t rs;
+    gpio_num_t e;
+    gpio_num_t rw; // GPIO_NUM_NC if R/W is tied to ground
+    gpio_num_t d4;
+    gpio_num_t d5;
+    gpio_num_t d6;
+    gpio_num_t d7;
+    bool slow_timing; // the original millisecond delays, for marginal wiring
+    bool fast_gpio;   // dedicated GPIO bundle where available
+} lcd_config_t;
+
+typedef struct {
+    uint32_t flushes;
+    uint32_t flush_bytes;   // cursor moves + characters sent by lcd_flush()
+    uint32_t busy_polls;    // busy-flag reads that found the controller busy
+    uint32_t busy_timeouts; // gave up waiting on the busy flag
+} lcd_stats_t;
+
+esp_err_t lcd_init(const lcd_config_t *config);
+
+void lcd_send_byte(uint8_t data, bool is_data);
+void lcd_command(uint8_t cmd);
+void lcd_clear(void);
+
+// Set cursor (line 0/1, column 0-15)
+void lcd_set_cursor(uint8_t line, uint8_t col);
+void lcd_print(const char *str);
+
+// Shadow framebuffer. Writes only change the buffer; lcd_flush() compares it
+// with what is on the glass and sends just the changed cells, with a cursor
+// move only where the changed cells aren't contiguous. The driver tracks
+// the DDRAM cursor, so text sent with lcd_print() keeps the comparison right.
+// Text past the end of the row is dropped.
+void lcd_write_at(uint8_t row, uint8_t col, const char *str);
+
+// Whole row, padded with spaces (replaces the clear + rewrite pattern)
+void lcd_write_line(uint8_t row, const char *str);
+
+// Returns the number of bytes sent on the bus
+int lcd_flush(void);
+
+const lcd_stats_t *lcd_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
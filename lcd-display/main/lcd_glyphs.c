@@ -0,0 +1,37 @@
+#include "lcd_glyphs.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include "lcd.h"
+
+static lcd_glyph_t s_resident[LCD_GLYPH_SLOTS];
+static bool s_valid[LCD_GLYPH_SLOTS]; // CGRAM contents are random after power-up
+
+void lcd_glyphs_invalidate(void) {
+    memset(s_valid, 0, sizeof(s_valid));
+}
+
+int lcd_glyphs_load(uint8_t first_slot, const lcd_glyph_t *glyphs, int count) {
+    int uploaded = 0;
+    int next_addr = -1; // CGRAM address auto-increments across consecutive slots
+
+    for (int i = 0; i < count && first_slot + i < LCD_GLYPH_SLOTS; i++) {
+        int slot = first_slot + i;
+        if (s_valid[slot] && memcmp(&s_resident[slot], &glyphs[i], sizeof(lcd_glyph_t)) == 0) {
+            continue;
+        }
+
+        if (next_addr != slot * 8) {
+            lcd_command(0x40 | (slot << 3)); // set CGRAM address
+        }
+        for (int row = 0; row < 8; row++) {
+            lcd_send_byte(glyphs[i].rows[row] & 0x1F, true);
+        }
+        next_addr = (slot + 1) * 8;
+
+        s_resident[slot] = glyphs[i];
+        s_valid[slot] = true;
+        uploaded++;
+    }
+    return uploaded;
+}
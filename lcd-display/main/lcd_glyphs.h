@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// Custom 5x8 characters in the HD44780's CGRAM.
+//
+// The controller has eight glyph slots. lcd_glyphs_load() keeps a copy of
+// what each slot holds and only uploads the glyphs that differ, so loading
+// the same set every frame costs nothing on the bus. Animate by changing
+// which glyph a cell shows (a DDRAM write through the shadow framebuffer),
+// not by rewriting the glyph.
+//
+// Glyph n is shown with character LCD_GLYPH_CHAR(n). Codes 8-15 alias CGRAM
+// 0-7 and, unlike code 0, work inside a C string for lcd_write_at().
+
+#define LCD_GLYPH_SLOTS 8
+#define LCD_GLYPH_CHAR(slot) ((char)(8 + (slot)))
+
+typedef struct {
+    uint8_t rows[8]; // top to bottom, bit 4 is the leftmost pixel
+} lcd_glyph_t;
+
+// Make glyphs[0..count) resident in slots first_slot.. and return how many
+// had to be uploaded
+int lcd_glyphs_load(uint8_t first_slot, const lcd_glyph_t *glyphs, int count);
+
+// Forget what CGRAM holds (e.g. after re-initialising the LCD)
+void lcd_glyphs_invalidate(void);
@@ -1,8 +1,23 @@
+#include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 
+#include "esp_http_client.h"
+#include "cJSON.h"
+#include "lcd.h"
+#include "display.h"
+#include "wifi_connect.h"
+#include "backend_discovery.h"
+#include "perf_counters.h"
+#include "node_config.h"
+#include "ota_update.h"
+#include "espnow_link.h"
+#include "json_arena.h"
+#include "task_placement.h"
+
 static const char *TAG = "QAPASS_LCD";
 
 // XIAO ESP32-S3 pin mapping
@@ -12,92 +27,175 @@ static const char *TAG = "QAPASS_LCD";
 #define D5 GPIO_NUM_4
 #define D6 GPIO_NUM_5
 #define D7 GPIO_NUM_6
-
-static void lcd_delay_ms(int ms) { vTaskDelay(pdMS_TO_TICKS(ms)); }
-
-// Pulse E pin long enough to latch data
-static void lcd_pulse_enable() {
-    gpio_set_level(E, 1);
-    lcd_delay_ms(5);
-    gpio_set_level(E, 0);
-    lcd_delay_ms(5);
-}
-
-// Send a 4-bit nibble safely
-static void lcd_send_nibble(uint8_t nibble) {
-    gpio_set_level(D4, (nibble >> 0) & 0x01);
-    gpio_set_level(D5, (nibble >> 1) & 0x01);
-    gpio_set_level(D6, (nibble >> 2) & 0x01);
-    gpio_set_level(D7, (nibble >> 3) & 0x01);
-    lcd_pulse_enable();
-}
-
-// Send a byte (command or data)
-static void lcd_send_byte(uint8_t data, bool is_data) {
-    gpio_set_level(RS, is_data ? 1 : 0);
-    lcd_send_nibble(data >> 4);   // high nibble first
-    lcd_delay_ms(2);              // small delay between nibbles
-    lcd_send_nibble(data & 0x0F); // then low nibble
-    lcd_delay_ms(2);
+#define RW GPIO_NUM_NC // set to the R/W GPIO to poll the busy flag instead of fixed delays
+
+#define DISPLAY_STATE_PATH "/display_state"
+#define URL_MAX 64
+#define DISPLAY_POLL_MS 1000
+#define BODY_MAX 96
+
+// ESP-NOW: 1 = show the accelerometer's beat broadcasts directly while they
+// keep coming, and the backend's /display_state once they stop
+// (components/espnow_link). Keeps the radio out of modem sleep, which would
+// miss broadcasts.
+#define LCD_ESPNOW 1
+#define ESPNOW_POLL_MS 100
+
+// Tunables the backend can change (PUT /node_config/lcd), applied at the next boot
+static int display_poll_ms = DISPLAY_POLL_MS;
+
+static const node_config_param_t tunables[] = {
+    NODE_CONFIG_INT("display_poll_ms", display_poll_ms, 100, 60000),
+};
+
+PERF_TIMER(state_get_timer, "display_get");
+
+static char body[BODY_MAX];
+static int body_len;
+
+// Every parse of /display_state comes from here, not the heap
+#define JSON_ARENA_SIZE 512
+static json_arena_t display_json;
+static uint8_t display_json_buf[JSON_ARENA_SIZE];
+
+static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
+    if (evt->event_id == HTTP_EVENT_ON_DATA && body_len + evt->data_len < BODY_MAX) {
+        memcpy(body + body_len, evt->data, evt->data_len);
+        body_len += evt->data_len;
+        body[body_len] = '\0';
+    }
+    return ESP_OK;
 }
 
-// Set cursor (line 0/1, column 0–15)
-static void lcd_set_cursor(uint8_t line, uint8_t col) {
-    uint8_t addr = (line == 0 ? 0x00 : 0x40) + col;
-    lcd_send_byte(0x80 | addr, false);
+// A fresh ESP-NOW beat is newer than anything the backend has
+static bool espnow_showing(void) {
+#if LCD_ESPNOW
+    espnow_beat_t beat;
+    return espnow_link_group(&beat);
+#else
+    return false;
+#endif
 }
 
-// Initialize LCD in 4-bit mode
-static void lcd_init() {
-    gpio_reset_pin(RS); gpio_set_direction(RS, GPIO_MODE_OUTPUT);
-    gpio_reset_pin(E);  gpio_set_direction(E, GPIO_MODE_OUTPUT);
-    gpio_reset_pin(D4); gpio_set_direction(D4, GPIO_MODE_OUTPUT);
-    gpio_reset_pin(D5); gpio_set_direction(D5, GPIO_MODE_OUTPUT);
-    gpio_reset_pin(D6); gpio_set_direction(D6, GPIO_MODE_OUTPUT);
-    gpio_reset_pin(D7); gpio_set_direction(D7, GPIO_MODE_OUTPUT);
-
-    lcd_delay_ms(50); // power-up
-
-    // 4-bit init sequence, slow
-    lcd_send_nibble(0x03); lcd_delay_ms(10);
-    lcd_send_nibble(0x03); lcd_delay_ms(10);
-    lcd_send_nibble(0x03); lcd_delay_ms(10);
-    lcd_send_nibble(0x02); lcd_delay_ms(10);
-
-    lcd_send_byte(0x28, false); // 4-bit, 2 lines, 5x8 dots
-    lcd_send_byte(0x0C, false); // display ON, cursor OFF
-    lcd_send_byte(0x06, false); // entry mode
-    lcd_send_byte(0x01, false); // clear display
-    lcd_delay_ms(10);
-
-    ESP_LOGI(TAG, "LCD Initialized");
-}
+// Polls {"tempo", "mood"} and posts it to the display; the LCD bus never
+// holds this task up, and a slow request never holds up the display
+void display_network_task(void *arg) {
+    char url[URL_MAX];
+    backend_discovery_url(DISPLAY_STATE_PATH, url, sizeof(url));
+    uint32_t generation = backend_discovery_generation();
+    perf_watch_task(NULL);
+
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_GET,
+        .timeout_ms = 2000,
+        .event_handler = http_event_handler,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
 
-// Print string safely
-static void lcd_print_safe(const char *str) {
-    while (*str) {
-        lcd_send_byte(*str++, true);
-        lcd_delay_ms(3); // tiny delay between characters
+    while (1) {
+        body_len = 0;
+        body[0] = '\0';
+        esp_err_t err;
+        PERF_SCOPE(state_get_timer) {
+            err = esp_http_client_perform(client);
+        }
+        if (err == ESP_OK && esp_http_client_get_status_code(client) == 200) {
+            json_arena_begin(&display_json);
+            cJSON *root = cJSON_Parse(body);
+            cJSON *tempo = cJSON_GetObjectItemCaseSensitive(root, "tempo");
+            cJSON *mood = cJSON_GetObjectItemCaseSensitive(root, "mood");
+            if (cJSON_IsNumber(tempo) && cJSON_IsNumber(mood)) {
+                display_update_t update = {
+                    .bpm = tempo->valueint,
+                    .mood = (display_mood_t)mood->valueint,
+                };
+                if (!espnow_showing()) {
+                    display_post(&update);
+                }
+            } else {
+                ESP_LOGW(TAG, "Unexpected display state: %s", body);
+            }
+            cJSON_Delete(root);
+            json_arena_end(&display_json);
+        } else {
+            ESP_LOGW(TAG, "Display state request failed: %s", esp_err_to_name(err));
+            esp_http_client_close(client); // reconnect on the next poll
+            backend_discovery_invalidate();
+        }
+
+        // Re-resolves only after a failure; otherwise this just formats the cached address
+        backend_discovery_url(DISPLAY_STATE_PATH, url, sizeof(url));
+        if (backend_discovery_generation() != generation) {
+            generation = backend_discovery_generation();
+            ESP_LOGI(TAG, "Backend moved, polling %s", url);
+            esp_http_client_set_url(client, url);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(display_poll_ms));
     }
 }
 
-// Task: write fixed "Tempo High" + "Happy" cleanly
-void lcd_test_task(void *arg) {
-    while (1) {
-        lcd_send_byte(0x01, false); // clear screen
-        lcd_delay_ms(10);
+// Task stacks are static, in bytes. /telemetry reports each one's free bytes
+// at its deepest point so far ("stacks"); trim against that, keeping a margin
+// for paths a short run doesn't hit (reconnects, OTA).
+#define NETWORK_STACK_SIZE 4096
+#define ESPNOW_STACK_SIZE 3072
 
-        lcd_set_cursor(0,0);       // line 1
-        lcd_print_safe("Tempo High");
+static StackType_t network_stack[NETWORK_STACK_SIZE];
+static StaticTask_t network_tcb;
 
-        lcd_set_cursor(1,0);       // line 2
-        lcd_print_safe("Happy");
+#if LCD_ESPNOW
+static StackType_t espnow_stack[ESPNOW_STACK_SIZE];
+static StaticTask_t espnow_tcb;
 
-        lcd_delay_ms(3000);        // wait 3 seconds
+void display_espnow_task(void *arg) {
+    while (1) {
+        espnow_beat_t beat;
+        if (espnow_link_group(&beat)) {
+            display_update_t update = {
+                .bpm = (int)((beat.bpm_milli + 500) / 1000),
+                .mood = (display_mood_t)beat.mood,
+            };
+            display_post(&update);
+        }
+        vTaskDelay(pdMS_TO_TICKS(ESPNOW_POLL_MS));
     }
 }
+#endif
 
 void app_main(void) {
-    lcd_init();
-    xTaskCreate(lcd_test_task, "LCD_Test", 4096, NULL, 5, NULL);
-}
\ No newline at end of file
+    ESP_ERROR_CHECK(node_config_load(tunables, sizeof(tunables) / sizeof(tunables[0])));
+
+    lcd_config_t config = {
+        .rs = RS, .e = E, .rw = RW,
+        .d4 = D4, .d5 = D5, .d6 = D6, .d7 = D7,
+        .slow_timing = false,
+        .fast_gpio = true,
+    };
+    ESP_ERROR_CHECK(lcd_init(&config));
+
+    // The display comes up first and shows "Waiting..." while Wi-Fi connects.
+    // It has the real-time core; the tasks feeding it stay with Wi-Fi.
+    ESP_ERROR_CHECK(display_start(TASK_PRIO_REALTIME, TASK_CORE_REALTIME));
+
+    wifi_connect_config_t wifi_config = WIFI_CONNECT_CONFIG_DEFAULT();
+#if LCD_ESPNOW
+    wifi_config.power_save = WIFI_PS_NONE;
+#endif
+    ESP_ERROR_CHECK(wifi_connect_start(&wifi_config));
+#if LCD_ESPNOW
+    // Needs no AP: the display follows the wearer while Wi-Fi is still connecting
+    ESP_ERROR_CHECK(espnow_link_init());
+    xTaskCreateStaticPinnedToCore(display_espnow_task, "display_espnow", ESPNOW_STACK_SIZE, NULL, TASK_PRIO_NETWORK,
+                                  espnow_stack, &espnow_tcb, TASK_CORE_NETWORK);
+#endif
+    wifi_connect_wait(portMAX_DELAY);
+    ESP_ERROR_CHECK(backend_discovery_init("cadence-lcd"));
+    ESP_ERROR_CHECK(perf_report_start("lcd"));
+    ESP_ERROR_CHECK(ota_update_start("lcd"));
+    json_arena_init(&display_json, display_json_buf, sizeof(display_json_buf));
+    xTaskCreateStaticPinnedToCore(display_network_task, "display_network", NETWORK_STACK_SIZE, NULL, TASK_PRIO_NETWORK,
+                                  network_stack, &network_tcb, TASK_CORE_NETWORK);
+}
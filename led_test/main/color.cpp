@@ -0,0 +1,84 @@
+#include "color.h"
+
+// a * b / 255 with exact endpoints (255 * 255 -> 255, x * 0 -> 0)
+static inline uint8_t scale8(uint8_t a, uint8_t b)
+{
+    return (uint8_t)((a * (b + 1)) >> 8);
+}
+
+// For each of the six hue sextants, which of {v, p, q, t} goes to G, R and B
+static const uint8_t SEXTANT_GRB[6][3] = {
+    {3, 0, 1}, // red -> yellow:    r=v g=t b=p
+    {0, 2, 1}, // yellow -> green:  r=q g=v b=p
+    {0, 1, 3}, // green -> cyan:    r=p g=v b=t
+    {2, 1, 0}, // cyan -> blue:     r=p g=q b=v
+    {1, 3, 0}, // blue -> magenta:  r=t g=p b=v
+    {1, 0, 2}, // magenta -> red:   r=v g=p b=q
+};
+
+void hsv8_to_grb(const uint8_t *hue, size_t count, uint8_t sat, uint8_t val, uint8_t *grb)
+{
+    uint8_t levels[4];
+    levels[0] = val;                     // v
+    levels[1] = scale8(val, 255 - sat); // p, constant for the whole span
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t h6 = hue[i] * 6u; // 0..1530
+        uint8_t sextant = h6 >> 8;
+        uint8_t frac = h6 & 0xFF;
+
+        levels[2] = scale8(val, 255 - scale8(sat, frac));       // q, falling edge
+        levels[3] = scale8(val, 255 - scale8(sat, 255 - frac)); // t, rising edge
+
+        const uint8_t *order = SEXTANT_GRB[sextant];
+        grb[0] = levels[order[0]];
+        grb[1] = levels[order[1]];
+        grb[2] = levels[order[2]];
+        grb += 3;
+    }
+}
+
+void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r, uint32_t *g, uint32_t *b)
+{
+    h %= 360;
+    uint32_t rgb_max = v * 255 / 200;
+    uint32_t rgb_min = rgb_max * (100 - s) / 100;
+    uint32_t i = h / 60;
+    uint32_t diff = h % 60;
+    uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
+
+    switch (i)
+    {
+    case 0:
+        *r = rgb_max;
+        *g = rgb_min + rgb_adj;
+        *b = rgb_min;
+        break;
+    case 1:
+        *r = rgb_max - rgb_adj;
+        *g = rgb_max;
+        *b = rgb_min;
+        break;
+    case 2:
+        *r = rgb_min;
+        *g = rgb_max;
+        *b = rgb_min + rgb_adj;
+        break;
+    case 3:
+        *r = rgb_min;
+        *g = rgb_max - rgb_adj;
+        *b = rgb_max;
+        break;
+    case 4:
+        *r = rgb_min + rgb_adj;
+        *g = rgb_min;
+        *b = rgb_max;
+        break;
+    default:
+        *r = rgb_max;
+        *g = rgb_min;
+        *b = rgb_max - rgb_adj;
+        break;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Colour conversion for the LED effects.
+//
+// hsv8_to_grb() converts a span of hues on a 256-step wheel into a packed
+// GRB frame (3 bytes per LED, the WS2812 wire order). It uses only 8x8-bit
+// multiplies and shifts, and a table instead of a 6-way switch to pick the
+// channel order per sextant.
+
+#define HUE8_FROM_DEGREES(deg) ((uint8_t)(((deg) * 256 + 180) / 360))
+
+void hsv8_to_grb(const uint8_t *hue, size_t count, uint8_t sat, uint8_t val, uint8_t *grb);
+
+/**
+ * Helper to convert HSV to RGB
+ * WLED and FastLED have this built-in, but for raw IDF we use a simple version
+ * Kept as the reference for kernel_run_benchmark().
+ */
+void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r, uint32_t *g, uint32_t *b);
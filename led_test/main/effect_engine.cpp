@@ -0,0 +1,85 @@
+#include "effect_engine.h"
+
+#include <stdlib.h>
+#include "esp_log.h"
+#include "frame_blend.h"
+
+static const char *TAG = "EFFECTS";
+
+void EffectEngine::init(LedFrameSet *frames)
+{
+    frames_ = frames;
+
+    // Mood -> look. Calm moods breathe blue, HAPPY rolls the rainbow,
+    // high-energy moods pulse warmer colours.
+    by_mood_[MOOD_NEUTRAL] = &pulse_calm_;
+    by_mood_[MOOD_CALM] = &pulse_calm_;
+    by_mood_[MOOD_SAD] = &pulse_calm_;
+    by_mood_[MOOD_HAPPY] = &rainbow_;
+    by_mood_[MOOD_NERVOUS] = &pulse_tense_;
+    by_mood_[MOOD_ANGRY] = &pulse_angry_;
+
+    active_.store(by_mood_[MOOD_NEUTRAL], std::memory_order_release);
+    shown_ = by_mood_[MOOD_NEUTRAL];
+
+    scratch_ = (uint8_t *)malloc(frames->max_leds * LED_FRAME_BYTES_PER_LED);
+    if (scratch_ == nullptr)
+    {
+        ESP_LOGW(TAG, "No memory for the crossfade buffer, mood changes will cut");
+    }
+}
+
+void EffectEngine::select_mood(int mood)
+{
+    if (mood <= 0 || mood >= MOOD_COUNT)
+    {
+        return; // unknown mood: keep the current look
+    }
+
+    const EffectSlot *slot = by_mood_[mood];
+    if (active_.exchange(slot, std::memory_order_acq_rel) != slot)
+    {
+        ESP_LOGI(TAG, "Mood %d -> %s", mood, slot->name);
+    }
+}
+
+void EffectEngine::render(const EffectContext &ctx)
+{
+    const EffectSlot *slot = active();
+    if (slot != shown_)
+    {
+        fading_from_ = scratch_ != nullptr ? shown_ : nullptr;
+        fade_start_us_ = ctx.t_us;
+        shown_ = slot;
+    }
+
+    // Progress through the fade as a blend step, 0..255
+    int64_t fade_us = ctx.t_us - fade_start_us_;
+    if (fading_from_ != nullptr && fade_us >= EFFECT_CROSSFADE_US)
+    {
+        fading_from_ = nullptr;
+    }
+    uint8_t step = fading_from_ != nullptr ? (uint8_t)(fade_us * (FRAME_BLEND_STEPS - 1) / EFFECT_CROSSFADE_US) : 0;
+
+    EffectContext strip_ctx = ctx;
+    strip_ctx.led_offset = 0;
+
+    for (int s = 0; s < frames_->count; s++)
+    {
+        LedFrame *strip = &frames_->strips[s];
+        uint8_t *back = led_frame_back(strip);
+        Effect *effect = slot->strips[s];
+        if (effect != nullptr)
+        {
+            effect->render(back, strip_ctx);
+        }
+
+        Effect *outgoing = fading_from_ != nullptr ? fading_from_->strips[s] : nullptr;
+        if (outgoing != nullptr && outgoing != effect)
+        {
+            outgoing->render(scratch_, strip_ctx);
+            frame_blend(back, scratch_, led_frame_size(strip), step);
+        }
+        strip_ctx.led_offset += strip->led_num;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include "effects.h"
+#include "led_frame.h"
+
+// One "look": the effect instance to run on each strip
+typedef struct
+{
+    const char *name;
+    Effect *strips[LED_FRAME_MAX_STRIPS];
+} EffectSlot;
+
+// Renders the active slot into every strip of a LedFrameSet.
+//
+// Moods map to slots. select_mood() is a single atomic pointer store, so it can
+// be called from any task and takes effect on the next frame with no task
+// teardown or re-initialisation.
+//
+// A new slot fades in over EFFECT_CROSSFADE_US: for those frames the old slot
+// renders into a scratch buffer and is blended into the new one
+// (frame_blend.h). A change mid-fade starts a fresh fade from the look that
+// was fading in.
+
+#define EFFECT_CROSSFADE_US 1500000
+
+class EffectEngine
+{
+public:
+    void init(LedFrameSet *frames);
+
+    // Bind the effects of one strip into a slot
+    template <size_t N>
+    void bind_strip(int strip, StripEffects<N> &fx);
+
+    void select_mood(int mood);
+    const EffectSlot *active() const { return active_.load(std::memory_order_acquire); }
+
+    // Render the active slot into every strip's back buffer (caller presents)
+    void render(const EffectContext &ctx);
+
+private:
+    LedFrameSet *frames_ = nullptr;
+    uint8_t *scratch_ = nullptr;              // max_leds * 3, the outgoing slot's frame
+    const EffectSlot *shown_ = nullptr;       // slot the last frame faded towards
+    const EffectSlot *fading_from_ = nullptr; // nullptr when no fade is running
+    int64_t fade_start_us_ = 0;
+    EffectSlot pulse_calm_ = {"calm pulse", {}};
+    EffectSlot pulse_tense_ = {"nervous pulse", {}};
+    EffectSlot pulse_angry_ = {"angry pulse", {}};
+    EffectSlot rainbow_ = {"rainbow", {}};
+    const EffectSlot *by_mood_[MOOD_COUNT] = {};
+    std::atomic<const EffectSlot *> active_{nullptr};
+};
+
+template <size_t N>
+void EffectEngine::bind_strip(int strip, StripEffects<N> &fx)
+{
+    pulse_calm_.strips[strip] = &fx.blue_pulse;
+    pulse_tense_.strips[strip] = &fx.amber_pulse;
+    pulse_angry_.strips[strip] = &fx.red_pulse;
+    rainbow_.strips[strip] = &fx.rainbow;
+}
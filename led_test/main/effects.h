@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "color.h"
+#include "pulse_math.h"
+
+// Mirrors Emotions in api_endpoint/algo.py (MOOD_* == Emotions.*.value)
+typedef enum
+{
+    MOOD_NEUTRAL = 1,
+    MOOD_CALM = 2,
+    MOOD_HAPPY = 3,
+    MOOD_SAD = 4,
+    MOOD_ANGRY = 5,
+    MOOD_NERVOUS = 6,
+} Mood;
+#define MOOD_COUNT 7 // indexable by Mood; slot 0 is unused
+
+typedef struct
+{
+    int64_t t_us;          // time since the engine started
+    uint32_t bpm;
+    int mood;
+    const BeatPhase *beat; // advanced once per frame by the render task
+    size_t led_offset;     // index of this strip's first LED across all strips
+} EffectContext;
+
+// An effect renders one frame for one strip into its packed GRB buffer.
+class Effect
+{
+public:
+    virtual ~Effect() = default;
+    virtual const char *name() const = 0;
+    virtual void render(uint8_t *grb, const EffectContext &ctx) = 0;
+};
+
+// Concrete effects are templated on the strip length so every inner loop has
+// a compile-time trip count the compiler can unroll.
+
+// Single colour breathing on the beat (the original blue pulse)
+template <size_t N>
+class PulseEffect final : public Effect
+{
+public:
+    PulseEffect(uint8_t r, uint8_t g, uint8_t b) : r_(r), g_(g), b_(b) {}
+
+    const char *name() const override { return "pulse"; }
+
+    void render(uint8_t *grb, const EffectContext &ctx) override
+    {
+        uint32_t level = pulse_brightness(ctx.beat, 255) + 1;
+        uint8_t g = (g_ * level) >> 8;
+        uint8_t r = (r_ * level) >> 8;
+        uint8_t b = (b_ * level) >> 8;
+
+        for (size_t i = 0; i < N; i++)
+        {
+            grb[i * 3 + 0] = g;
+            grb[i * 3 + 1] = r;
+            grb[i * 3 + 2] = b;
+        }
+    }
+
+private:
+    uint8_t r_, g_, b_;
+};
+
+#define RAINBOW_VALUE 127 // same level the old 0-100 HSV helper produced at v=100
+
+// Rainbow wheel rolling along the strips, a full turn every 3.6 s
+template <size_t N>
+class RainbowEffect final : public Effect
+{
+public:
+    const char *name() const override { return "rainbow"; }
+
+    void render(uint8_t *grb, const EffectContext &ctx) override
+    {
+        uint8_t start_hue = (uint8_t)(ctx.t_us / 14063); // 1 degree per 10 ms
+
+        // Each strip continues the rainbow where the previous one ended
+        for (size_t i = 0; i < N; i++)
+        {
+            hue_[i] = start_hue + (ctx.led_offset + i) * HUE8_FROM_DEGREES(10);
+        }
+        hsv8_to_grb(hue_, N, 255, RAINBOW_VALUE, grb);
+    }
+
+private:
+    uint8_t hue_[N];
+};
+
+// The full set of effect instances for one strip of length N
+template <size_t N>
+struct StripEffects
+{
+    PulseEffect<N> blue_pulse{0, 0, 200};
+    PulseEffect<N> amber_pulse{200, 90, 0};
+    PulseEffect<N> red_pulse{220, 0, 0};
+    RainbowEffect<N> rainbow;
+};
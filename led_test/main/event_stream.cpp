@@ -0,0 +1,151 @@
+#include "event_stream.h"
+
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "EVENT_STREAM";
+
+esp_err_t event_stream_init(EventStream *stream, const char *url)
+{
+    memset(stream, 0, sizeof(*stream));
+
+    esp_http_client_config_t config = {};
+    config.url = url;
+    config.method = HTTP_METHOD_GET;
+    config.timeout_ms = EVENT_STREAM_TIMEOUT_MS;
+
+    stream->handle = esp_http_client_init(&config);
+    if (stream->handle == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create HTTP client for %s", url);
+        return ESP_FAIL;
+    }
+    esp_http_client_set_header(stream->handle, "Accept", "text/event-stream");
+    return ESP_OK;
+}
+
+esp_err_t event_stream_set_url(EventStream *stream, const char *url)
+{
+    event_stream_close(stream);
+    return esp_http_client_set_url(stream->handle, url);
+}
+
+esp_err_t event_stream_open(EventStream *stream)
+{
+    event_stream_close(stream);
+
+    esp_err_t err = esp_http_client_open(stream->handle, 0);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    stream->open = true;
+    esp_http_client_fetch_headers(stream->handle); // length is -1 (chunked) for a stream
+
+    int status = esp_http_client_get_status_code(stream->handle);
+    if (status != 200)
+    {
+        event_stream_close(stream);
+        return status == 404 ? ESP_ERR_NOT_FOUND : ESP_FAIL;
+    }
+
+    stream->rx_len = 0;
+    stream->rx_pos = 0;
+    stream->line_len = 0;
+    stream->data_len = 0;
+    stream->stats.connects++;
+    return ESP_OK;
+}
+
+// Next complete line, without its terminator. Overlong lines are truncated.
+static esp_err_t event_stream_read_line(EventStream *stream)
+{
+    stream->line_len = 0;
+    while (1)
+    {
+        if (stream->rx_pos == stream->rx_len)
+        {
+            int n = esp_http_client_read(stream->handle, stream->rx, sizeof(stream->rx));
+            if (n <= 0) // closed by the backend, or silent past the timeout
+            {
+                return ESP_FAIL;
+            }
+            stream->rx_len = n;
+            stream->rx_pos = 0;
+        }
+
+        char c = stream->rx[stream->rx_pos++];
+        if (c == '\n')
+        {
+            if (stream->line_len > 0 && stream->line[stream->line_len - 1] == '\r')
+            {
+                stream->line_len--;
+            }
+            stream->line[stream->line_len] = '\0';
+            return ESP_OK;
+        }
+        if (stream->line_len < EVENT_STREAM_DATA_MAX - 1)
+        {
+            stream->line[stream->line_len++] = c;
+        }
+    }
+}
+
+esp_err_t event_stream_next(EventStream *stream)
+{
+    if (!stream->open)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    stream->data_len = 0;
+    while (event_stream_read_line(stream) == ESP_OK)
+    {
+        if (stream->line_len == 0)
+        {
+            // A blank line ends the event; one without data was only a comment
+            if (stream->data_len > 0)
+            {
+                stream->data[stream->data_len] = '\0';
+                stream->stats.events++;
+                return ESP_OK;
+            }
+            continue;
+        }
+        if (strncmp(stream->line, "data:", 5) != 0)
+        {
+            continue; // comments, "event:", "id:" and "retry:" aren't used
+        }
+
+        const char *value = stream->line + 5;
+        if (*value == ' ')
+        {
+            value++;
+        }
+        int len = strlen(value);
+        if (stream->data_len > 0 && stream->data_len < EVENT_STREAM_DATA_MAX - 1)
+        {
+            stream->data[stream->data_len++] = '\n'; // multi-line data
+        }
+        if (len > EVENT_STREAM_DATA_MAX - 1 - stream->data_len)
+        {
+            len = EVENT_STREAM_DATA_MAX - 1 - stream->data_len;
+        }
+        memcpy(stream->data + stream->data_len, value, len);
+        stream->data_len += len;
+    }
+
+    ESP_LOGW(TAG, "Stream ended (%lu events so far)", (unsigned long)stream->stats.events);
+    stream->stats.drops++;
+    event_stream_close(stream);
+    return ESP_FAIL;
+}
+
+void event_stream_close(EventStream *stream)
+{
+    if (stream->open)
+    {
+        esp_http_client_close(stream->handle);
+        stream->open = false;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+// Server-sent events reader for the backend's /led_events push channel.
+//
+// One long-lived GET whose response never ends: the backend writes a
+// "data: {...}" event whenever the tempo or mood changes, and re-sends the
+// state every 15 s when nothing happens. The read timeout is set well past
+// that, so a silent socket means the connection is gone rather than idle.
+
+#define EVENT_STREAM_DATA_MAX 192
+#define EVENT_STREAM_TIMEOUT_MS 35000 // a bit over two refresh periods
+
+typedef struct
+{
+    uint32_t connects; // streams opened
+    uint32_t events;   // "data:" events delivered
+    uint32_t drops;    // streams that ended or timed out
+} EventStreamStats;
+
+typedef struct
+{
+    esp_http_client_handle_t handle;
+    bool open;
+    char rx[128]; // bytes read but not yet split into lines
+    int rx_len;
+    int rx_pos;
+    char line[EVENT_STREAM_DATA_MAX];
+    int line_len;
+    char data[EVENT_STREAM_DATA_MAX]; // the event being assembled
+    int data_len;
+    EventStreamStats stats;
+} EventStream;
+
+esp_err_t event_stream_init(EventStream *stream, const char *url);
+esp_err_t event_stream_set_url(EventStream *stream, const char *url);
+
+// Send the request and check for a 200 event stream. ESP_ERR_NOT_FOUND means
+// the backend predates /led_events.
+esp_err_t event_stream_open(EventStream *stream);
+
+// Block until the next event; its data is left null-terminated in
+// stream->data. Any error means the stream is closed and has to be reopened.
+esp_err_t event_stream_next(EventStream *stream);
+
+void event_stream_close(EventStream *stream);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <array>
+#include "pulse_math.h"
+
+// Equal-power crossfade between two rendered frames, the light version of
+// the player's audio crossfade (merged_frontend/player_server.py): at
+// progress t the outgoing frame is weighted cos(t * pi/2) and the incoming
+// one sin(t * pi/2). The gains come from a compile-time table in Q8, so the
+// blend is two 8x9-bit multiplies per channel and no floating point (the
+// ESP32-C6 has no FPU).
+//
+// The weights sum to more than 1 mid-fade (1.41 at t = 0.5), which keeps a
+// fade between two dim looks from dipping; channels that would go past 255
+// saturate.
+
+#define FRAME_BLEND_STEPS 256
+
+namespace frame_blend_detail
+{
+constexpr std::array<uint16_t, FRAME_BLEND_STEPS> make_gain_lut()
+{
+    std::array<uint16_t, FRAME_BLEND_STEPS> lut{};
+    for (int i = 0; i < FRAME_BLEND_STEPS; i++)
+    {
+        double gain = 256 * pulse_math_detail::cx_sin(pulse_math_detail::kPi / 2 * i / (FRAME_BLEND_STEPS - 1));
+        lut[i] = (uint16_t)(gain + 0.5);
+    }
+    return lut;
+}
+} // namespace frame_blend_detail
+
+// sin(pi/2 * i / 255) in Q8; the outgoing gain is the table read backwards
+inline constexpr std::array<uint16_t, FRAME_BLEND_STEPS> FRAME_BLEND_GAIN = frame_blend_detail::make_gain_lut();
+
+static_assert(FRAME_BLEND_GAIN[0] == 0, "the incoming frame starts dark");
+static_assert(FRAME_BLEND_GAIN[FRAME_BLEND_STEPS - 1] == 256, "and ends at full weight");
+
+// dst = from * cos + dst * sin at progress step (0 = all from, 255 = all dst)
+inline void frame_blend(uint8_t *dst, const uint8_t *from, size_t bytes, uint8_t step)
+{
+    uint32_t gain_in = FRAME_BLEND_GAIN[step];
+    uint32_t gain_out = FRAME_BLEND_GAIN[FRAME_BLEND_STEPS - 1 - step];
+    for (size_t i = 0; i < bytes; i++)
+    {
+        uint32_t v = (from[i] * gain_out + dst[i] * gain_in) >> 8;
+        dst[i] = v > 255 ? 255 : (uint8_t)v;
+    }
+}
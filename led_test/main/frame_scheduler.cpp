@@ -0,0 +1,66 @@
+#include "frame_scheduler.h"
+
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "FRAME_SCHED";
+
+void frame_scheduler_init(FrameScheduler *sched, uint32_t period_ms)
+{
+    sched->period_ticks = pdMS_TO_TICKS(period_ms);
+    if (sched->period_ticks == 0)
+    {
+        sched->period_ticks = 1; // period shorter than one tick: run every tick
+    }
+    sched->last_wake = xTaskGetTickCount();
+    sched->start_us = esp_timer_get_time();
+    sched->frame_start_us = sched->start_us;
+    sched->max_work_us = 0;
+    sched->frames = 0;
+    sched->overruns = 0;
+    sched->missed = 0;
+}
+
+void frame_scheduler_wait(FrameScheduler *sched)
+{
+    int64_t work_us = esp_timer_get_time() - sched->frame_start_us;
+    if (work_us > sched->max_work_us)
+    {
+        sched->max_work_us = work_us;
+    }
+
+    sched->frames++;
+    if (sched->frames % FRAME_STATS_INTERVAL == 0)
+    {
+        frame_scheduler_log_stats(sched, pcTaskGetName(NULL));
+    }
+
+    if (xTaskDelayUntil(&sched->last_wake, sched->period_ticks) == pdFALSE)
+    {
+        // Deadline already passed: count the periods we fell behind and
+        // re-anchor on "now" so the next frames don't fire back to back.
+        TickType_t now = xTaskGetTickCount();
+        TickType_t behind = now - sched->last_wake;
+        sched->overruns++;
+        sched->missed += behind / sched->period_ticks;
+        sched->last_wake = now;
+    }
+
+    sched->frame_start_us = esp_timer_get_time();
+}
+
+int64_t frame_scheduler_elapsed_us(const FrameScheduler *sched)
+{
+    return sched->frame_start_us - sched->start_us;
+}
+
+void frame_scheduler_log_stats(const FrameScheduler *sched, const char *name)
+{
+    ESP_LOGI(TAG, "%s: frames=%lu overruns=%lu missed=%lu max_work=%lldus",
+             name,
+             (unsigned long)sched->frames,
+             (unsigned long)sched->overruns,
+             (unsigned long)sched->missed,
+             sched->max_work_us);
+}
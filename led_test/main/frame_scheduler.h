@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Fixed-period frame pacing for the LED effects.
+// Deadlines are absolute (xTaskDelayUntil), so render and refresh time
+// no longer stretch the frame period, and effects derive their phase
+// from frame_scheduler_elapsed_us() instead of a per-frame step.
+
+#define FRAME_PERIOD_MS 20 // ~50 FPS
+#define FRAME_STATS_INTERVAL 500 // log every N frames (10 s at 50 FPS)
+
+typedef struct
+{
+    TickType_t period_ticks;
+    TickType_t last_wake;
+    int64_t start_us;       // time of frame_scheduler_init()
+    int64_t frame_start_us; // time the current frame was released
+    int64_t max_work_us;    // longest render+refresh seen so far
+    uint32_t frames;
+    uint32_t overruns; // frames whose work ran past the deadline
+    uint32_t missed;   // whole periods skipped because of overruns
+} FrameScheduler;
+
+void frame_scheduler_init(FrameScheduler *sched, uint32_t period_ms);
+
+// Sleep until the next deadline. If the frame overran, the skipped periods are
+// counted and the schedule is re-anchored instead of bursting to catch up.
+void frame_scheduler_wait(FrameScheduler *sched);
+
+// Microseconds since init, sampled when the current frame was released
+int64_t frame_scheduler_elapsed_us(const FrameScheduler *sched);
+
+void frame_scheduler_log_stats(const FrameScheduler *sched, const char *name);
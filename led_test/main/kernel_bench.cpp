@@ -0,0 +1,98 @@
+#include "kernel_bench.h"
+
+#include <stdlib.h>
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "color.h"
+#include "effects.h"
+#include "frame_blend.h"
+#include "pulse_math.h"
+
+static const char *TAG = "KERNEL_BENCH";
+
+#define BENCH_ROUNDS 100
+#define BENCH_FRAME_US 16667 // 60 fps
+#define BENCH_BPM 120
+
+static unsigned long per_pixel(uint32_t cycles)
+{
+    return (unsigned long)(cycles / ((uint32_t)BENCH_ROUNDS * KERNEL_BENCH_LED_NUM));
+}
+
+static PulseEffect<KERNEL_BENCH_LED_NUM> bench_pulse{0, 0, 200};
+
+void kernel_run_benchmark()
+{
+    const size_t led_num = KERNEL_BENCH_LED_NUM;
+    uint8_t *hue = (uint8_t *)malloc(led_num);
+    uint8_t *grb = (uint8_t *)malloc(led_num * 3);
+    uint8_t *from = (uint8_t *)malloc(led_num * 3);
+    if (hue == NULL || grb == NULL || from == NULL)
+    {
+        ESP_LOGE(TAG, "Benchmark buffers for %u LEDs do not fit", (unsigned)led_num);
+        free(hue);
+        free(grb);
+        free(from);
+        return;
+    }
+
+    for (size_t i = 0; i < led_num; i++)
+    {
+        hue[i] = (uint8_t)(i * 7);
+    }
+
+    // Reference: one call per pixel, as led_rainbow_task used to do
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for (size_t i = 0; i < led_num; i++)
+        {
+            uint32_t r, g, b;
+            led_strip_hsv2rgb((round * 2 + i * 10) % 360, 100, 100, &r, &g, &b);
+            grb[i * 3 + 0] = g;
+            grb[i * 3 + 1] = r;
+            grb[i * 3 + 2] = b;
+        }
+    }
+    uint32_t reference_cycles = esp_cpu_get_cycle_count() - start;
+
+    start = esp_cpu_get_cycle_count();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        hue[0] += 1; // keep the compiler from hoisting the conversion out of the loop
+        hsv8_to_grb(hue, led_num, 255, 127, grb);
+    }
+    uint32_t batch_cycles = esp_cpu_get_cycle_count() - start;
+
+    // One pulse frame: advance the beat, then fill the strip
+    BeatPhase beat;
+    beat_phase_init(&beat, 0);
+    EffectContext ctx = {};
+    ctx.bpm = BENCH_BPM;
+    ctx.beat = &beat;
+    start = esp_cpu_get_cycle_count();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        ctx.t_us = (int64_t)(round + 1) * BENCH_FRAME_US;
+        beat_phase_advance(&beat, ctx.t_us, BENCH_BPM);
+        bench_pulse.render(grb, ctx);
+    }
+    uint32_t pulse_cycles = esp_cpu_get_cycle_count() - start;
+
+    // Crossfade from the last rainbow frame into the pulse
+    hsv8_to_grb(hue, led_num, 255, 127, from);
+    start = esp_cpu_get_cycle_count();
+    for (int round = 0; round < BENCH_ROUNDS; round++)
+    {
+        frame_blend(grb, from, led_num * 3, (uint8_t)(round * FRAME_BLEND_STEPS / BENCH_ROUNDS));
+    }
+    uint32_t blend_cycles = esp_cpu_get_cycle_count() - start;
+
+    ESP_LOGI(TAG, "%u LEDs: hsv2rgb reference %lu, batch %lu, pulse frame %lu, crossfade %lu cycles/px",
+             (unsigned)led_num, per_pixel(reference_cycles), per_pixel(batch_cycles),
+             per_pixel(pulse_cycles), per_pixel(blend_cycles));
+
+    free(hue);
+    free(grb);
+    free(from);
+}
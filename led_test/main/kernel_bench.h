@@ -0,0 +1,10 @@
+#pragma once
+
+// On-target timing of the per-pixel kernels: both HSV converters, a pulse
+// frame (beat_phase_advance + PulseEffect::render) and a crossfade step
+// (frame_blend). Logs CPU cycles per pixel over KERNEL_BENCH_LED_NUM LEDs,
+// so per-pixel regressions show up at boot rather than as dropped frames.
+
+#define KERNEL_BENCH_LED_NUM 300
+
+void kernel_run_benchmark();
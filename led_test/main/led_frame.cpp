@@ -0,0 +1,191 @@
+#include "led_frame.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
+#include "ws2812_encoder.h"
+
+static const char *TAG = "LED_FRAME";
+
+// TX-done ISR: records how long the frame actually took on the wire
+static bool led_frame_on_tx_done(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *edata, void *user_ctx)
+{
+    LedFrameStats *stats = (LedFrameStats *)user_ctx;
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - stats->tx_start_us);
+    stats->last_tx_us = elapsed;
+    if (elapsed > stats->max_tx_us)
+    {
+        stats->max_tx_us = elapsed;
+    }
+    return false; // no task woken
+}
+
+esp_err_t led_frame_init(LedFrame *frame, const LedFrameConfig *config)
+{
+    memset(frame, 0, sizeof(*frame));
+    frame->led_num = config->led_num;
+
+    size_t size = led_frame_size(frame);
+    for (int i = 0; i < 2; i++)
+    {
+        frame->buffers[i] = (uint8_t *)calloc(1, size);
+        if (frame->buffers[i] == NULL)
+        {
+            ESP_LOGE(TAG, "No memory for a %u byte frame buffer", (unsigned)size);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    rmt_tx_channel_config_t channel_config = {};
+    channel_config.gpio_num = (gpio_num_t)config->gpio_num;
+    channel_config.clk_src = RMT_CLK_SRC_DEFAULT;
+    channel_config.resolution_hz = config->resolution_hz;
+    channel_config.mem_block_symbols = config->mem_block_symbols ? config->mem_block_symbols : SOC_RMT_MEM_WORDS_PER_CHANNEL;
+    channel_config.trans_queue_depth = 2; // one frame on the wire, one queued
+    bool with_dma = config->with_dma;
+#if SOC_RMT_SUPPORT_DMA
+    channel_config.flags.with_dma = with_dma;
+#else
+    if (with_dma)
+    {
+        ESP_LOGW(TAG, "RMT DMA is not available on this chip, using interrupt refill");
+        with_dma = false;
+    }
+#endif
+    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&channel_config, &frame->channel), TAG, "create RMT TX channel failed");
+
+    rmt_tx_event_callbacks_t callbacks = {};
+    callbacks.on_trans_done = led_frame_on_tx_done;
+    ESP_RETURN_ON_ERROR(rmt_tx_register_event_callbacks(frame->channel, &callbacks, &frame->stats), TAG, "register TX callback failed");
+
+    ESP_RETURN_ON_ERROR(ws2812_new_encoder(config->resolution_hz, &frame->encoder), TAG, "create WS2812 encoder failed");
+    ESP_RETURN_ON_ERROR(rmt_enable(frame->channel), TAG, "enable RMT channel failed");
+
+    ESP_LOGI(TAG, "%u LEDs on GPIO %d, 2 x %u byte frame buffers, DMA %s",
+             (unsigned)config->led_num, config->gpio_num, (unsigned)size,
+             with_dma ? "on" : "off");
+    return ESP_OK;
+}
+
+// Block until the buffer handed out last time is off the wire
+static esp_err_t led_frame_wait_idle(LedFrame *frame)
+{
+    LedFrameStats *stats = &frame->stats;
+
+    int64_t wait_start = esp_timer_get_time();
+    esp_err_t err = rmt_tx_wait_all_done(frame->channel, LED_FRAME_TX_TIMEOUT_MS);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    uint32_t waited = (uint32_t)(esp_timer_get_time() - wait_start);
+    if (waited > stats->max_wait_us)
+    {
+        stats->max_wait_us = waited;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t led_frame_transmit(LedFrame *frame)
+{
+    LedFrameStats *stats = &frame->stats;
+
+    rmt_transmit_config_t tx_config = {};
+    stats->tx_start_us = esp_timer_get_time();
+    esp_err_t err = rmt_transmit(frame->channel, frame->encoder, led_frame_back(frame), led_frame_size(frame), &tx_config);
+    if (err == ESP_OK)
+    {
+        frame->back ^= 1;
+    }
+
+    if (++stats->frames % LED_FRAME_STATS_INTERVAL == 0)
+    {
+        led_frame_log_stats(frame);
+    }
+    return err;
+}
+
+esp_err_t led_frame_present(LedFrame *frame)
+{
+    // The other buffer is still being streamed from the previous call;
+    // it must be off the wire before it becomes the next back buffer
+    esp_err_t err = led_frame_wait_idle(frame);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return led_frame_transmit(frame);
+}
+
+esp_err_t led_frame_set_init(LedFrameSet *set, const LedFrameConfig *configs, int count)
+{
+    if (count < 1 || count > LED_FRAME_MAX_STRIPS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(set, 0, sizeof(*set));
+    for (int i = 0; i < count; i++)
+    {
+        ESP_RETURN_ON_ERROR(led_frame_init(&set->strips[i], &configs[i]), TAG, "init strip %d failed", i);
+        set->count++;
+        set->total_leds += configs[i].led_num;
+        if (configs[i].led_num > set->max_leds)
+        {
+            set->max_leds = configs[i].led_num;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t led_frame_set_present(LedFrameSet *set)
+{
+    esp_err_t result = ESP_OK;
+
+    for (int i = 0; i < set->count; i++)
+    {
+        esp_err_t err = led_frame_wait_idle(&set->strips[i]);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    for (int i = 0; i < set->count; i++)
+    {
+        esp_err_t err = led_frame_transmit(&set->strips[i]);
+        if (err != ESP_OK)
+        {
+            result = err;
+        }
+    }
+    return result;
+}
+
+void led_frame_log_stats(const LedFrame *frame)
+{
+    const LedFrameStats *stats = &frame->stats;
+    // WS2812: 24 bits * 1.25 us per LED plus the 50 us latch
+    uint32_t expected_us = frame->led_num * 30 + 50;
+
+    ESP_LOGI(TAG, "refresh %u LEDs: last=%luus max=%luus (wire %luus), max present() wait=%luus",
+             (unsigned)frame->led_num,
+             (unsigned long)stats->last_tx_us,
+             (unsigned long)stats->max_tx_us,
+             (unsigned long)expected_us,
+             (unsigned long)stats->max_wait_us);
+}
+
+void led_frame_fill(LedFrame *frame, uint8_t r, uint8_t g, uint8_t b)
+{
+    uint8_t *grb = led_frame_back(frame);
+    for (size_t i = 0; i < frame->led_num; i++)
+    {
+        grb[0] = g;
+        grb[1] = r;
+        grb[2] = b;
+        grb += LED_FRAME_BYTES_PER_LED;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/rmt_tx.h"
+
+// Double-buffered WS2812 output.
+//
+// Effects render a whole frame into the contiguous GRB array returned by
+// led_frame_back() and hand it off with led_frame_present(). The RMT
+// peripheral then streams that buffer in the background while the effect
+// renders the next frame into the other one. That replaces one
+// led_strip_set_pixel() call per LED plus a blocking led_strip_refresh().
+
+#define LED_FRAME_BYTES_PER_LED 3 // G, R, B
+#define LED_FRAME_TX_TIMEOUT_MS 100
+#define LED_FRAME_STATS_INTERVAL 500 // log refresh timing every N frames
+
+typedef struct
+{
+    int gpio_num;
+    size_t led_num;
+    uint32_t resolution_hz;
+    bool with_dma;            // only honoured where the RMT has DMA (SOC_RMT_SUPPORT_DMA)
+    size_t mem_block_symbols; // channel memory, or DMA buffer size with DMA; 0 = chip default
+} LedFrameConfig;
+
+typedef struct
+{
+    volatile int64_t tx_start_us;  // set by present(), read by the TX-done ISR
+    volatile uint32_t last_tx_us;  // measured wire time of the last completed frame
+    volatile uint32_t max_tx_us;
+    uint32_t max_wait_us; // longest time present() blocked on the previous frame
+    uint32_t frames;
+} LedFrameStats;
+
+typedef struct
+{
+    rmt_channel_handle_t channel;
+    rmt_encoder_handle_t encoder;
+    uint8_t *buffers[2];
+    size_t led_num;
+    int back; // index of the buffer effects render into
+    LedFrameStats stats;
+} LedFrame;
+
+esp_err_t led_frame_init(LedFrame *frame, const LedFrameConfig *config);
+
+// Buffer for the next frame, led_num * 3 bytes in GRB order
+static inline uint8_t *led_frame_back(LedFrame *frame)
+{
+    return frame->buffers[frame->back];
+}
+
+static inline size_t led_frame_size(const LedFrame *frame)
+{
+    return frame->led_num * LED_FRAME_BYTES_PER_LED;
+}
+
+// Start transmitting the back buffer and swap. Only waits if the previous
+// frame is still on the wire, so the buffer being handed back is free.
+esp_err_t led_frame_present(LedFrame *frame);
+
+// Several strips, each on its own RMT channel, driven as one output
+#define LED_FRAME_MAX_STRIPS 4
+
+typedef struct
+{
+    LedFrame strips[LED_FRAME_MAX_STRIPS];
+    int count;
+    size_t total_leds;
+    size_t max_leds; // longest strip
+} LedFrameSet;
+
+esp_err_t led_frame_set_init(LedFrameSet *set, const LedFrameConfig *configs, int count);
+
+// Present every strip: first wait for all of them to go idle, then start all
+// transmissions back to back so they run on the wire in parallel
+esp_err_t led_frame_set_present(LedFrameSet *set);
+
+void led_frame_log_stats(const LedFrame *frame);
+
+// Fill the back buffer with one colour
+void led_frame_fill(LedFrame *frame, uint8_t r, uint8_t g, uint8_t b);
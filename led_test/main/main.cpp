@@ -1,14 +1,32 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
-#include "led_strip.h"
-#include <math.h> // Required for sinf()
+#include "esp_timer.h"
 
-#include "esp_wifi.h"
-#include "esp_event.h"
-#include "nvs_flash.h"
 #include "esp_http_client.h"
+#include "wifi_connect.h"
+#include "backend_discovery.h"
+#include "tempo_client.h"
+#include "event_stream.h"
+#include "refresh_policy.h"
+#include "perf_counters.h"
+#include "frame_scheduler.h"
+#include "pulse_math.h"
+#include "color.h"
+#include "led_frame.h"
+#include "effect_engine.h"
+#include "clock_sync.h"
+#include "kernel_bench.h"
+#include "trace_report.h"
+#include "node_config.h"
+#include "ota_update.h"
+#include "espnow_link.h"
+#include "json_arena.h"
+#include "task_placement.h"
 
 #include "cJSON.h"
 
@@ -16,262 +34,517 @@ typedef struct
 {
     int tempo;
     int mood;
+    uint32_t beat_mbpm; // tempo of the backend's beat grid in milli-BPM, 0 if unknown
+    int64_t beat_us;    // esp_timer time of one beat of that grid
+    bool player_grid;   // that grid is the music player's, not a cadence's
+    uint32_t refresh_ms; // backend's suggested poll interval, 0 if none
+    bool traced;         // trace holds the backend's flow ID of the batch behind tempo
+    uint32_t trace;
+    bool clock_valid;    // clock_offset_us is backend time minus esp_timer time
+    int64_t clock_offset_us;
 } TempMood;
 
-// Configuration
-#define LED_STRIP_BLINK_GPIO 0                  // D0 on Seeed XIAO ESP32-C6
-#define LED_STRIP_LED_NUM 10                    // Change to your actual LED count
-#define LED_STRIP_RMT_RES_HZ (10 * 1000 * 1000) // 10MHz resolution
+// Configuration (idf.py menuconfig -> LED Strip Configuration)
+#define LED_STRIP_RMT_RES_HZ CONFIG_LED_STRIP_RMT_RES_HZ
+#ifdef CONFIG_LED_STRIP_USE_DMA
+#define LED_STRIP_USE_DMA true
+#define LED_STRIP_MEM_SYMBOLS CONFIG_LED_STRIP_DMA_SYMBOLS
+#else
+#define LED_STRIP_USE_DMA false
+#define LED_STRIP_MEM_SYMBOLS 0 // chip default channel memory
+#endif
+
+// One entry per strip. Only strip 1 can get the RMT's DMA channel.
+static const LedFrameConfig strip_configs[] = {
+    {CONFIG_LED_STRIP_GPIO, CONFIG_LED_STRIP_LED_NUM, LED_STRIP_RMT_RES_HZ, LED_STRIP_USE_DMA, LED_STRIP_MEM_SYMBOLS},
+#if CONFIG_LED_STRIP_COUNT >= 2
+    {CONFIG_LED_STRIP2_GPIO, CONFIG_LED_STRIP2_LED_NUM, LED_STRIP_RMT_RES_HZ, false, 0},
+#endif
+#if CONFIG_LED_STRIP_COUNT >= 3
+    {CONFIG_LED_STRIP3_GPIO, CONFIG_LED_STRIP3_LED_NUM, LED_STRIP_RMT_RES_HZ, false, 0},
+#endif
+#if CONFIG_LED_STRIP_COUNT >= 4
+    {CONFIG_LED_STRIP4_GPIO, CONFIG_LED_STRIP4_LED_NUM, LED_STRIP_RMT_RES_HZ, false, 0},
+#endif
+};
+#define LED_STRIP_COUNT ((int)(sizeof(strip_configs) / sizeof(strip_configs[0])))
 
 #define PULSE_BPM 40
-#define MS_PER_BEAT (60000 / PULSE_BPM)
+
+#define RUN_KERNEL_BENCHMARK 0 // log per-pixel kernel cycles at boot
+
+// ESP-NOW: 1 = follow the accelerometer's beat broadcasts directly while
+// its wearer is walking steadily, and the backend's /led_state otherwise
+// (components/espnow_link). A backend relaying the music player's beat grid
+// always wins. Keeps the radio out of modem sleep, which would miss broadcasts.
+#define LED_ESPNOW 1
+#define ESPNOW_MIN_CONFIDENCE 0.5f // steadier than this, the pulse peaks land on the steps
+#define ESPNOW_STEP_RECENT_MS 2000 // a wearer whose last step is older is standing still
 
 int pulse_bpm = PULSE_BPM;
 
-static const char *TAG = "LED_RAINBOW";
-led_strip_handle_t led_strip;
+// Tunables the backend can change (PUT /node_config/leds), applied at the next
+// boot. Strip count and lengths stay in Kconfig: they size the frame buffers
+// and pick each strip's effect specialisation at compile time.
+static int start_bpm = PULSE_BPM; // until the backend answers
+static char follow_device[16] = CONFIG_LED_FOLLOW_DEVICE; // empty follows the group
 
-#define MAX_INT_DIGITS 16
-static char int_buffer[MAX_INT_DIGITS];
-static int int_buffer_index = 0;
+static const node_config_param_t tunables[] = {
+    NODE_CONFIG_INT("start_bpm", start_bpm, 20, 250),
+    NODE_CONFIG_STRING("follow_device", follow_device),
+};
 
-esp_err_t _http_event_handler(esp_http_client_event_t *evt)
+#if LED_ESPNOW
+static uint32_t follow_device_id; // follow_device parsed, 0 for the group
+#endif
+
+static const char *TAG = "LED_RAINBOW";
+LedFrameSet led_frames;
+
+// Effect instances, each specialised for its strip's length
+static StripEffects<CONFIG_LED_STRIP_LED_NUM> strip1_effects;
+#if CONFIG_LED_STRIP_COUNT >= 2
+static StripEffects<CONFIG_LED_STRIP2_LED_NUM> strip2_effects;
+#endif
+#if CONFIG_LED_STRIP_COUNT >= 3
+static StripEffects<CONFIG_LED_STRIP3_LED_NUM> strip3_effects;
+#endif
+#if CONFIG_LED_STRIP_COUNT >= 4
+static StripEffects<CONFIG_LED_STRIP4_LED_NUM> strip4_effects;
+#endif
+
+static EffectEngine effect_engine;
+
+// On the backend found over mDNS, with ?device=<follow_device> appended
+#define LED_STATE_PATH "/led_state"
+#define LED_EVENTS_PATH "/led_events"
+#define URL_MAX 96
+#define PATH_LEN 48
+#define CLOCK_RESYNC_MS 60000    // while pushed, still poll now and then for a clock sample
+#define STREAM_RETRY_MS 1000
+#define PUSH_RETRY_MS 60000      // how long to poll before asking a push-less backend again
+
+// Created once by the network task; keeps the connection to the backend open between polls
+static TempoClient tempo_client;
+
+// Pushed updates; the backend sends only when tempo or mood actually changes
+static EventStream led_events;
+
+// Backend clock offset, owned by the network task
+static clock_sync_t backend_clock;
+
+// Single-slot mailbox holding the latest TempMood. The network task overwrites it,
+// the render task peeks it, so neither side ever waits on the other.
+static QueueHandle_t tempo_mailbox;
+static StaticQueue_t tempo_mailbox_queue;
+static uint8_t tempo_mailbox_storage[sizeof(TempMood)];
+
+// Every parse of /led_state or an event comes from here, not the heap
+#define LED_JSON_ARENA_SIZE 1024 // a full /led_state object takes about 400
+static json_arena_t led_json;
+static uint8_t led_json_buf[LED_JSON_ARENA_SIZE];
+
+// Accepted ranges; anything outside is a bad response, not a new tempo
+#define LED_TEMPO_MIN 20
+#define LED_TEMPO_MAX 250
+#define LED_BEAT_MBPM_MIN (LED_TEMPO_MIN * 1000)
+#define LED_BEAT_MBPM_MAX (LED_TEMPO_MAX * 1000)
+
+// Last state that passed validation. A bad update is dropped whole, so the
+// lights keep following this instead of a half-applied or garbage value.
+static TempMood last_good_state = {PULSE_BPM, MOOD_NEUTRAL, 0, 0, 0};
+
+static bool number_in_range(const cJSON *item, double min, double max)
 {
-    switch (evt->event_id)
-    {
-    case HTTP_EVENT_ON_DATA:
-        // Only copy if it fits (to prevent overflow)
-        if (int_buffer_index + evt->data_len < MAX_INT_DIGITS - 1)
-        {
-            memcpy(int_buffer + int_buffer_index, evt->data, evt->data_len);
-            int_buffer_index += evt->data_len;
-            int_buffer[int_buffer_index] = '\0'; // Keep it null-terminated
-        }
-        break;
-    case HTTP_EVENT_ON_FINISH:
-        // Reset index for the next request
-        int_buffer_index = 0;
-        break;
-    default:
-        break;
-    }
-    return ESP_OK;
+    return cJSON_IsNumber(item) && item->valuedouble >= min && item->valuedouble <= max;
 }
 
-int make_temp_request()
+// Parse one update, from a poll or a pushed event: the full
+// {"tempo", "mood", "beat_bpm", "beat_ms", "server_ms"} object, or a bare
+// integer from an old /tempo endpoint (tempo only, mood and grid kept).
+// The beat grid, and "beat_source" marking it as the player's, are optional
+// so older backends still drive tempo and mood.
+// Only polls (send_us != 0) bracket server_ms with a round trip and can feed
+// the clock estimate; pushed grids use the offset from the last poll.
+// On success *state is the merged result; on failure it is the last good one.
+static bool parse_led_state(const char *json, TempMood *state, int64_t send_us, int64_t recv_us)
 {
-    int result = 0;
-    int_buffer[0] = '\0'; // Clear buffer before starting
-
-    esp_http_client_config_t config = {
-        .url = "http://10.29.199.121:8000/tempo",
-        .event_handler = _http_event_handler,
-    };
+    *state = last_good_state;
+
+    json_arena_begin(&led_json);
+    cJSON *root = cJSON_Parse(json);
+    cJSON *tempo = cJSON_IsNumber(root) ? root : cJSON_GetObjectItemCaseSensitive(root, "tempo");
+    cJSON *mood = cJSON_GetObjectItemCaseSensitive(root, "mood");
+    cJSON *beat_bpm = cJSON_GetObjectItemCaseSensitive(root, "beat_bpm");
+    cJSON *beat_ms = cJSON_GetObjectItemCaseSensitive(root, "beat_ms");
+    cJSON *server_ms = cJSON_GetObjectItemCaseSensitive(root, "server_ms");
+    cJSON *refresh_ms = cJSON_GetObjectItemCaseSensitive(root, "refresh_ms");
+    cJSON *trace = cJSON_GetObjectItemCaseSensitive(root, "trace");
+    cJSON *beat_source = cJSON_GetObjectItemCaseSensitive(root, "beat_source");
+
+    bool ok = number_in_range(tempo, LED_TEMPO_MIN, LED_TEMPO_MAX) &&
+              (mood == NULL || number_in_range(mood, 1, MOOD_COUNT - 1));
+    if (!ok)
+    {
+        ESP_LOGW(TAG, "Rejected LED state: %s", json);
+        cJSON_Delete(root);
+        json_arena_end(&led_json);
+        return false;
+    }
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
+    TempMood next = last_good_state;
+    next.tempo = tempo->valueint;
+    if (mood != NULL)
+    {
+        next.mood = mood->valueint;
+    }
+    next.refresh_ms = number_in_range(refresh_ms, 1, 3600000) ? (uint32_t)refresh_ms->valueint : 0;
+    next.traced = number_in_range(trace, 0, UINT32_MAX);
+    next.trace = next.traced ? (uint32_t)trace->valuedouble : 0;
 
-    if (esp_http_client_perform(client) == ESP_OK)
+    if (!cJSON_IsNumber(root))
     {
-        // Convert the string "123" to the actual integer 123
-        result = atoi(int_buffer);
-        printf("The integer is: %d\n", result);
+        next.beat_mbpm = 0; // an object without a grid means free-run
+        next.beat_us = 0;
+        next.player_grid = false;
+    }
+    if (number_in_range(beat_bpm, LED_BEAT_MBPM_MIN / 1000.0, LED_BEAT_MBPM_MAX / 1000.0) &&
+        cJSON_IsNumber(beat_ms) && cJSON_IsNumber(server_ms))
+    {
+        // Epoch milliseconds are exact in a double; convert once per update
+        if (send_us != 0)
+        {
+            clock_sync_add_sample(&backend_clock, send_us, recv_us, (int64_t)server_ms->valuedouble * 1000);
+        }
+        if (clock_sync_valid(&backend_clock))
+        {
+            next.beat_mbpm = (uint32_t)(beat_bpm->valuedouble * 1000 + 0.5);
+            next.beat_us = clock_sync_to_local(&backend_clock, (int64_t)beat_ms->valuedouble * 1000);
+            next.player_grid = cJSON_IsString(beat_source) && strcmp(beat_source->valuestring, "player") == 0;
+            ESP_LOGI(TAG, "Beat grid %lu mBPM, clock offset %lldus (rtt %lldus)",
+                     (unsigned long)next.beat_mbpm, backend_clock.offset_us, backend_clock.rtt_us);
+        }
     }
+    next.clock_valid = clock_sync_valid(&backend_clock);
+    next.clock_offset_us = backend_clock.offset_us;
+    cJSON_Delete(root);
+    json_arena_end(&led_json);
+
+    last_good_state = next;
+    *state = next;
+    ESP_LOGD(TAG, "Tempo %d, mood %d", state->tempo, state->mood);
+    return true;
+}
 
-    esp_http_client_cleanup(client);
-    return result;
+static void publish_led_state(const TempMood *state)
+{
+    xQueueOverwrite(tempo_mailbox, state);
 }
 
-/**
- * Helper to convert HSV to RGB
- * WLED and FastLED have this built-in, but for raw IDF we use a simple version
- */
-void led_strip_hsv2rgb(uint32_t h, uint32_t s, uint32_t v, uint32_t *r, uint32_t *g, uint32_t *b)
+// Poll pacing for when the backend doesn't push
+static RefreshPolicy refresh_policy;
+
+// One GET of /led_state. A failed request leaves the previous value in the
+// mailbox. Returns how long to wait before the next poll.
+static uint32_t poll_led_state(void)
 {
-    h %= 360;
-    uint32_t rgb_max = v * 255 / 200;
-    uint32_t rgb_min = rgb_max * (100 - s) / 100;
-    uint32_t i = h / 60;
-    uint32_t diff = h % 60;
-    uint32_t rgb_adj = (rgb_max - rgb_min) * diff / 60;
-
-    switch (i)
+    TempMood latest;
+    int64_t send_us = esp_timer_get_time();
+    esp_err_t err = tempo_client_get(&tempo_client);
+    if (err == ESP_OK)
+    {
+        int64_t recv_us = esp_timer_get_time();
+        if (parse_led_state(tempo_client.body, &latest, send_us, recv_us))
+        {
+            publish_led_state(&latest);
+            tempo_client_log_stats(&tempo_client);
+            return refresh_policy_update(&refresh_policy, latest.tempo, latest.refresh_ms);
+        }
+    }
+    else if (err != ESP_ERR_INVALID_SIZE) // an oversized answer still came from the backend
     {
-    case 0:
-        *r = rgb_max;
-        *g = rgb_min + rgb_adj;
-        *b = rgb_min;
-        break;
-    case 1:
-        *r = rgb_max - rgb_adj;
-        *g = rgb_max;
-        *b = rgb_min;
-        break;
-    case 2:
-        *r = rgb_min;
-        *g = rgb_max;
-        *b = rgb_min + rgb_adj;
-        break;
-    case 3:
-        *r = rgb_min;
-        *g = rgb_max - rgb_adj;
-        *b = rgb_max;
-        break;
-    case 4:
-        *r = rgb_min + rgb_adj;
-        *g = rgb_min;
-        *b = rgb_max;
-        break;
-    default:
-        *r = rgb_max;
-        *g = rgb_min;
-        *b = rgb_max - rgb_adj;
-        break;
+        backend_discovery_invalidate(); // resolve again before the next poll
     }
+    tempo_client_log_stats(&tempo_client);
+    return refresh_policy_failed(&refresh_policy);
 }
 
-void led_rainbow_task(void *pvParameters)
+// Follow /led_events until the stream drops. The lights pick up a tempo
+// change one network hop after the backend detects it, and nothing is sent
+// while it holds steady. Returns false if the backend has no push channel.
+static bool follow_led_events(void)
 {
-    uint32_t start_rgb = 0;
-    uint32_t r, g, b;
+    esp_err_t err = event_stream_open(&led_events);
+    if (err != ESP_OK)
+    {
+        if (err != ESP_ERR_NOT_FOUND)
+        {
+            ESP_LOGW(TAG, "LED event stream failed: %s", esp_err_to_name(err));
+        }
+        return false;
+    }
+    ESP_LOGI(TAG, "Following pushed LED state");
 
-    ESP_LOGI(TAG, "Starting Rainbow Loop...");
-    while (1)
+    int64_t last_sync_us = esp_timer_get_time();
+    while (event_stream_next(&led_events) == ESP_OK)
     {
-        for (int i = 0; i < LED_STRIP_LED_NUM; i++)
+        TempMood latest;
+        if (parse_led_state(led_events.data, &latest, 0, 0))
         {
-            uint32_t hue = (start_rgb + i * 10) % 360;
-            led_strip_hsv2rgb(hue, 100, 100, &r, &g, &b);
-            // Write to the internal buffer
-            led_strip_set_pixel(led_strip, i, r, g, b);
+            publish_led_state(&latest);
         }
-        // Push the buffer to the hardware
-        led_strip_refresh(led_strip);
 
-        start_rgb += 2;                // Speed of the rainbow cycle
-        vTaskDelay(pdMS_TO_TICKS(20)); // ~50 FPS
+        if (esp_timer_get_time() - last_sync_us >= CLOCK_RESYNC_MS * 1000LL)
+        {
+            last_sync_us = esp_timer_get_time();
+            poll_led_state();
+        }
     }
+    ESP_LOGW(TAG, "LED event stream dropped after %lu events (%lu connects)",
+             (unsigned long)led_events.stats.events, (unsigned long)led_events.stats.connects);
+    return true;
 }
 
-void led_pulse_task(void *pvParameters)
+void tempo_network_task(void *pvParameters)
 {
-    ESP_LOGI(TAG, "Starting Blue Pulse...");
-
-    float angle = 0.0;
-    float step = 0.0;
+    // The strips already run at start_bpm while Wi-Fi comes up
+    printf("Waiting for IP...\n");
+    wifi_connect_wait(portMAX_DELAY);
+    printf("IP Received! Connecting to my server...\n");
 
-    // Track the last time we made a request (in Milliseconds)
-    uint32_t last_request_time = 0;
+    ESP_ERROR_CHECK(backend_discovery_init("cadence-leds"));
+    perf_watch_task(NULL);
+    ESP_ERROR_CHECK(perf_report_start("leds"));
+    ESP_ERROR_CHECK(trace_report_start("leds"));
+    ESP_ERROR_CHECK(ota_update_start("leds"));
+    char state_path[PATH_LEN];
+    char events_path[PATH_LEN];
+    snprintf(state_path, sizeof(state_path), LED_STATE_PATH "?device=%s", follow_device);
+    snprintf(events_path, sizeof(events_path), LED_EVENTS_PATH "?device=%s", follow_device);
+    char url[URL_MAX];
+    backend_discovery_url(state_path, url, sizeof(url));
+    uint32_t generation = backend_discovery_generation();
+    ESP_ERROR_CHECK(tempo_client_init(&tempo_client, url));
+    backend_discovery_url(events_path, url, sizeof(url));
+    ESP_ERROR_CHECK(event_stream_init(&led_events, url));
+    refresh_policy_init(&refresh_policy);
+    TickType_t next_push_try = xTaskGetTickCount();
 
     while (1)
     {
-        uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-
-        // Check if 10 seconds (10000ms) have passed or if it's the first run
-        if (current_time - last_request_time >= 10000 || last_request_time == 0)
+        // Only a failed poll makes this resolve again; usually it just formats the cached address
+        backend_discovery_url(state_path, url, sizeof(url));
+        if (backend_discovery_generation() != generation)
         {
-            ESP_LOGI(TAG, "Refreshing Pulse BPM...");
-            pulse_bpm = make_temp_request();
-
-            // Recalculate the step based on the new BPM
-            int ms_per_beat = (60000 / pulse_bpm);
-            step = (2.0 * M_PI) / (ms_per_beat / 20.0);
-
-            last_request_time = current_time;
+            generation = backend_discovery_generation();
+            ESP_LOGI(TAG, "Backend moved, polling %s", url);
+            tempo_client_set_url(&tempo_client, url);
+            backend_discovery_url(events_path, url, sizeof(url));
+            event_stream_set_url(&led_events, url);
         }
 
-        // --- Same Animation Logic ---
-        float brightness = (sinf(angle) + 1.0f) / 2.0f;
-        uint32_t blue_val = (uint32_t)(200 * brightness);
+        // The poll seeds the state and the clock offset before any push arrives
+        ESP_LOGI(TAG, "Refreshing Pulse BPM...");
+        uint32_t wait_ms = poll_led_state();
 
-        for (int i = 0; i < LED_STRIP_LED_NUM; i++)
+        if ((int32_t)(xTaskGetTickCount() - next_push_try) >= 0)
         {
-            led_strip_set_pixel(led_strip, i, 0, 0, blue_val);
+            if (follow_led_events())
+            {
+                // Dropped stream: reconnect soon but not in a tight loop
+                wait_ms = STREAM_RETRY_MS;
+            }
+            else
+            {
+                // Older backend (or unreachable): adaptive polling for a while
+                next_push_try = xTaskGetTickCount() + pdMS_TO_TICKS(PUSH_RETRY_MS);
+            }
         }
-
-        led_strip_refresh(led_strip);
-
-        angle += step;
-        if (angle > 2.0 * M_PI)
-        {
-            angle -= 2.0 * M_PI;
-        }
-
-        vTaskDelay(pdMS_TO_TICKS(20));
+        vTaskDelay(pdMS_TO_TICKS(wait_ms));
     }
 }
 
-extern "C" void app_main(void)
+#if LED_ESPNOW
+// The latest ESP-NOW beat as a TempMood, if there is a fresh one from a
+// wearer in step. Each step is a beat: the grid is the footsteps themselves,
+// so the pulse peaks as the foot lands. A wearer standing still still
+// broadcasts (at rest BPM, no confidence); that is left to the backend.
+static bool direct_led_state(TempMood *state)
 {
-    // WIFI
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    espnow_beat_t beat;
+    bool found = follow_device_id != 0 ? espnow_link_get(follow_device_id, &beat) : espnow_link_group(&beat);
+    if (!found || beat.confidence < ESPNOW_MIN_CONFIDENCE || beat.last_step_us == 0 ||
+        esp_timer_get_time() - beat.last_step_us > ESPNOW_STEP_RECENT_MS * 1000LL ||
+        beat.bpm_milli < LED_BEAT_MBPM_MIN || beat.bpm_milli > LED_BEAT_MBPM_MAX)
     {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+        return false;
     }
-    ESP_ERROR_CHECK(ret);
 
-    // 2. Initialize TCP/IP and Event Loop
-    ESP_ERROR_CHECK(esp_netif_init());
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_t *sta_netif = esp_netif_create_default_wifi_sta();
-    // esp_netif_create_default_wifi_sta();
+    *state = TempMood{};
+    state->tempo = (int)((beat.bpm_milli + 500) / 1000);
+    state->mood = beat.mood > 0 && beat.mood < MOOD_COUNT ? (int)beat.mood : MOOD_NEUTRAL;
+    state->beat_mbpm = beat.bpm_milli;
+    state->beat_us = beat.last_step_us;
+    return true;
+}
+#endif
 
-    // 3. Wi-Fi Configuration
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+// Single render loop for every effect. A mood change only swaps the
+// engine's active slot, so the task, its timing and the beat phase carry on.
+// Frame budget: effect rendering, and present (waiting out the previous
+// frame's transmission, then starting this one)
+PERF_TIMER(render_timer, "render");
+PERF_TIMER(present_timer, "present");
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = "MIT",
-            .password = "RxS1T7_)hP",
-        },
-    };
+void led_effect_task(void *pvParameters)
+{
+    // Set up from here, on the real-time core: each RMT channel's interrupt
+    // lands on the core that created it, away from the Wi-Fi stack
+    ESP_ERROR_CHECK(led_frame_set_init(&led_frames, strip_configs, LED_STRIP_COUNT));
+    ESP_LOGI(TAG, "Created %d LED strip(s), %u LEDs total, with RMT backend", led_frames.count, (unsigned)led_frames.total_leds);
+
+#if RUN_KERNEL_BENCHMARK
+    kernel_run_benchmark();
+#endif
+
+    effect_engine.init(&led_frames);
+    effect_engine.bind_strip(0, strip1_effects);
+#if CONFIG_LED_STRIP_COUNT >= 2
+    effect_engine.bind_strip(1, strip2_effects);
+#endif
+#if CONFIG_LED_STRIP_COUNT >= 3
+    effect_engine.bind_strip(2, strip3_effects);
+#endif
+#if CONFIG_LED_STRIP_COUNT >= 4
+    effect_engine.bind_strip(3, strip4_effects);
+#endif
+
+    ESP_LOGI(TAG, "Starting effect engine...");
+    perf_watch_task(NULL);
+
+    FrameScheduler sched;
+    frame_scheduler_init(&sched, FRAME_PERIOD_MS);
+
+    // Fixed-point beat phase advanced by the real time between frames
+    BeatPhase phase;
+    beat_phase_init(&phase, frame_scheduler_elapsed_us(&sched));
+
+    int mood = MOOD_NEUTRAL;
+    TempMood grid = {};
+    bool mark_frame = false; // this frame is the first at a new BPM: report it to /trace
+#if LED_ESPNOW
+    bool direct = false;
+#endif
 
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    while (1)
+    {
+        int64_t now_us = frame_scheduler_elapsed_us(&sched);
+
+        // Never blocks: the network task publishes into the mailbox on its own schedule
+        TempMood latest;
+        bool published = xQueuePeek(tempo_mailbox, &latest, 0) == pdTRUE;
+#if LED_ESPNOW
+        // The player's grid is the music's own beat: keep it over the footsteps
+        bool found = !(published && latest.player_grid) && direct_led_state(&latest);
+        if (found != direct)
+        {
+            direct = found;
+            ESP_LOGI(TAG, "Following %s", direct ? "the ESP-NOW beat" : "the backend");
+        }
+        if (direct || published)
+#else
+        if (published)
+#endif
+        {
+            if (latest.tempo != pulse_bpm)
+            {
+                pulse_bpm = latest.tempo;
+                mark_frame = latest.traced && latest.clock_valid;
+                ESP_LOGI(TAG, "Applying Pulse BPM %d", pulse_bpm);
+            }
+            if (latest.mood != mood)
+            {
+                mood = latest.mood;
+                effect_engine.select_mood(mood);
+            }
+            grid = latest;
+        }
 
-    // 4. Start!
-    ESP_ERROR_CHECK(esp_wifi_start());
-    esp_wifi_connect();
+        // Follow the backend's beat grid when there is one, else free-run on the BPM
+        if (grid.beat_mbpm > 0)
+        {
+            beat_phase_lock(&phase, now_us, grid.beat_mbpm, grid.beat_us - sched.start_us);
+        }
+        else
+        {
+            beat_phase_advance(&phase, now_us, pulse_bpm);
+        }
 
-    // 1. Wait here indefinitely until notified by the event_handler
-    printf("Waiting for IP...\n");
-    esp_netif_ip_info_t ip_info;
+        EffectContext ctx = {
+            .t_us = now_us,
+            .bpm = (uint32_t)pulse_bpm,
+            .mood = mood,
+            .beat = &phase,
+            .led_offset = 0,
+        };
+        PERF_SCOPE(render_timer)
+        {
+            effect_engine.render(ctx);
+        }
+        PERF_SCOPE(present_timer)
+        {
+            led_frame_set_present(&led_frames);
+        }
+        if (mark_frame)
+        {
+            // Render until the frame starts going out on the wire, in backend time
+            int64_t start_us = sched.start_us + now_us;
+            trace_report_mark(grid.trace, "led_frame", start_us + grid.clock_offset_us,
+                              esp_timer_get_time() - start_us);
+            mark_frame = false;
+        }
 
-    // This loop simply asks the system "Do we have an IP?" every 500ms
-    while (esp_netif_get_ip_info(sta_netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0)
-    {
-        vTaskDelay(pdMS_TO_TICKS(500));
+        frame_scheduler_wait(&sched);
     }
+}
 
-    // 2. SUCCESS! The code only reaches this line once you have an IP.
-    printf("IP Received! Connecting to my server...\n");
+// Task stacks are static, in bytes. /telemetry reports each one's free bytes
+// at its deepest point so far ("stacks"); trim against that, keeping a margin
+// for paths a short run doesn't hit (reconnects, OTA).
+#define NETWORK_STACK_SIZE 4096
+#define EFFECT_STACK_SIZE 4096
+
+static StackType_t network_stack[NETWORK_STACK_SIZE];
+static StaticTask_t network_tcb;
+static StackType_t effect_stack[EFFECT_STACK_SIZE];
+static StaticTask_t effect_tcb;
 
-    led_strip_config_t strip_config = {
-        .strip_gpio_num = LED_STRIP_BLINK_GPIO,
-        .max_leds = LED_STRIP_LED_NUM,
-        .led_model = LED_MODEL_WS2812,
-        .color_component_format = LED_STRIP_COLOR_COMPONENT_FMT_GRB, // Fixed field name and enum
-        .flags = {
-            .invert_out = false,
-        }};
-
-    /* 2. RMT Specific Configuration (Required for ESP32-C6) */
-    led_strip_rmt_config_t rmt_config = {
-        .clk_src = RMT_CLK_SRC_DEFAULT,
-        .resolution_hz = LED_STRIP_RMT_RES_HZ,
-        .flags = {
-            .with_dma = false, // Set to true if using many LEDs (e.g. >100)
-        }};
-
-    /* 3. Initialize the Device */
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
-    ESP_LOGI(TAG, "Created LED strip object with RMT backend");
-
-    int reply = make_temp_request();
-    pulse_bpm = reply;
-    /* 4. Start the Animation Task */
-    // xTaskCreate(led_rainbow_task, "led_rainbow_task", 4096, NULL, 5, NULL);
-    xTaskCreate(led_pulse_task, "led_pulse_task", 4096, NULL, 5, NULL);
+extern "C" void app_main(void)
+{
+    ESP_ERROR_CHECK(node_config_load(tunables, sizeof(tunables) / sizeof(tunables[0])));
+    pulse_bpm = start_bpm;
+    last_good_state.tempo = start_bpm;
+
+    // Wi-Fi (cached AP, reconnects on its own)
+    wifi_connect_config_t wifi_config = WIFI_CONNECT_CONFIG_DEFAULT();
+#if LED_ESPNOW
+    wifi_config.power_save = WIFI_PS_NONE;
+#endif
+    ESP_ERROR_CHECK(wifi_connect_start(&wifi_config));
+#if LED_ESPNOW
+    ESP_ERROR_CHECK(espnow_link_init());
+    follow_device_id = (uint32_t)strtoul(follow_device, NULL, 16);
+#endif
+
+    clock_sync_init(&backend_clock);
+    json_arena_init(&led_json, led_json_buf, sizeof(led_json_buf));
+    tempo_mailbox = xQueueCreateStatic(1, sizeof(TempMood), tempo_mailbox_storage, &tempo_mailbox_queue);
+
+    /* 3. Start the Network and Animation Tasks. Rendering runs above
+       networking, pinned to the real-time core (the only core on the C6,
+       where the priority alone keeps a frame from waiting on a request). */
+    xTaskCreateStaticPinnedToCore(tempo_network_task, "tempo_network_task", NETWORK_STACK_SIZE, NULL,
+                                  TASK_PRIO_NETWORK, network_stack, &network_tcb, TASK_CORE_NETWORK);
+    xTaskCreateStaticPinnedToCore(led_effect_task, "led_effect_task", EFFECT_STACK_SIZE, NULL, TASK_PRIO_REALTIME,
+                                  effect_stack, &effect_tcb, TASK_CORE_REALTIME);
 }
\ No newline at end of file
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+
+// Integer-only building blocks for the pulse effect.
+//
+// PULSE_LUT maps a beat phase to a gamma-corrected brightness:
+//   PULSE_LUT[i] = 255 * ((sin(2*pi * i / 256) + 1) / 2) ^ PULSE_GAMMA
+// It is generated at compile time, so no float or double math runs on the
+// device (the ESP32-C6 has no FPU at all).
+//
+// BeatPhase is a fixed-point accumulator where one beat is BEAT_PHASE_UNITS.
+// Advancing by dt_us * bpm each frame is exact, so the phase never drifts over
+// long tracks and a BPM change keeps the phase continuous automatically.
+// The pulse rate doesn't jump either: a new free-running BPM is reached by a
+// linear ramp lasting TEMPO_SLEW_BEATS beats.
+//
+// beat_phase_lock() additionally steers the phase onto an external beat grid
+// (the music's), slewing tempo and phase so corrections are never a visible jump.
+
+#define PULSE_LUT_SIZE 256
+#define PULSE_GAMMA 2.2
+#define BEAT_PHASE_UNITS 60000000u // one beat, in BPM * microseconds
+#define BEAT_PHASE_MAX_STEP_US 1000000 // longer stalls are clamped so a hiccup never skips whole beats
+#define BEAT_LOCK_PEAK_PHASE (BEAT_PHASE_UNITS / 4) // PULSE_LUT peaks a quarter into the phase
+#define BEAT_LOCK_MAX_CORRECTION 8 // phase pull per frame, as 1/N of the frame's advance (+-12.5% tempo)
+#define BEAT_LOCK_SLEW_MBPM_PER_S 20000 // tempo changes ramp by at most 20 BPM per second
+#define TEMPO_SLEW_BEATS 4 // free-running tempo changes are spread over this many beats
+
+namespace pulse_math_detail
+{
+constexpr double kPi = 3.14159265358979323846;
+constexpr double kLn2 = 0.69314718055994530942;
+
+// sin() on [-pi, pi] via its Taylor series; plenty for an 8-bit table
+constexpr double cx_sin(double x)
+{
+    while (x > kPi)
+        x -= 2 * kPi;
+    while (x < -kPi)
+        x += 2 * kPi;
+    double term = x, sum = x;
+    for (int n = 1; n < 12; n++)
+    {
+        term *= -x * x / ((2 * n) * (2 * n + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+// ln(x) for x > 0: scale into [0.5, 1) then use the atanh series
+constexpr double cx_log(double x)
+{
+    int k = 0;
+    while (x < 0.5)
+    {
+        x *= 2;
+        k--;
+    }
+    while (x >= 1.0)
+    {
+        x /= 2;
+        k++;
+    }
+    double y = (x - 1) / (x + 1), y2 = y * y, term = y, sum = 0;
+    for (int n = 1; n < 40; n += 2)
+    {
+        sum += term / n;
+        term *= y2;
+    }
+    return 2 * sum + k * kLn2;
+}
+
+// exp(x): series on |x| <= 1, then square back up
+constexpr double cx_exp(double x)
+{
+    if (x < 0)
+        return 1 / cx_exp(-x);
+    int k = 0;
+    while (x > 1)
+    {
+        x /= 2;
+        k++;
+    }
+    double term = 1, sum = 1;
+    for (int n = 1; n < 20; n++)
+    {
+        term *= x / n;
+        sum += term;
+    }
+    while (k-- > 0)
+        sum *= sum;
+    return sum;
+}
+
+constexpr double cx_pow(double base, double e)
+{
+    return base <= 0 ? 0 : cx_exp(e * cx_log(base));
+}
+
+constexpr std::array<uint8_t, PULSE_LUT_SIZE> make_pulse_lut()
+{
+    std::array<uint8_t, PULSE_LUT_SIZE> lut{};
+    for (int i = 0; i < PULSE_LUT_SIZE; i++)
+    {
+        double level = (cx_sin(2 * kPi * i / PULSE_LUT_SIZE) + 1) / 2;
+        double value = 255 * cx_pow(level, PULSE_GAMMA) + 0.5;
+        lut[i] = (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+    return lut;
+}
+} // namespace pulse_math_detail
+
+inline constexpr std::array<uint8_t, PULSE_LUT_SIZE> PULSE_LUT = pulse_math_detail::make_pulse_lut();
+
+static_assert(PULSE_LUT[PULSE_LUT_SIZE / 4] == 255, "peak of the sine must be full brightness");
+static_assert(PULSE_LUT[3 * PULSE_LUT_SIZE / 4] == 0, "trough of the sine must be off");
+
+typedef struct
+{
+    uint32_t acc;    // position within the current beat, [0, BEAT_PHASE_UNITS)
+    int64_t last_us; // timestamp of the previous advance
+    uint32_t mbpm;   // tempo currently applied, in milli-BPM; 0 before the first advance
+    uint32_t slew_target_mbpm; // free-running tempo being ramped to
+    uint32_t slew_mbpm_per_s;  // ramp rate that gets there in TEMPO_SLEW_BEATS beats
+} BeatPhase;
+
+inline void beat_phase_init(BeatPhase *phase, int64_t now_us)
+{
+    phase->acc = 0;
+    phase->last_us = now_us;
+    phase->mbpm = 0;
+    phase->slew_target_mbpm = 0;
+    phase->slew_mbpm_per_s = 0;
+}
+
+inline void beat_phase_advance(BeatPhase *phase, int64_t now_us, uint32_t bpm)
+{
+    int64_t dt_us = now_us - phase->last_us;
+    phase->last_us = now_us;
+    if (dt_us <= 0 || bpm == 0)
+        return;
+    if (dt_us > BEAT_PHASE_MAX_STEP_US)
+        dt_us = BEAT_PHASE_MAX_STEP_US;
+
+    uint32_t target = bpm * 1000;
+    if (phase->mbpm == 0)
+        phase->mbpm = target;
+    if (target != phase->slew_target_mbpm)
+    {
+        // N beats at the current tempo last N * 60000 / mbpm seconds
+        uint32_t span = target > phase->mbpm ? target - phase->mbpm : phase->mbpm - target;
+        phase->slew_target_mbpm = target;
+        phase->slew_mbpm_per_s = (uint32_t)((uint64_t)span * phase->mbpm / (TEMPO_SLEW_BEATS * 60000ull)) + 1;
+    }
+
+    int64_t max_slew = dt_us * phase->slew_mbpm_per_s / 1000000 + 1;
+    int64_t tempo_err = (int64_t)target - phase->mbpm;
+    if (tempo_err > max_slew)
+        tempo_err = max_slew;
+    if (tempo_err < -max_slew)
+        tempo_err = -max_slew;
+    phase->mbpm += tempo_err;
+
+    phase->acc = (uint32_t)((phase->acc + dt_us * phase->mbpm / 1000) % BEAT_PHASE_UNITS);
+}
+
+// Advance towards a beat grid: beats fall at ref_us + k * 60e9 / grid_mbpm.
+// The applied tempo ramps to grid_mbpm, then the remaining phase error is
+// pulled in by at most 1/BEAT_LOCK_MAX_CORRECTION of each frame's advance,
+// so the pulse peaks on the grid's beats without ever jumping.
+inline void beat_phase_lock(BeatPhase *phase, int64_t now_us, uint32_t grid_mbpm, int64_t ref_us)
+{
+    int64_t dt_us = now_us - phase->last_us;
+    phase->last_us = now_us;
+    if (dt_us <= 0 || grid_mbpm == 0)
+        return;
+    if (dt_us > BEAT_PHASE_MAX_STEP_US)
+        dt_us = BEAT_PHASE_MAX_STEP_US;
+
+    // Tempo slew
+    phase->slew_target_mbpm = 0; // a later free-run ramps from wherever this leaves mbpm
+    if (phase->mbpm == 0)
+        phase->mbpm = grid_mbpm;
+    int64_t max_slew = dt_us * BEAT_LOCK_SLEW_MBPM_PER_S / 1000000;
+    int64_t tempo_err = (int64_t)grid_mbpm - phase->mbpm;
+    if (tempo_err > max_slew)
+        tempo_err = max_slew;
+    if (tempo_err < -max_slew)
+        tempo_err = -max_slew;
+    phase->mbpm += tempo_err;
+
+    const int64_t units = BEAT_PHASE_UNITS;
+    int64_t step = dt_us * phase->mbpm / 1000;
+    int64_t acc = (phase->acc + step) % units;
+
+    // Where the grid says the phase should be now
+    int64_t target = ((now_us - ref_us) * grid_mbpm / 1000 + BEAT_LOCK_PEAK_PHASE) % units;
+    if (target < 0)
+        target += units;
+
+    // Shortest way round, then limit the pull
+    int64_t err = target - acc;
+    if (err >= units / 2)
+        err -= units;
+    if (err < -units / 2)
+        err += units;
+    int64_t max_pull = step / BEAT_LOCK_MAX_CORRECTION;
+    if (err > max_pull)
+        err = max_pull;
+    if (err < -max_pull)
+        err = -max_pull;
+
+    acc = (acc + err + units) % units;
+    phase->acc = (uint32_t)acc;
+}
+
+// Scale an 8-bit LUT level to [0, peak]
+inline uint32_t pulse_brightness(const BeatPhase *phase, uint32_t peak)
+{
+    uint32_t index = phase->acc / (BEAT_PHASE_UNITS / PULSE_LUT_SIZE);
+    return (PULSE_LUT[index] * (peak + 1)) >> 8;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// How long to wait before the next /led_state poll, when the backend can't
+// push (see follow_led_events() in main.cpp).
+//
+// A tempo change (or a failed/low-quality answer the backend flags with a
+// short "refresh_ms" hint) drops the interval to REFRESH_MIN_MS, so a switch
+// from walking to running is picked up within half a second. Every poll that
+// finds the tempo steady doubles it, up to REFRESH_MAX_MS, so a wearer
+// holding one pace costs one request per 10 s as before. A backend hint,
+// when present, replaces the interval the device would have picked.
+
+#define REFRESH_MIN_MS 500
+#define REFRESH_MAX_MS 10000
+#define REFRESH_CHANGE_BPM 2 // smaller moves count as steady
+
+typedef struct
+{
+    uint32_t interval_ms;
+    int last_tempo; // 0 before the first good poll
+} RefreshPolicy;
+
+inline void refresh_policy_init(RefreshPolicy *policy)
+{
+    policy->interval_ms = REFRESH_MIN_MS;
+    policy->last_tempo = 0;
+}
+
+inline uint32_t refresh_policy_clamp(uint32_t ms)
+{
+    return ms < REFRESH_MIN_MS ? REFRESH_MIN_MS : ms > REFRESH_MAX_MS ? REFRESH_MAX_MS : ms;
+}
+
+// After a good poll; hint_ms is the backend's suggestion, 0 for none
+inline uint32_t refresh_policy_update(RefreshPolicy *policy, int tempo, uint32_t hint_ms)
+{
+    int delta = tempo - policy->last_tempo;
+    bool changed = policy->last_tempo == 0 || delta >= REFRESH_CHANGE_BPM || delta <= -REFRESH_CHANGE_BPM;
+    policy->last_tempo = tempo;
+
+    if (hint_ms > 0)
+        policy->interval_ms = refresh_policy_clamp(hint_ms);
+    else if (changed)
+        policy->interval_ms = REFRESH_MIN_MS;
+    else
+        policy->interval_ms = refresh_policy_clamp(policy->interval_ms * 2);
+    return policy->interval_ms;
+}
+
+// After a failed poll: back off as if steady, so a down backend isn't hammered
+inline uint32_t refresh_policy_failed(RefreshPolicy *policy)
+{
+    policy->interval_ms = refresh_policy_clamp(policy->interval_ms * 2);
+    return policy->interval_ms;
+}
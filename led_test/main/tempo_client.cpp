@@ -0,0 +1,146 @@
+#include "tempo_client.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "perf_counters.h"
+
+static const char *TAG = "TEMPO_CLIENT";
+
+static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
+{
+    TempoClient *client = (TempoClient *)evt->user_data;
+
+    switch (evt->event_id)
+    {
+    case HTTP_EVENT_ON_CONNECTED:
+        client->stats.connects++;
+        break;
+    case HTTP_EVENT_ON_DATA:
+        // Only copy if it fits (to prevent overflow). Once a chunk has been
+        // dropped the rest is ignored too, so the body is never spliced.
+        if (!client->truncated && client->body_len + evt->data_len < TEMPO_CLIENT_BODY_MAX)
+        {
+            memcpy(client->body + client->body_len, evt->data, evt->data_len);
+            client->body_len += evt->data_len;
+            client->body[client->body_len] = '\0'; // Keep it null-terminated
+        }
+        else
+        {
+            client->truncated = true;
+        }
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+esp_err_t tempo_client_init(TempoClient *client, const char *url)
+{
+    memset(client, 0, sizeof(*client));
+    client->stats.min_us = INT64_MAX;
+
+    esp_http_client_config_t config = {};
+    config.url = url;
+    config.method = HTTP_METHOD_GET;
+    config.timeout_ms = TEMPO_CLIENT_TIMEOUT_MS;
+    config.event_handler = _http_event_handler;
+    config.user_data = client;
+    config.keep_alive_enable = true;
+
+    client->handle = esp_http_client_init(&config);
+    if (client->handle == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create HTTP client for %s", url);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t tempo_client_set_url(TempoClient *client, const char *url)
+{
+    esp_http_client_close(client->handle);
+    return esp_http_client_set_url(client->handle, url);
+}
+
+PERF_TIMER(http_get_timer, "http_get");
+
+static esp_err_t tempo_client_perform(TempoClient *client)
+{
+    client->body_len = 0;
+    client->body[0] = '\0'; // Clear buffer before starting
+    client->truncated = false;
+
+    esp_err_t err;
+    PERF_SCOPE(http_get_timer)
+    {
+        err = esp_http_client_perform(client->handle);
+    }
+    if (err == ESP_OK && esp_http_client_get_status_code(client->handle) != 200)
+    {
+        err = ESP_FAIL;
+    }
+    return err;
+}
+
+esp_err_t tempo_client_get(TempoClient *client)
+{
+    int64_t start = esp_timer_get_time();
+
+    esp_err_t err = tempo_client_perform(client);
+    if (err != ESP_OK)
+    {
+        // The backend (or its keep-alive timeout) dropped the socket.
+        // Throw the stale connection away and try once on a fresh one.
+        ESP_LOGW(TAG, "Request failed (%s), reconnecting", esp_err_to_name(err));
+        esp_http_client_close(client->handle);
+        err = tempo_client_perform(client);
+    }
+
+    if (err != ESP_OK)
+    {
+        esp_http_client_close(client->handle);
+        client->stats.failures++;
+        return err;
+    }
+    if (client->truncated)
+    {
+        ESP_LOGW(TAG, "Response longer than %d bytes, ignored", TEMPO_CLIENT_BODY_MAX - 1);
+        client->body[0] = '\0';
+        client->body_len = 0;
+        client->stats.rejected++;
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    int64_t elapsed = esp_timer_get_time() - start;
+    TempoClientStats *stats = &client->stats;
+    stats->requests++;
+    stats->last_us = elapsed;
+    stats->total_us += elapsed;
+    if (elapsed < stats->min_us)
+        stats->min_us = elapsed;
+    if (elapsed > stats->max_us)
+        stats->max_us = elapsed;
+    return ESP_OK;
+}
+
+void tempo_client_log_stats(const TempoClient *client)
+{
+    const TempoClientStats *stats = &client->stats;
+    if (stats->requests == 0)
+    {
+        ESP_LOGI(TAG, "No successful requests yet (%lu failures)", (unsigned long)stats->failures);
+        return;
+    }
+
+    ESP_LOGI(TAG, "requests=%lu failures=%lu rejected=%lu connects=%lu latency last=%lldus min=%lldus avg=%lldus max=%lldus",
+             (unsigned long)stats->requests,
+             (unsigned long)stats->failures,
+             (unsigned long)stats->rejected,
+             (unsigned long)stats->connects,
+             stats->last_us,
+             stats->min_us,
+             stats->total_us / stats->requests,
+             stats->max_us);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_client.h"
+
+// Long-lived HTTP client for the backend's /led_state endpoint.
+// Created once in app_main and reused for every poll so the TCP
+// connection stays open (HTTP keep-alive) between BPM refreshes.
+
+#define TEMPO_CLIENT_BODY_MAX 192 // a full /led_state object with refresh_ms and trace
+#define TEMPO_CLIENT_TIMEOUT_MS 2000
+
+typedef struct
+{
+    uint32_t requests;   // successful round trips
+    uint32_t failures;   // round trips that failed even after a reconnect
+    uint32_t rejected;   // responses too long for body, the caller's value kept
+    uint32_t connects;   // TCP connections opened; stays at 1 while keep-alive holds
+    int64_t last_us;     // latency of the most recent successful request
+    int64_t min_us;
+    int64_t max_us;
+    int64_t total_us; // sum over all successful requests, for the average
+} TempoClientStats;
+
+typedef struct
+{
+    esp_http_client_handle_t handle;
+    char body[TEMPO_CLIENT_BODY_MAX];
+    int body_len;
+    bool truncated; // the response didn't fit in body
+    TempoClientStats stats;
+} TempoClient;
+
+esp_err_t tempo_client_init(TempoClient *client, const char *url);
+
+// Point the client at a different backend; the open connection is dropped
+esp_err_t tempo_client_set_url(TempoClient *client, const char *url);
+
+// Perform a GET; the response is left null-terminated in client->body.
+// On a broken connection the socket is closed and the request retried once.
+// A body longer than TEMPO_CLIENT_BODY_MAX is ESP_ERR_INVALID_SIZE, never a
+// truncated prefix that might still parse.
+esp_err_t tempo_client_get(TempoClient *client);
+
+void tempo_client_log_stats(const TempoClient *client);
@@ -0,0 +1,113 @@
+#include "trace_report.h"
+
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "backend_discovery.h"
+#include "task_placement.h"
+
+static const char *TAG = "TRACE";
+
+#define URL_MAX 64
+#define REPORT_MAX (48 + TRACE_REPORT_QUEUE_LEN * 96)
+#define REPORT_STACK_SIZE 3072
+
+typedef struct
+{
+    uint32_t trace;
+    const char *name;
+    int64_t server_us;
+    int64_t dur_us;
+} TraceMark;
+
+static QueueHandle_t s_marks;
+static StaticQueue_t s_marks_queue;
+static uint8_t s_marks_storage[TRACE_REPORT_QUEUE_LEN * sizeof(TraceMark)];
+static char s_report[REPORT_MAX];
+static StackType_t s_report_stack[REPORT_STACK_SIZE];
+static StaticTask_t s_report_tcb;
+
+void trace_report_mark(uint32_t trace, const char *name, int64_t server_us, int64_t dur_us)
+{
+    if (s_marks == NULL)
+    {
+        return;
+    }
+    TraceMark mark = {trace, name, server_us, dur_us};
+    xQueueSend(s_marks, &mark, 0);
+}
+
+// {"node": ..., "events": [{"trace", "name", "server_us", "dur_us"}, ...]}
+// for the first mark and whatever else is already queued. -1 if it doesn't fit.
+static int build_report(const char *node, const TraceMark *first)
+{
+    int len = snprintf(s_report, sizeof(s_report), "{\"node\":\"%s\",\"events\":[", node);
+    TraceMark mark = *first;
+    bool more = true;
+    for (int i = 0; more && len < (int)sizeof(s_report); i++)
+    {
+        len += snprintf(s_report + len, sizeof(s_report) - len,
+                        "%s{\"trace\":%lu,\"name\":\"%s\",\"server_us\":%lld,\"dur_us\":%lld}",
+                        i ? "," : "", (unsigned long)mark.trace, mark.name, mark.server_us, mark.dur_us);
+        more = i + 1 < TRACE_REPORT_QUEUE_LEN && xQueueReceive(s_marks, &mark, 0) == pdTRUE;
+    }
+    if (len < (int)sizeof(s_report))
+    {
+        len += snprintf(s_report + len, sizeof(s_report) - len, "]}");
+    }
+    return len < (int)sizeof(s_report) ? len : -1;
+}
+
+static void report_task(void *arg)
+{
+    const char *node = (const char *)arg;
+
+    // Kept open between reports, re-pointed if the backend moves
+    char url[URL_MAX];
+    backend_discovery_url(TRACE_REPORT_PATH, url, sizeof(url));
+    uint32_t generation = backend_discovery_generation();
+    esp_http_client_config_t config = {};
+    config.url = url;
+    config.method = HTTP_METHOD_POST;
+    config.timeout_ms = 2000;
+    config.keep_alive_enable = true;
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+
+    while (1)
+    {
+        TraceMark first;
+        xQueueReceive(s_marks, &first, portMAX_DELAY);
+        int len = build_report(node, &first);
+        if (len < 0)
+        {
+            ESP_LOGW(TAG, "Trace report larger than %d bytes, dropped", REPORT_MAX);
+            continue;
+        }
+
+        backend_discovery_url(TRACE_REPORT_PATH, url, sizeof(url));
+        if (backend_discovery_generation() != generation)
+        {
+            generation = backend_discovery_generation();
+            esp_http_client_set_url(client, url);
+        }
+        esp_http_client_set_post_field(client, s_report, len);
+        esp_err_t err = esp_http_client_perform(client);
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG, "Trace post failed: %s", esp_err_to_name(err));
+            esp_http_client_close(client); // reconnect on the next report
+        }
+    }
+}
+
+esp_err_t trace_report_start(const char *node)
+{
+    s_marks = xQueueCreateStatic(TRACE_REPORT_QUEUE_LEN, sizeof(TraceMark), s_marks_storage, &s_marks_queue);
+    xTaskCreateStaticPinnedToCore(report_task, "trace_report", REPORT_STACK_SIZE, (void *)node, TASK_PRIO_BACKGROUND,
+                                  s_report_stack, &s_report_tcb, TASK_CORE_NETWORK);
+    return ESP_OK;
+}
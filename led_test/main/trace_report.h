@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Latency trace marks for the backend's GET /trace.
+//
+// A mark is a span on this node's timeline in backend time, tagged with the
+// trace flow (the "trace" of /led_state) it belongs to. Marks are queued without
+// blocking (the render task must never wait on the network) and a low
+// priority task POSTs them to /trace in small batches. When the queue is
+// full the mark is dropped; the trace just misses that point.
+
+#define TRACE_REPORT_QUEUE_LEN 8
+#define TRACE_REPORT_PATH "/trace"
+
+esp_err_t trace_report_start(const char *node);
+
+// name must be a string literal (only the pointer is queued)
+void trace_report_mark(uint32_t trace, const char *name, int64_t server_us, int64_t dur_us);
@@ -0,0 +1,142 @@
+#include "ws2812_encoder.h"
+
+#include <stdlib.h>
+#include "esp_check.h"
+
+static const char *TAG = "WS2812_ENC";
+
+#define WS2812_T0H_NS 300
+#define WS2812_T0L_NS 900
+#define WS2812_T1H_NS 900
+#define WS2812_T1L_NS 300
+#define WS2812_RESET_US 50
+
+typedef struct
+{
+    rmt_encoder_t base;
+    rmt_encoder_t *bytes_encoder; // GRB payload
+    rmt_encoder_t *copy_encoder;  // reset code
+    int state;
+    rmt_symbol_word_t reset_code;
+} ws2812_encoder_t;
+
+static size_t ws2812_encode(rmt_encoder_t *encoder, rmt_channel_handle_t channel,
+                            const void *primary_data, size_t data_size, rmt_encode_state_t *ret_state)
+{
+    ws2812_encoder_t *ws2812 = __containerof(encoder, ws2812_encoder_t, base);
+    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
+    rmt_encode_state_t state = RMT_ENCODING_RESET;
+    size_t encoded_symbols = 0;
+
+    switch (ws2812->state)
+    {
+    case 0: // send GRB data
+        encoded_symbols += ws2812->bytes_encoder->encode(ws2812->bytes_encoder, channel,
+                                                         primary_data, data_size, &session_state);
+        if (session_state & RMT_ENCODING_COMPLETE)
+        {
+            ws2812->state = 1;
+        }
+        if (session_state & RMT_ENCODING_MEM_FULL)
+        {
+            state |= RMT_ENCODING_MEM_FULL;
+            goto out; // yield until the RMT memory has room again
+        }
+    // fall-through
+    case 1: // send reset code
+        encoded_symbols += ws2812->copy_encoder->encode(ws2812->copy_encoder, channel, &ws2812->reset_code,
+                                                        sizeof(ws2812->reset_code), &session_state);
+        if (session_state & RMT_ENCODING_COMPLETE)
+        {
+            ws2812->state = RMT_ENCODING_RESET;
+            state |= RMT_ENCODING_COMPLETE;
+        }
+        if (session_state & RMT_ENCODING_MEM_FULL)
+        {
+            state |= RMT_ENCODING_MEM_FULL;
+            goto out;
+        }
+    }
+out:
+    *ret_state = state;
+    return encoded_symbols;
+}
+
+static esp_err_t ws2812_del(rmt_encoder_t *encoder)
+{
+    ws2812_encoder_t *ws2812 = __containerof(encoder, ws2812_encoder_t, base);
+    rmt_del_encoder(ws2812->bytes_encoder);
+    rmt_del_encoder(ws2812->copy_encoder);
+    free(ws2812);
+    return ESP_OK;
+}
+
+static esp_err_t ws2812_reset(rmt_encoder_t *encoder)
+{
+    ws2812_encoder_t *ws2812 = __containerof(encoder, ws2812_encoder_t, base);
+    rmt_encoder_reset(ws2812->bytes_encoder);
+    rmt_encoder_reset(ws2812->copy_encoder);
+    ws2812->state = RMT_ENCODING_RESET;
+    return ESP_OK;
+}
+
+// Convert nanoseconds to RMT ticks at the channel resolution
+static uint16_t ns_to_ticks(uint32_t resolution_hz, uint32_t ns)
+{
+    return (uint16_t)((uint64_t)resolution_hz * ns / 1000000000ULL);
+}
+
+esp_err_t ws2812_new_encoder(uint32_t resolution_hz, rmt_encoder_handle_t *ret_encoder)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(ret_encoder, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    ws2812_encoder_t *ws2812 = calloc(1, sizeof(ws2812_encoder_t));
+    ESP_RETURN_ON_FALSE(ws2812, ESP_ERR_NO_MEM, TAG, "no mem for ws2812 encoder");
+    ws2812->base.encode = ws2812_encode;
+    ws2812->base.del = ws2812_del;
+    ws2812->base.reset = ws2812_reset;
+
+    rmt_bytes_encoder_config_t bytes_config = {
+        .bit0 = {
+            .duration0 = ns_to_ticks(resolution_hz, WS2812_T0H_NS),
+            .level0 = 1,
+            .duration1 = ns_to_ticks(resolution_hz, WS2812_T0L_NS),
+            .level1 = 0,
+        },
+        .bit1 = {
+            .duration0 = ns_to_ticks(resolution_hz, WS2812_T1H_NS),
+            .level0 = 1,
+            .duration1 = ns_to_ticks(resolution_hz, WS2812_T1L_NS),
+            .level1 = 0,
+        },
+        .flags.msb_first = 1, // WS2812 expects G7...G0 R7...R0 B7...B0
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_bytes_encoder(&bytes_config, &ws2812->bytes_encoder), err, TAG, "create bytes encoder failed");
+
+    rmt_copy_encoder_config_t copy_config = {};
+    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_config, &ws2812->copy_encoder), err, TAG, "create copy encoder failed");
+
+    uint16_t reset_ticks = ns_to_ticks(resolution_hz, WS2812_RESET_US * 1000) / 2;
+    ws2812->reset_code = (rmt_symbol_word_t){
+        .duration0 = reset_ticks,
+        .level0 = 0,
+        .duration1 = reset_ticks,
+        .level1 = 0,
+    };
+
+    *ret_encoder = &ws2812->base;
+    return ESP_OK;
+
+err:
+    if (ws2812->bytes_encoder)
+    {
+        rmt_del_encoder(ws2812->bytes_encoder);
+    }
+    if (ws2812->copy_encoder)
+    {
+        rmt_del_encoder(ws2812->copy_encoder);
+    }
+    free(ws2812);
+    return ret;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include "driver/rmt_encoder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RMT encoder for WS2812 strips: streams a packed GRB byte buffer as
+// WS2812 bit timings, then appends the >50us low reset code so back-to-back
+// frames latch correctly.
+esp_err_t ws2812_new_encoder(uint32_t resolution_hz, rmt_encoder_handle_t *ret_encoder);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,9 @@
 from __future__ import annotations
 
+import asyncio
 import json
+import os
+import urllib.request
 from pathlib import Path
 from typing import Set
 
@@ -10,6 +13,7 @@ from fastapi.staticfiles import StaticFiles
 
 APP_HOST = "127.0.0.1"
 APP_PORT = 8502
+BEAT_API = os.getenv("BEAT_API", "http://127.0.0.1:8000/beat")
 
 BASE_DIR = Path(__file__).resolve().parent
 MUSIC_DIR = BASE_DIR / "music"
@@ -42,9 +46,12 @@ PLAYER_HTML = f"""
     const statusEl = document.getElementById("status");
     const startBtn = document.getElementById("startBtn");
     const FADE_MS = 1100;
+    const BEAT_REPORT_MS = 5000;
 
     let active = "A";
     let hasUserGesture = false;
+    let ws = null;
+    let activeBpm = 0;
 
     function setStatus(msg) {{ statusEl.textContent = msg; }}
     function sleep(ms) {{ return new Promise(r => setTimeout(r, ms)); }}
@@ -71,16 +78,27 @@ PLAYER_HTML = f"""
       if (activeEl.src) await tryPlay(activeEl);
     }});
 
-    async function loadInitial(url, label) {{
+    // Tracks start on a beat, so the wall-clock time of currentTime 0 is a beat
+    // of the grid. Reported periodically so the LED node follows the audio clock.
+    function reportBeat() {{
+      const el = getActiveDeck();
+      if (!ws || ws.readyState !== WebSocket.OPEN || !activeBpm || el.paused) return;
+      const anchorMs = Math.round(Date.now() - el.currentTime * 1000);
+      ws.send(JSON.stringify({{ type: "beat", bpm: activeBpm, anchor_ms: anchorMs }}));
+    }}
+    setInterval(reportBeat, BEAT_REPORT_MS);
+
+    async function loadInitial(url, label, bpm) {{
       const el = getActiveDeck();
       el.src = url; el.currentTime = 0; el.volume = 1;
       nowEl.textContent = label;
       if (!hasUserGesture) {{ setStatus("Click Start / Resume once to enable audio."); return; }}
       const ok = await tryPlay(el);
       setStatus(ok ? "Playing" : "Playback blocked");
+      if (ok) {{ activeBpm = bpm; reportBeat(); }}
     }}
 
-    async function crossfadeTo(url, label) {{
+    async function crossfadeTo(url, label, bpm) {{
       incomingEl.textContent = label;
       if (!hasUserGesture) {{ setStatus("Click Start / Resume once to enable audio."); return; }}
       const fromEl = getActiveDeck();
@@ -92,20 +110,22 @@ PLAYER_HTML = f"""
       await equalPowerFade(fromEl, toEl);
       fromEl.pause();
       active = (active === "A") ? "B" : "A";
+      activeBpm = bpm;
+      reportBeat();
       nowEl.textContent = label;
       incomingEl.textContent = "";
       setStatus("Playing");
     }}
 
     function connect() {{
-      const ws = new WebSocket(WS_URL);
+      ws = new WebSocket(WS_URL);
       ws.onmessage = async (evt) => {{
         const msg = JSON.parse(evt.data);
         if (msg.type !== "set") return;
         const label = `${{msg.bpm}} — ${{msg.track}}`;
         const url = `/music/${{encodeURIComponent(msg.track)}}`;
-        if (!getActiveDeck().src) await loadInitial(url, label);
-        else await crossfadeTo(url, label);
+        if (!getActiveDeck().src) await loadInitial(url, label, msg.bpm);
+        else await crossfadeTo(url, label, msg.bpm);
       }};
       ws.onopen = () => setStatus("Connected");
       ws.onclose = () => {{ setStatus("Disconnected. Reconnecting..."); setTimeout(connect, 600); }};
@@ -130,6 +150,17 @@ def player() -> HTMLResponse:
     return HTMLResponse(PLAYER_HTML)
 
 
+def post_beat(payload: dict) -> None:
+    request = urllib.request.Request(
+        BEAT_API,
+        data=json.dumps(payload).encode(),
+        headers={"Content-Type": "application/json"},
+        method="POST",
+    )
+    with urllib.request.urlopen(request, timeout=2):
+        pass
+
+
 @app.websocket("/ws")
 async def ws_endpoint(websocket: WebSocket):
     await websocket.accept()
@@ -137,6 +168,19 @@ async def ws_endpoint(websocket: WebSocket):
     try:
         while True:
             text = await websocket.receive_text()
+
+            # Beat reports from the player go to the cadence API, not to other clients
+            try:
+                msg = json.loads(text)
+            except ValueError:
+                msg = {}
+            if isinstance(msg, dict) and msg.get("type") == "beat":
+                try:
+                    await asyncio.to_thread(post_beat, {"bpm": msg["bpm"], "anchor_ms": msg["anchor_ms"]})
+                except Exception as exc:
+                    print("Beat report failed:", exc)
+                continue
+
             dead = []
             for client in clients:
                 try: